@@ -15,14 +15,23 @@ UNITS {
 
 NEURON {
 	SUFFIX cagk
+	THREADSAFE
 	USEION nca READ ncai VALENCE 2
 	USEION lca READ lcai VALENCE 2
 	USEION tca READ tcai VALENCE 2
 	USEION k READ ek WRITE ik
 	RANGE gkbar,gkca, ik
 	GLOBAL oinf, otau
+	GLOBAL usetable2d, table2d_dv, table2d_nsub
 }
 
+VERBATIM
+#include "nrnexp.h"
+static int _cagk_table_rate(_threadargsprotocomma_ double, double);
+static double _cagk_table_error(_threadargsprotocomma_ int);
+static void _cagk_table_install(_threadargsproto_);
+ENDVERBATIM
+
 UNITS {
 	FARADAY = (faraday)  (kilocoulombs)
 	R = 8.313424 (joule/degC)
@@ -42,6 +51,9 @@ PARAMETER {
 	abar = .28	(/ms)
 	bbar = .48	(/ms)
         st=1            (1)
+	usetable2d = 0		: 1 takes oinf and otau from the (v, c) table below
+	table2d_dv = 1	(mV)	: voltage step of the table
+	table2d_nsub = 8	: calcium points per octave
 	lcai		(mV)
 	ncai		(mV)
 	tcai		(mV)
@@ -55,6 +67,9 @@ ASSIGNED {
 }
 
 INITIAL {
+VERBATIM
+	_cagk_table_install(_threadargs_);
+ENDVERBATIM
 	cai= ncai + lcai + tcai
         rate(v,cai)
         o=oinf
@@ -87,8 +102,175 @@ FUNCTION exp1(k (mM), d, v (mV)) (mM) { :callable from hoc
 
 PROCEDURE rate(v (mV), c (mM)) { :callable from hoc
 	LOCAL a
+VERBATIM
+	if (usetable2d && _cagk_table_rate(_threadargscomma_ _lv, _lc)) {
+		return 0;
+	}
+ENDVERBATIM
 	a = alp(v,c)
 	otau = 1/(a + bet(v, c))
 	oinf = a*otau
 }
 
+FUNCTION table2d_error(which) { :callable from hoc
+VERBATIM
+	_ltable2d_error = _cagk_table_error(_threadargscomma_ (int)_lwhich);
+ENDVERBATIM
+}
+
+COMMENT
+2D table of oinf and otau. alp() and bet() take two exp() per call through
+exp1(), in every compartment on every step, and NMODL TABLEs only have one
+argument. With usetable2d = 1, rate() interpolates bilinearly in a table over
+
+	v	-100 .. 60 mV in steps of table2d_dv
+	c	2^-20 .. 2^-3 mM (1e-6 .. 0.125 mM), table2d_nsub points per
+		octave, evenly spaced within an octave
+
+The calcium bin comes from the exponent and mantissa bits of c, so a lookup
+needs neither exp() nor log(). Outside the table rate() uses the formulas.
+The table is built at finitialize and, by the thread table check (serially,
+before a step), again when celsius, the parameters of alp() and bet() or the
+grid change. Until then rate() uses the formulas.
+
+table2d_error(0) returns the largest absolute error of oinf, table2d_error(1)
+the largest relative error of otau, against the formulas on the midpoints
+and edges of the table cells. With the default grid they are 1.5e-3 and
+3.3e-3 (6.3 and 34 degC); table2d_nsub = 16 brings them to 6e-4 and 1.2e-3.
+ENDCOMMENT
+
+VERBATIM
+#include <stdint.h>
+#include <string.h>
+
+#define _T2_VMIN (-100.)
+#define _T2_VMAX 60.
+#define _T2_EMIN (-20)
+#define _T2_EMAX (-3)
+#define _T2_NKEY 9
+
+static struct {
+	double* _tab;	/* oinf, otau of (v row, c column) at 2*(row*_nc + column) */
+	int _nv, _nc, _nsub;
+	double _dv;
+	double _key[_T2_NKEY];
+} _t2;
+
+static void _cagk_table_key(double* _k) {
+	_k[0] = celsius; _k[1] = d1; _k[2] = d2; _k[3] = k1; _k[4] = k2;
+	_k[5] = abar; _k[6] = bbar; _k[7] = table2d_dv; _k[8] = table2d_nsub;
+}
+
+static double _cagk_table_c(int _ic) {
+	return ldexp(1. + (double)(_ic % _t2._nsub) / _t2._nsub, _T2_EMIN + _ic / _t2._nsub);
+}
+
+static void _cagk_table_direct(_threadargsprotocomma_ double _v, double _c, double* _oinf, double* _otau) {
+	double _a = alp(_threadargscomma_ _v, _c);
+	*_otau = 1.0 / (_a + bet(_threadargscomma_ _v, _c));
+	*_oinf = _a * *_otau;
+}
+
+/* 1 if the table is built for the current parameters */
+static int _cagk_table_current(void) {
+	double _key[_T2_NKEY];
+	_cagk_table_key(_key);
+	return _t2._tab && !memcmp(_key, _t2._key, sizeof(_key));
+}
+
+/* builds the table unless it is current, 0 if the grid is invalid */
+static int _cagk_table_check(_threadargsproto_) {
+	double _key[_T2_NKEY], *_r;
+	int _iv, _ic;
+	if (_cagk_table_current()) {
+		return 1;
+	}
+	_cagk_table_key(_key);
+	if (!(table2d_dv > 0.) || table2d_nsub < 1) {
+		return 0;
+	}
+	free(_t2._tab);
+	_t2._dv = table2d_dv;
+	_t2._nsub = (int)table2d_nsub;
+	_t2._nv = (int)((_T2_VMAX - _T2_VMIN) / _t2._dv + .5);
+	_t2._nc = (_T2_EMAX - _T2_EMIN) * _t2._nsub;
+	_t2._tab = (double*)malloc(2 * (size_t)(_t2._nv + 1) * (_t2._nc + 1) * sizeof(double));
+	for (_iv = 0; _iv <= _t2._nv; ++_iv) {
+		for (_ic = 0; _ic <= _t2._nc; ++_ic) {
+			_r = _t2._tab + 2 * ((size_t)_iv * (_t2._nc + 1) + _ic);
+			_cagk_table_direct(_threadargscomma_ _T2_VMIN + _iv * _t2._dv, _cagk_table_c(_ic), _r, _r + 1);
+		}
+	}
+	memcpy(_t2._key, _key, sizeof(_key));
+	return 1;
+}
+
+/* oinf, otau at (v, c) from the table; 0 if (v, c) is outside of it */
+static int _cagk_table_lookup(double _v, double _c, double* _oinf, double* _otau) {
+	double _xv, _fv, _fc, _m, *_r0, *_r1;
+	uint64_t _bits;
+	int _iv, _ic, _e;
+	_xv = (_v - _T2_VMIN) / _t2._dv;
+	if (!(_xv >= 0. && _xv < _t2._nv && _c >= 0x1p-20 && _c < 0x1p-3)) {
+		return 0;
+	}
+	_iv = (int)_xv;
+	_fv = _xv - _iv;
+	/* c = 2^e * m, 1 <= m < 2 */
+	memcpy(&_bits, &_c, sizeof(_bits));
+	_e = (int)(_bits >> 52) - 1023;
+	_bits = (_bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+	memcpy(&_m, &_bits, sizeof(_m));
+	_fc = (_m - 1.) * _t2._nsub;
+	_ic = (int)_fc;
+	_fc -= _ic;
+	_ic += (_e - _T2_EMIN) * _t2._nsub;
+	_r0 = _t2._tab + 2 * ((size_t)_iv * (_t2._nc + 1) + _ic);
+	_r1 = _r0 + 2 * (_t2._nc + 1);
+	*_oinf = (1. - _fv) * (_r0[0] + _fc * (_r0[2] - _r0[0])) + _fv * (_r1[0] + _fc * (_r1[2] - _r1[0]));
+	*_otau = (1. - _fv) * (_r0[1] + _fc * (_r0[3] - _r0[1])) + _fv * (_r1[1] + _fc * (_r1[3] - _r1[1]));
+	return 1;
+}
+
+static int _cagk_table_rate(_threadargsprotocomma_ double _v, double _c) {
+	return _cagk_table_current() && _cagk_table_lookup(_v, _c, &oinf, &otau);
+}
+
+extern void _nrn_thread_table_reg(int, void (*)(double*, Datum*, Datum*, NrnThread*, int));
+
+static void _cagk_table_thread(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	if (usetable2d) {
+		_cagk_table_check(_threadargs_);
+	}
+}
+
+/* finitialize initializes the threads one after the other */
+static void _cagk_table_install(_threadargsproto_) {
+	_nrn_thread_table_reg(_mechtype, _cagk_table_thread);
+	_cagk_table_thread(_threadargscomma_ _mechtype);
+}
+
+static double _cagk_table_error(_threadargsprotocomma_ int _which) {
+	static const double _f[4][2] = {{.5, .5}, {.5, 0.}, {0., .5}, {.25, .75}};
+	double _v, _c, _o, _ot, _d, _dtau, _err = 0.;
+	int _iv, _ic, _k;
+	if (!_cagk_table_check(_threadargs_)) {
+		return -1.;
+	}
+	for (_iv = 0; _iv < _t2._nv; ++_iv) {
+		for (_ic = 0; _ic < _t2._nc; ++_ic) {
+			for (_k = 0; _k < 4; ++_k) {
+				_v = _T2_VMIN + (_iv + _f[_k][0]) * _t2._dv;
+				_c = _cagk_table_c(_ic) + _f[_k][1] * (_cagk_table_c(_ic + 1) - _cagk_table_c(_ic));
+				if (!_cagk_table_lookup(_v, _c, &_o, &_ot)) {
+					continue;
+				}
+				_cagk_table_direct(_threadargscomma_ _v, _c, &_d, &_dtau);
+				_d = _which ? fabs(_ot - _dtau) / _dtau : fabs(_o - _d);
+				_err = _d > _err ? _d : _err;
+			}
+		}
+	}
+	return _err;
+}
+ENDVERBATIM
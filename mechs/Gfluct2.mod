@@ -70,6 +70,19 @@ PARAMETERS
 Gfluct2: conductance cannot be negative
 
 
+RANDOM NUMBERS
+
+  The normal numbers come from a counter-based generator (cbrng.h) keyed by
+  rng_id of the instance and the seed of new_seed(), with the step count
+  of the instance as counter. They do not depend on the order in which
+  instances are updated, so the mechanism is THREADSAFE and gives the same
+  conductances for any number of threads or processes as long as every
+  instance keeps its rng_id. rng_id defaults to the creation order of the
+  instances; set it (e.g. from the gid of the cell) when the creation
+  order can differ between runs. nrn_state draws the numbers of all
+  instances of a thread in one batch.
+
+
 REFERENCE
 
   Destexhe, A., Rudolph, M., Fellous, J-M. and Sejnowski, T.J.  
@@ -92,10 +105,15 @@ NEURON {
 	POINT_PROCESS Gfluct2
 	RANGE g_e, g_i, E_e, E_i, g_e0, g_i0, g_e1, g_i1
 	RANGE std_e, std_i, tau_e, tau_i, D_e, D_i
-	RANGE new_seed
+	RANGE new_seed, rng_id
 	NONSPECIFIC_CURRENT i
+	THREADSAFE
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 UNITS {
 	(nA) = (nanoamp) 
 	(mV) = (millivolt)
@@ -116,6 +134,8 @@ PARAMETER {
 
 	tau_e	= 2.728	(ms)	: time constant of excitatory conductance
 	tau_i	= 10.49	(ms)	: time constant of inhibitory conductance
+
+	rng_id	= 0		: key of the random numbers, unique per instance
 }
 
 ASSIGNED {
@@ -131,11 +151,30 @@ ASSIGNED {
 	exp_i
 	amp_e	(umho)
 	amp_i	(umho)
+	nstep			: counter of the random numbers
+}
+
+VERBATIM
+#include "cbrng.h"
+static uint32_t _gfluct2_seed;
+static double _gfluct2_count;
+static void _gfluct2_install(NrnThread*);
+ENDVERBATIM
+
+CONSTRUCTOR {
+VERBATIM
+	rng_id = _gfluct2_count;
+	_gfluct2_count += 1.;
+ENDVERBATIM
 }
 
 INITIAL {
 	g_e1 = 0
 	g_i1 = 0
+	nstep = 0
+VERBATIM
+	_gfluct2_install(_nt);
+ENDVERBATIM
 	if(tau_e != 0) {
 		D_e = 2 * std_e * std_e / tau_e
 		exp_e = exp(-dt/tau_e)
@@ -151,10 +190,10 @@ INITIAL {
 BREAKPOINT {
 	SOLVE oup
 	if(tau_e==0) {
-	   g_e = std_e * normrand(0,1)
+	   g_e = std_e * white(0)
 	}
 	if(tau_i==0) {
-	   g_i = std_i * normrand(0,1)
+	   g_i = std_i * white(1)
 	}
 	g_e = g_e0 + g_e1
 	if(g_e < 0) { g_e = 0 }
@@ -164,20 +203,91 @@ BREAKPOINT {
 }
 
 
-PROCEDURE oup() {		: use Scop function normrand(mean, std_dev)
+PROCEDURE oup() {		: normals from cbrng.h, see RANDOM NUMBERS
+	LOCAL ze, zi
+VERBATIM
+	cbrng_normal2((uint32_t)rng_id, _gfluct2_seed, (uint64_t)nstep, 0, &_lze, &_lzi);
+ENDVERBATIM
    if(tau_e!=0) {
-	g_e1 =  exp_e * g_e1 + amp_e * normrand(0,1)
+	g_e1 =  exp_e * g_e1 + amp_e * ze
    }
    if(tau_i!=0) {
-	g_i1 =  exp_i * g_i1 + amp_i * normrand(0,1)
+	g_i1 =  exp_i * g_i1 + amp_i * zi
    }
+	nstep = nstep + 1
+}
+
+FUNCTION white(k) {		: second pair of normals of the step
+VERBATIM
+	double _z0, _z1;
+	cbrng_normal2((uint32_t)rng_id, _gfluct2_seed, (uint64_t)nstep, 1, &_z0, &_z1);
+	_lwhite = _lk == 0. ? _z0 : _z1;
+ENDVERBATIM
 }
 
 
 PROCEDURE new_seed(seed) {		: procedure to set the seed
-	set_seed(seed)
-	VERBATIM
+VERBATIM
+	_gfluct2_seed = (uint32_t)_lseed;
 	  printf("Setting random generator with seed = %g\n", _lseed);
-	ENDVERBATIM
+ENDVERBATIM
 }
 
+COMMENT
+Batched nrn_state: the Philox rounds of all instances of the thread run in
+one loop (cbrng_uniform2_batch), then the normals and the update of oup()
+follow per instance, with the same numbers as oup().
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+typedef struct {
+	int _n;
+	uint32_t* _key;
+	uint64_t* _ctr;
+	double* _u0;
+	double* _u1;
+} _gfluct2_batch_t;
+static _gfluct2_batch_t _batch[NRNSOA_MAXTHREAD];
+
+static void _gfluct2_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p;
+	double _ze, _zi;
+	int _i, _cntml = _ml->_nodecount;
+	_gfluct2_batch_t* _b = _batch + _nt->id;
+	if (_b->_n < _cntml) {
+		free(_b->_key);
+		free(_b->_ctr);
+		free(_b->_u0);
+		free(_b->_u1);
+		_b->_n = _cntml;
+		_b->_key = (uint32_t*)malloc(_cntml * sizeof(uint32_t));
+		_b->_ctr = (uint64_t*)malloc(_cntml * sizeof(uint64_t));
+		_b->_u0 = (double*)malloc(_cntml * sizeof(double));
+		_b->_u1 = (double*)malloc(_cntml * sizeof(double));
+	}
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+		_b->_key[_i] = (uint32_t)rng_id;
+		_b->_ctr[_i] = (uint64_t)nstep;
+	}
+	cbrng_uniform2_batch(_cntml, _b->_key, _gfluct2_seed, _b->_ctr, 0, _b->_u0, _b->_u1);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+		cbrng_box_muller(_b->_u0[_i], _b->_u1[_i], &_ze, &_zi);
+		if (tau_e != 0.0) {
+			g_e1 = exp_e * g_e1 + amp_e * _ze;
+		}
+		if (tau_i != 0.0) {
+			g_i1 = exp_i * g_i1 + amp_i * _zi;
+		}
+		nstep = nstep + 1.0;
+	}
+}
+
+static void _gfluct2_install(NrnThread* _nt) {
+	nrnsoa_thread_check(_nt, "Gfluct2");
+	nrnsoa_install(_mechtype, 0, _gfluct2_state);
+}
+ENDVERBATIM
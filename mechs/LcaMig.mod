@@ -25,12 +25,17 @@ PARAMETER {
 
 NEURON {
 	SUFFIX lca
+	THREADSAFE
 	USEION lca READ elca WRITE ilca VALENCE 2
 	USEION ca READ cai, cao VALENCE 2 
         RANGE glcabar, cai, ilca, elca
         GLOBAL minf,matu
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 STATE {
 	m
 }
@@ -44,11 +49,17 @@ ASSIGNED {
 
 }
 
+VERBATIM
+#include "vtable.h"
+static void _lca_vtable_install(int);
+ENDVERBATIM
+
 INITIAL {
 	rate(v)
 	m = minf
 	VERBATIM
 	cai=_ion_cai;
+	vtable_invalidate(_nt);
 	ENDVERBATIM
 }
 
@@ -108,4 +119,81 @@ PROCEDURE rate(v (mV)) { :callable from hoc
 }
  
 
+PROCEDURE shared_tables(on) {	:1 nrn_state takes alp and bet from the tables of vtable.h
+VERBATIM
+	_lca_vtable_install((int)_lon);
+ENDVERBATIM
+}
+
+COMMENT
+nrn_state on the shared tables of vtable.h (see ichan2.mod). alp and bet
+are one slice of the -150..150 mV, 1.5 mV grid of their TABLEs, which cat
+shares. The slice is filled by the thread table check,
+serially before the step. The update is rate() followed by the generated
+cnexp one.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+#define _VT_NCOL 2
+static int _vt_id = -1;
+static vtable_grid_t* _vt_grid;
+static int _vt_on;
+
+static void _vt_check(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	int _k, _c;
+	double* _r;
+	_check_table_thread(_p, _ppvar, _thread, _nt, _type);
+	if (!_vt_on || !vtable_stale(_vt_id, 0., 0.)) {
+		return;
+	}
+	_c = vtable_col(_vt_id);
+	for (_k = 0; _k <= _vt_grid->_n; ++_k) {
+		_r = vtable_row(_vt_grid, _k) + _c;
+		_r[0] = _f_alp(_threadargscomma_ vtable_x(_vt_grid, _k));
+		_r[1] = _f_bet(_threadargscomma_ vtable_x(_vt_grid, _k));
+	}
+	vtable_filled(_vt_id, 0., 0.);
+}
+
+static void _vt_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+#if CACHEVEC
+	double* _p; Datum* _ppvar; Datum* _thread = _ml->_thread;
+	int* _ni = _ml->_nodeindices;
+	int _i, _k, _c, _cntml = _ml->_nodecount;
+	double _theta, _a;
+	if (use_cachevec && usetable && !vtable_stale(_vt_id, 0., 0.)) {
+		vtable_prepare(_vt_grid, _nt);
+		_c = vtable_col(_vt_id);
+		for (_i = 0; _i < _cntml; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			v = VEC_V(_ni[_i]);
+			elca = _ion_elca;
+			cai = _ion_cai;
+			cao = _ion_cao;
+			_k = vtable_bin(_vt_grid, _nt, _ni[_i], v, &_theta);
+			_a = vtable_at(_vt_grid, _k, _theta, _c);
+			matu = 1.0 / ( tfa * ( _a + vtable_at(_vt_grid, _k, _theta, _c + 1) ) );
+			minf = tfa * _a * matu;
+			m = m + (1. - exp(dt*(( ( ( - 1.0 ) ) ) / matu)))*(- ( ( ( minf ) ) / matu ) / ( ( ( ( - 1.0 ) ) ) / matu ) - m);
+		}
+		return;
+	}
+#endif
+	nrn_state(_nt, _ml, _type);
+}
 
+static void _lca_vtable_install(int _on) {
+	_vt_on = _on;
+	if (_on) {
+		_vt_id = vtable_register("lca", _VT_NCOL, -150., 150., 200);
+		_vt_grid = vtable_grid(_vt_id);
+		_nrn_thread_table_reg(_mechtype, _vt_check);
+		nrnsoa_install(_mechtype, 0, _vt_state);
+	} else {
+		_nrn_thread_table_reg(_mechtype, _check_table_thread);
+		nrnsoa_install(_mechtype, 0, nrn_state);
+	}
+}
+ENDVERBATIM
@@ -0,0 +1,77 @@
+TITLE artstate.mod  keeps the ARTIFICIAL_CELL data across SaveState.restore
+
+COMMENT
+No mechanism of its own. SaveState restores all ASSIGNED variables of
+mechanisms with a NET_RECEIVE block, which for ARTIFICIAL_CELLs like VecStim
+and SpikePlayer includes their position in the spike train and the pointer
+to it. When a checkpoint of the warmup is restored for a run with other
+inputs (pydentate.neuron_tools.run_neuron_simulator), these cells must stay
+as finitialize has set them up:
+
+	art_state_save()	copies the data of all ARTIFICIAL_CELL instances
+	ss.restore(1)
+	art_state_restore()	copies it back
+
+Nothing may be created or deleted in between.
+ENDCOMMENT
+
+NEURON {
+	SUFFIX nothing
+	THREADSAFE
+}
+
+VERBATIM
+#include <stdlib.h>
+#include <string.h>
+extern int n_memb_func;
+extern Memb_list* memb_list;
+extern short* nrn_is_artificial_;
+extern int* nrn_prop_param_size_;
+
+static double* _art_buf;
+ENDVERBATIM
+
+PROCEDURE art_state_save() {
+VERBATIM
+	size_t _n = 0;
+	int _type, _i, _np;
+	for (_type = 0; _type < n_memb_func; ++_type) {
+		if (nrn_is_artificial_[_type]) {
+			_n += (size_t)memb_list[_type].nodecount * nrn_prop_param_size_[_type];
+		}
+	}
+	free(_art_buf);
+	_art_buf = (double*)malloc((_n + 1) * sizeof(double));
+	_n = 0;
+	for (_type = 0; _type < n_memb_func; ++_type) {
+		if (nrn_is_artificial_[_type]) {
+			_np = nrn_prop_param_size_[_type];
+			for (_i = 0; _i < memb_list[_type].nodecount; ++_i) {
+				memcpy(_art_buf + _n, memb_list[_type].data[_i], _np * sizeof(double));
+				_n += _np;
+			}
+		}
+	}
+ENDVERBATIM
+}
+
+PROCEDURE art_state_restore() {
+VERBATIM
+	size_t _n = 0;
+	int _type, _i, _np;
+	if (!_art_buf) {
+		hoc_execerror("art_state_restore:", "no art_state_save()");
+	}
+	for (_type = 0; _type < n_memb_func; ++_type) {
+		if (nrn_is_artificial_[_type]) {
+			_np = nrn_prop_param_size_[_type];
+			for (_i = 0; _i < memb_list[_type].nodecount; ++_i) {
+				memcpy(memb_list[_type].data[_i], _art_buf + _n, _np * sizeof(double));
+				_n += _np;
+			}
+		}
+	}
+	free(_art_buf);
+	_art_buf = (double*)0;
+ENDVERBATIM
+}
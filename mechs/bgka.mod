@@ -18,25 +18,39 @@ PARAMETER {
         zetal=4    (1)
         gmn=0.6   (1)
         gml=1   (1)
+	column_layout = 0	: 1 uses the batch nrn_state below, from the next finitialize
 }
 
 
 NEURON {
 	SUFFIX borgka
+	THREADSAFE
 	USEION k READ ek WRITE ik
         RANGE gkabar,gka, ik
         GLOBAL ninf,linf,taul,taun
+        GLOBAL column_layout
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 STATE {
 	n
         l
 }
 
+VERBATIM
+static void _borgka_layout_init(int);
+ENDVERBATIM
+
 INITIAL {
         rates(v)
         n=ninf
         l=linf
+VERBATIM
+	_borgka_layout_init((int)column_layout);
+ENDVERBATIM
 }
 
 ASSIGNED {
@@ -89,3 +103,52 @@ PROCEDURE rates(v (mV)) { :callable from hoc
         taul = betl(v)/(q10*a0l*(1 + a))
 }
 
+COMMENT
+Batch nrn_state. borgka has no per-instance parameters in its state update,
+so there is nothing to mirror in nrnsoa.h; the kernel evaluates pow(3, ...)
+and the temperature terms of alpn/betn/alpl/betl once per call instead of
+once per instance and inlines rates(). Same arithmetic as the generated
+code, bit-identical results. The GLOBALs ninf, linf, taun, taul are left
+with the values of the last instance of the thread, as in the generated
+loop.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+static void _soa_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar; Datum* _thread = _ml->_thread;
+	double _v, _a, _q10, _kt, _ninf, _taun, _linf, _taul;
+	int _i, _cntml = _ml->_nodecount;
+	_q10 = pow( 3.0 , ( ( celsius - 30.0 ) / 10.0 ) );
+	_kt = 8.315 * ( 273.16 + celsius );
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+#if CACHEVEC
+		if (use_cachevec) {
+			_v = VEC_V(_ml->_nodeindices[_i]);
+		}else
+#endif
+		{
+			_v = NODEV(_ml->_nodelist[_i]);
+		}
+		ek = _ion_ek;
+		_a = exp ( 1.e-3 * zetan * ( _v - vhalfn ) * 9.648e4 / _kt );
+		_ninf = 1.0 / ( 1.0 + _a );
+		_taun = exp ( 1.e-3 * zetan * gmn * ( _v - vhalfn ) * 9.648e4 / _kt ) / ( _q10 * a0n * ( 1.0 + _a ) );
+		_a = exp ( 1.e-3 * zetal * ( _v - vhalfl ) * 9.648e4 / _kt );
+		_linf = 1.0 / ( 1.0 + _a );
+		_taul = exp ( 1.e-3 * zetal * gml * ( _v - vhalfl ) * 9.648e4 / _kt ) / ( _q10 * a0l * ( 1.0 + _a ) );
+		n = n + (1. - exp(dt*(( ( ( - 1.0 ) ) ) / _taun)))*(- ( ( ( _ninf ) ) / _taun ) / ( ( ( ( - 1.0 ) ) ) / _taun ) - n);
+		l = l + (1. - exp(dt*(( ( ( - 1.0 ) ) ) / _taul)))*(- ( ( ( _linf ) ) / _taul ) / ( ( ( ( - 1.0 ) ) ) / _taul ) - l);
+		if (_i == _cntml - 1) {
+			v = _v;
+			ninf = _ninf; taun = _taun; linf = _linf; taul = _taul;
+		}
+	}
+}
+
+static void _borgka_layout_init(int _mode) {
+	nrnsoa_install(_mechtype, 0, _mode ? _soa_state : nrn_state);
+}
+ENDVERBATIM
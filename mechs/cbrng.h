@@ -0,0 +1,89 @@
+/*
+cbrng.h
+
+Counter-based random numbers: Philox4x32-10 (Salmon et al., Parallel random
+numbers: as easy as 1, 2, 3, SC11). A draw is a pure function of a 64 bit
+key and a 128 bit counter, so a mechanism that keys by a fixed instance id
+and counts time steps gets the same numbers whatever thread or process the
+instance ends up in, and needs no generator state besides its step count.
+
+cbrng_normal2() returns two standard normals for one counter (Box-Muller on
+the two 53 bit uniforms of one Philox block). cbrng_uniform2_batch() runs the
+Philox rounds for many instances in one loop that the compiler can vectorize;
+cbrng_box_muller() then turns each pair into normals. Both paths give the
+same numbers.
+
+Included from VERBATIM blocks.
+*/
+
+#ifndef CBRNG_H
+#define CBRNG_H
+
+#include <math.h>
+#include <stdint.h>
+
+#define _CBRNG_M0 0xD2511F53u
+#define _CBRNG_M1 0xCD9E8D57u
+#define _CBRNG_W0 0x9E3779B9u
+#define _CBRNG_W1 0xBB67AE85u
+
+static inline void cbrng_philox(uint32_t _c[4], uint32_t _k0, uint32_t _k1) {
+    uint64_t _p0, _p1;
+    int _r;
+    for (_r = 0; _r < 10; ++_r) {
+        if (_r > 0) {
+            _k0 += _CBRNG_W0;
+            _k1 += _CBRNG_W1;
+        }
+        _p0 = (uint64_t) _CBRNG_M0 * _c[0];
+        _p1 = (uint64_t) _CBRNG_M1 * _c[2];
+        _c[0] = (uint32_t) (_p1 >> 32) ^ _c[1] ^ _k0;
+        _c[2] = (uint32_t) (_p0 >> 32) ^ _c[3] ^ _k1;
+        _c[1] = (uint32_t) _p1;
+        _c[3] = (uint32_t) _p0;
+    }
+}
+
+/* uniform in (0, 1] from 53 bits of _a and _b */
+static inline double cbrng_u01(uint32_t _a, uint32_t _b) {
+    return ((_a >> 5) * 67108864. + (_b >> 6) + 1.) * (1. / 9007199254740992.);
+}
+
+/* two uniforms in (0, 1] for key (_k0, _k1) and counter (_n, _stream) */
+static inline void cbrng_uniform2(uint32_t _k0, uint32_t _k1, uint64_t _n, uint32_t _stream,
+                                  double* _u0, double* _u1) {
+    uint32_t _c[4];
+    _c[0] = (uint32_t) _n;
+    _c[1] = (uint32_t) (_n >> 32);
+    _c[2] = _stream;
+    _c[3] = 0;
+    cbrng_philox(_c, _k0, _k1);
+    *_u0 = cbrng_u01(_c[0], _c[1]);
+    *_u1 = cbrng_u01(_c[2], _c[3]);
+}
+
+static inline void cbrng_box_muller(double _u0, double _u1, double* _z0, double* _z1) {
+    double _r = sqrt(-2. * log(_u0));
+    double _a = 6.283185307179586 * _u1;
+    *_z0 = _r * cos(_a);
+    *_z1 = _r * sin(_a);
+}
+
+static inline void cbrng_normal2(uint32_t _k0, uint32_t _k1, uint64_t _n, uint32_t _stream,
+                                 double* _z0, double* _z1) {
+    double _u0, _u1;
+    cbrng_uniform2(_k0, _k1, _n, _stream, &_u0, &_u1);
+    cbrng_box_muller(_u0, _u1, _z0, _z1);
+}
+
+/* cbrng_uniform2() for _cnt instances with keys (_k0[i], _k1) and counters
+(_n[i], _stream) */
+static void cbrng_uniform2_batch(int _cnt, const uint32_t* _k0, uint32_t _k1, const uint64_t* _n,
+                                 uint32_t _stream, double* _u0, double* _u1) {
+    int _i;
+    for (_i = 0; _i < _cnt; ++_i) {
+        cbrng_uniform2(_k0[_i], _k1, _n[_i], _stream, _u0 + _i, _u1 + _i);
+    }
+}
+
+#endif
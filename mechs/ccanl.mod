@@ -2,14 +2,22 @@ COMMENT
 	calcium accumulation into a volume of area*depth next to the
 	membrane with a decay (time constant tau) to resting level
 	given by the global calcium variable cai0_ca_ion
+
+	The three pools are linear in their state with the constant decay
+	catau, so cnexp integrates them exactly for the currents of the
+	step (no Newton iteration as with derivimplicit, and no halving of
+	dt when secondorder is set). ktf0 is ktf() at finitialize; changes
+	of celsius during a run are not seen by eca.
 ENDCOMMENT
 
 NEURON {
 	SUFFIX ccanl
+	THREADSAFE
 USEION nca READ ncai, inca, enca WRITE enca, ncai VALENCE 2
 USEION lca READ lcai, ilca, elca WRITE elca, lcai VALENCE 2
 USEION tca READ tcai, itca, etca WRITE etca, tcai VALENCE 2
-RANGE caiinf, catau, cai, ncai, lcai,tcai, eca, elca, enca, etca
+RANGE caiinf, catau, cai, ncai, lcai,tcai, eca, elca, enca, etca, ktf0
+GLOBAL column_layout
 }
 
 UNITS {
@@ -36,6 +44,7 @@ PARAMETER {
 	ilca (mA/cm2)
 	itca (mA/cm2)
 	cai= 50.e-6 (mM)
+	column_layout = 0	: 1 uses the batch nrn_state below, from the next finitialize
 }
 
 ASSIGNED {
@@ -43,6 +52,7 @@ ASSIGNED {
 	elca (mV)
 	etca (mV)
 	eca (mV)
+	ktf0 (mV)
 }
 
 STATE {
@@ -51,6 +61,10 @@ STATE {
 	tcai (mM)
 }
 
+VERBATIM
+static void _ccanl_layout_init(NrnThread*, int);
+ENDVERBATIM
+
 INITIAL {
 	VERBATIM
 	ncai = _ion_ncai;
@@ -65,13 +79,17 @@ INITIAL {
 	enca = eca
 	elca = eca
 	etca = eca
+	ktf0 = ktf()
+VERBATIM
+	_ccanl_layout_init(_nt, (int)column_layout);
+ENDVERBATIM
 }
 
 
 BREAKPOINT {
-	SOLVE integrate METHOD derivimplicit
+	SOLVE integrate METHOD cnexp
 	cai = ncai+lcai+tcai	
-	eca = ktf() * log(cao/cai)	
+	eca = ktf0 * log(cao/cai)	
 	enca = eca
 	elca = eca
 	etca = eca
@@ -86,3 +104,74 @@ tcai' = -(itca)/depth/FARADAY * (1e7) + (caiinf/3 - tcai)/catau
 FUNCTION ktf() (mV) {
 	ktf = (1000)*R*(celsius +273.15)/(2*FARADAY)
 } 
+
+COMMENT
+Parameter column nrn_state. The cnexp update of each pool,
+	y = y + (1 - exp(-dt/catau))*(yinf - y),
+	yinf = caiinf/3 - catau*i/depth/FARADAY*1e7,
+with the decay factor, -1/catau and caiinf/3/catau kept in contiguous
+per-instance arrays (nrnsoa.h), so a step needs one log() per
+instance and no exp(). The arithmetic is that of the generated cnexp update,
+the results are bit-identical.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+enum { _SOA_DECAY, _SOA_RATE, _SOA_DRIVE, _SOA_NCOL };
+static nrnsoa_t _soa[NRNSOA_MAXTHREAD];
+
+static nrnsoa_t* _soa_fill(NrnThread* _nt, _Memb_list* _ml) {
+	double* _p;
+	double *_decay, *_rate, *_drive;
+	int _i;
+	nrnsoa_t* _s = _soa + _nt->id;
+	if (nrnsoa_check(_s, _ml, _SOA_NCOL, dt)) {
+		_decay = nrnsoa_col(_s, _SOA_DECAY);
+		_rate = nrnsoa_col(_s, _SOA_RATE);
+		_drive = nrnsoa_col(_s, _SOA_DRIVE);
+		for (_i = 0; _i < _s->_n; ++_i) {
+			_p = _ml->_data[_i];
+			_decay[_i] = 1. - exp(dt*(( - 1.0 ) / catau));
+			_rate[_i] = ( - 1.0 ) / catau;
+			_drive[_i] = ( caiinf / 3.0 ) / catau;
+		}
+	}
+	return _s;
+}
+
+static void _soa_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar;
+	int _i, _cntml = _ml->_nodecount;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	const double* _decay = nrnsoa_col(_s, _SOA_DECAY);
+	const double* _rate = nrnsoa_col(_s, _SOA_RATE);
+	const double* _drive = nrnsoa_col(_s, _SOA_DRIVE);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+		inca = _ion_inca;
+		ilca = _ion_ilca;
+		itca = _ion_itca;
+		ncai = ncai + _decay[_i]*(- ( ( - inca ) / depth / FARADAY * ( 1e7 ) + _drive[_i] ) / _rate[_i] - ncai);
+		lcai = lcai + _decay[_i]*(- ( ( - ilca ) / depth / FARADAY * ( 1e7 ) + _drive[_i] ) / _rate[_i] - lcai);
+		tcai = tcai + _decay[_i]*(- ( ( - itca ) / depth / FARADAY * ( 1e7 ) + _drive[_i] ) / _rate[_i] - tcai);
+		cai = ncai + lcai + tcai;
+		eca = ktf0 * log ( cao / cai );
+		enca = eca;
+		elca = eca;
+		etca = eca;
+		_ion_enca = enca;
+		_ion_ncai = ncai;
+		_ion_elca = elca;
+		_ion_lcai = lcai;
+		_ion_etca = etca;
+		_ion_tcai = tcai;
+	}
+}
+
+static void _ccanl_layout_init(NrnThread* _nt, int _mode) {
+	nrnsoa_thread_check(_nt, "ccanl");
+	nrnsoa_install(_mechtype, 0, _mode ? _soa_state : nrn_state);
+	_soa[_nt->id]._stale = 1;
+}
+ENDVERBATIM
@@ -0,0 +1,73 @@
+/*
+cellquiet.h
+
+State of one cell in the lazy update mode, kept by its CellQuiet
+(cellquiet.mod) and shared with the gcmem instances of the cell through
+their POINTER qc, which points at CellQuiet's `space`. Per time step the
+gcmem kernels do both halves themselves, through the first instance of the
+cell that gets there, so the result does not depend on the order in which
+NEURON calls the mechanisms:
+
+	nrn_cur    cellquiet_cur() sets _frozen if the cell was quiet in the
+	           last step and no synaptic g exceeds _gtol; gcmem then
+	           applies the currents it computed when the cell froze
+	nrn_state  cellquiet_state() counts the step and sets _quiet, gcmem
+	           clears it if v or a state of any compartment has moved by
+	           more than _tol
+
+The first call is told by t, which differs between the nrn_cur (t + dt/2)
+and nrn_state (t + dt) of a step and from those of any other step. A cell
+lives in one thread, so no locking. The synaptic conductance pointers are
+remapped when NEURON moves the data (cache_efficient, see nrnptr.h).
+
+Included from VERBATIM blocks.
+*/
+
+#ifndef CELLQUIET_H
+#define CELLQUIET_H
+
+#include "nrnptr.h"
+
+typedef struct {
+    int _frozen;
+    int _quiet;
+    double _tol, _gtol;
+    double _cur_t, _state_t; /* t of the last cellquiet_cur / _state */
+    double _steps, _skipped;
+    int _n, _cap;
+    double** _g; /* synaptic conductances of the cell */
+    nrnptr_owner_t _owner;
+} cellquiet_t;
+
+#define CELLQUIET(_pv) (*((cellquiet_t**) (_pv)))
+
+/* from every gcmem instance of the cell in nrn_cur, before it looks at
+_frozen; only the first call at _t decides */
+static inline void cellquiet_cur(cellquiet_t* _q, double _t) {
+    int _k, _frz;
+    if (_q->_cur_t == _t) {
+        return;
+    }
+    _q->_cur_t = _t;
+    _frz = _q->_quiet;
+    for (_k = 0; _frz && _k < _q->_n; ++_k) {
+        if (*_q->_g[_k] > _q->_gtol) {
+            _frz = 0;
+        }
+    }
+    _q->_frozen = _frz;
+}
+
+/* from every gcmem instance of the cell in nrn_state, before it may clear
+_quiet; only the first call at _t counts the step and starts the check */
+static inline void cellquiet_state(cellquiet_t* _q, double _t) {
+    if (_q->_state_t == _t) {
+        return;
+    }
+    _q->_state_t = _t;
+    _q->_steps += 1.;
+    _q->_skipped += _q->_frozen;
+    _q->_quiet = 1;
+}
+
+#endif
@@ -0,0 +1,118 @@
+: Lazy update of a cell at rest
+
+COMMENT
+One CellQuiet per cell, placed in its soma. The gcmem instances of the cell
+point at it (POINTER qc, set to &space) and add(&syn.g) registers the
+synaptic conductances of the cell. When in the last step no compartment
+moved (v by no more than tol mV, every state by no more than tol relative)
+and no registered g exceeds gtol, the cell is frozen for the step: gcmem
+skips its state update and applies the currents it computed at the last
+update, linearized in v (so a cell at a fixed point stays there exactly,
+as the analytic solution would). An event that raises a g above gtol, or
+any v moving by more than tol since the cell froze, resumes the updates,
+for an event in the same step. Other point processes (IClamp, noise) are
+only caught by the v check. The per step work is done by the gcmem
+kernels of the cell, see cellquiet.h; CellQuiet itself only holds the state
+and takes tol and gtol at finitialize.
+
+steps() and skipped() count the steps and frozen steps since finitialize,
+frozen() is 1 while the cell is frozen.
+
+	q = new CellQuiet(0.5)
+	setpointer q.space, soma.qc_gcmem(0.5)	// for every segment
+	q.add(&syn.g)				// for every synapse
+ENDCOMMENT
+
+NEURON {
+	POINT_PROCESS CellQuiet
+	THREADSAFE
+	NONSPECIFIC_CURRENT i
+	RANGE tol, gtol, nsyn
+}
+
+UNITS {
+	(nA) = (nanoamp)
+	(mV) = (millivolt)
+	(umho) = (micromho)
+}
+
+PARAMETER {
+	tol = 1e-6
+	gtol = 1e-9 (umho)
+}
+
+ASSIGNED {
+	i (nA)
+	nsyn
+	space
+}
+
+VERBATIM
+#include <math.h>
+#include <stdlib.h>
+#include "cellquiet.h"
+extern double* hoc_pgetarg(int);
+
+#define QUIET CELLQUIET(&space)
+ENDVERBATIM
+
+CONSTRUCTOR {
+VERBATIM
+	QUIET = (cellquiet_t*)calloc(1, sizeof(cellquiet_t));
+	nrnptr_attach(&QUIET->_owner, &QUIET->_g, &QUIET->_n);
+ENDVERBATIM
+}
+
+DESTRUCTOR {
+VERBATIM
+	nrnptr_detach(&QUIET->_owner);
+	free(QUIET->_g);
+	free(QUIET);
+ENDVERBATIM
+}
+
+INITIAL {
+VERBATIM
+	QUIET->_frozen = 0;
+	QUIET->_quiet = 0;
+	QUIET->_tol = tol;
+	QUIET->_gtol = gtol;
+	QUIET->_cur_t = QUIET->_state_t = NAN;
+	QUIET->_steps = QUIET->_skipped = 0.;
+ENDVERBATIM
+}
+
+BREAKPOINT {
+	i = 0
+}
+
+FUNCTION steps() {
+VERBATIM
+	_lsteps = QUIET->_steps;
+ENDVERBATIM
+}
+
+FUNCTION skipped() {
+VERBATIM
+	_lskipped = QUIET->_skipped;
+ENDVERBATIM
+}
+
+FUNCTION frozen() {
+VERBATIM
+	_lfrozen = (double)QUIET->_frozen;
+ENDVERBATIM
+}
+
+: add(&g) registers the conductance of a synapse of the cell
+PROCEDURE add() {
+VERBATIM
+	cellquiet_t* _q = QUIET;
+	if (_q->_n == _q->_cap) {
+		_q->_cap = _q->_cap ? 2 * _q->_cap : 16;
+		_q->_g = (double**)realloc(_q->_g, _q->_cap * sizeof(double*));
+	}
+	_q->_g[_q->_n++] = hoc_pgetarg(1);
+	nsyn = _q->_n;
+ENDVERBATIM
+}
@@ -0,0 +1,146 @@
+: Sums of synaptic conductances, sampled every few ms
+
+COMMENT
+Recording g of every synapse with Vector.record keeps one double per synapse
+per time step. GAggregate instead keeps pointers to the conductances of many
+synapses, each assigned to a bin (a postsynaptic cell, a connection, a
+section, ...), and every `every` ms appends the sum over each bin to one
+Vector: sample k of bin b is at index k*nbin + b. The first sample is taken
+at the time of finitialize. The synapses must be in the same thread as the
+GAggregate; the Vector has to be kept alive by the caller. The pointers
+follow the data when NEURON moves it (cache_efficient, see nrnptr.h).
+
+	agg = new GAggregate()
+	agg.every = 1
+	agg.add(&syn.g, bin)
+	agg.record(vec)
+ENDCOMMENT
+
+NEURON {
+	ARTIFICIAL_CELL GAggregate
+	RANGE every, n, nbin
+	THREADSAFE
+}
+
+PARAMETER {
+	every = 1 (ms)
+}
+
+ASSIGNED {
+	n
+	nbin
+	space
+}
+
+VERBATIM
+#include <stdlib.h>
+#include "nrnptr.h"
+extern double* hoc_pgetarg(int);
+extern double* vector_vec();
+extern int vector_capacity();
+extern void vector_resize();
+extern void* vector_arg();
+
+typedef struct {
+	int _n, _cap, _nbin;
+	double** _ptr;
+	int* _bin;
+	double* _sum;
+	void* _vec;
+	nrnptr_owner_t _owner;
+} GSum;
+
+#define GSUM (*((GSum**)(&space)))
+ENDVERBATIM
+
+CONSTRUCTOR {
+VERBATIM
+	GSUM = (GSum*)calloc(1, sizeof(GSum));
+	nrnptr_attach(&GSUM->_owner, &GSUM->_ptr, &GSUM->_n);
+ENDVERBATIM
+}
+
+DESTRUCTOR {
+VERBATIM
+	GSum* _g = GSUM;
+	nrnptr_detach(&_g->_owner);
+	free(_g->_ptr);
+	free(_g->_bin);
+	free(_g->_sum);
+	free(_g);
+ENDVERBATIM
+}
+
+INITIAL {
+VERBATIM
+	if (GSUM->_vec) {
+		vector_resize(GSUM->_vec, 0);
+	}
+ENDVERBATIM
+	net_send(0, 1)
+}
+
+NET_RECEIVE (w) {
+	if (flag == 1) {
+		sample()
+		net_send(every, 1)
+	}
+}
+
+: appends the current sum of every bin to the Vector
+PROCEDURE sample() {
+VERBATIM
+	GSum* _g = GSUM;
+	int _i, _m;
+	double* _out;
+	if (_g->_vec && _g->_nbin) {
+		for (_i = 0; _i < _g->_nbin; ++_i) {
+			_g->_sum[_i] = 0.;
+		}
+		for (_i = 0; _i < _g->_n; ++_i) {
+			_g->_sum[_g->_bin[_i]] += *_g->_ptr[_i];
+		}
+		_m = vector_capacity(_g->_vec);
+		vector_resize(_g->_vec, _m + _g->_nbin);
+		_out = vector_vec(_g->_vec) + _m;
+		for (_i = 0; _i < _g->_nbin; ++_i) {
+			_out[_i] = _g->_sum[_i];
+		}
+	}
+ENDVERBATIM
+}
+
+: add(&g, bin) adds the conductance at &g to bin (>= 0)
+PROCEDURE add() {
+VERBATIM
+	GSum* _g = GSUM;
+	int _b = (int)*getarg(2), _i;
+	if (_b < 0) {
+		hoc_execerror("GAggregate.add:", "negative bin");
+	}
+	if (_g->_n == _g->_cap) {
+		_g->_cap = _g->_cap ? 2 * _g->_cap : 64;
+		_g->_ptr = (double**)realloc(_g->_ptr, _g->_cap * sizeof(double*));
+		_g->_bin = (int*)realloc(_g->_bin, _g->_cap * sizeof(int));
+	}
+	_g->_ptr[_g->_n] = hoc_pgetarg(1);
+	_g->_bin[_g->_n] = _b;
+	++_g->_n;
+	if (_b >= _g->_nbin) {
+		_g->_sum = (double*)realloc(_g->_sum, (_b + 1) * sizeof(double));
+		for (_i = _g->_nbin; _i <= _b; ++_i) {
+			_g->_sum[_i] = 0.;
+		}
+		_g->_nbin = _b + 1;
+	}
+	n = _g->_n;
+	nbin = _g->_nbin;
+ENDVERBATIM
+}
+
+: record(vec) appends the samples to vec from the next finitialize
+PROCEDURE record() {
+VERBATIM
+	GSUM->_vec = vector_arg(1);
+ENDVERBATIM
+}
@@ -0,0 +1,833 @@
+TITLE gcmem.mod  granule cell membrane
+
+COMMENT
+ichan2, borgka, nca, lca, cat, gskch, cagk and ccanl as one mechanism, so a
+granule cell compartment is updated in one nrn_state and one nrn_cur loop
+instead of eight. Insert it instead of the separate mechanisms with
+granulecellparams_fused.txt (GranuleCell(fused=True)).
+
+The equations are copied from the separate .mod files and are evaluated in
+the order NEURON calls the separate mechanisms, i.e. the order of
+registration in mod_func.c (file names sorted):
+	cagk, lca, borgka, ccanl, gskch, ichan2, nca, cat
+The cnexp updates are written out the way nocmodl emits them and ccanl keeps
+its cnexp block, so the states are the same to the last bit. ccanl
+has no current, its BREAKPOINT (cai, eca and the reversal potentials) runs
+in nrn_state and does so here too (start of PROCEDURE post).
+
+The generated nrn_cur would sum all currents before taking the finite
+difference. The VERBATIM nrn_cur below instead evaluates each channel like
+its own nrn_cur would (g from i(v+.001) - i(v)), subtracts the per-channel
+rhs from the node and keeps the per-channel g in gfd[] so that nrn_jacob adds
+them to the diagonal one by one, in the same order. It is installed from
+INITIAL.
+
+Renamed to resolve clashes between the files:
+	lca	m -> ml, minf -> mlinf, matu -> mltau, rate -> lrate
+	cat	m -> mt, h -> ht, minf, hinf, m_tau, h_tau -> mtinf, htinf, mttau, httau
+	borgka	ik -> ika, rates -> karates
+	nca	rates, trates -> ncarates, ncatrates
+	gskch	rate -> qrate
+	cagk	ik -> ikca, cai -> caik, rate, alp, bet -> orate, oalp, obet,
+		FARADAY, R -> FARADAYK, RK
+	ccanl	cai -> caitot, cao -> caout
+ik is ikca + ika. gkabar defaults to 0 as borgka is only inserted in the soma;
+where it is 0 the n and l states and the borgka current are not computed.
+
+Bit-compatible with the separate mechanisms as long as no other mechanism in
+the same compartment writes nca, lca or tca currents.
+
+Lazy update: with POINTER qc set to the `space` of the cell's CellQuiet
+(cellquiet.mod, pydentate.neuron_tools.use_quiescence), the compartments of
+a cell at rest are frozen: nrn_state leaves them out and nrn_cur applies the
+channel currents of the last update, i + g*(v - vq) with vq the voltage they
+were computed at. The other compartments are updated by the generated
+nrn_state as before, which compare their states before and after to tell
+CellQuiet whether the cell is still moving. The freeze decision and the
+start of the check are made by these kernels too (cellquiet_cur,
+cellquiet_state), not by CellQuiet's own, so they do not depend on the
+order of the mechanisms.
+ENDCOMMENT
+
+UNITS {
+	(mA) = (milliamp)
+	(mV) = (millivolt)
+	(molar) = (1/liter)
+	(mM) = (millimolar)
+	FARADAY = 96520 (coul)
+	R = 8.3134 (joule/degC)
+	FARADAYK = (faraday) (kilocoulombs)
+	RK = 8.313424 (joule/degC)
+}
+
+NEURON {
+	SUFFIX gcmem
+	THREADSAFE
+	USEION nat READ enat WRITE inat VALENCE 1
+	USEION kf READ ekf WRITE ikf VALENCE 1
+	USEION ks READ eks WRITE iks VALENCE 1
+	USEION k READ ek WRITE ik
+	USEION sk READ esk WRITE isk VALENCE 1
+	USEION nca READ ncai, enca WRITE inca, ncai, enca VALENCE 2
+	USEION lca READ lcai, elca WRITE ilca, lcai, elca VALENCE 2
+	USEION tca READ tcai, etca WRITE itca, tcai, etca VALENCE 2
+	USEION ca READ cai, cao VALENCE 2
+	NONSPECIFIC_CURRENT il
+	: ichan2
+	RANGE gnatbar, gkfbar, gksbar, gl, el
+	RANGE gnat, gkf, gks, inat, ikf, iks
+	RANGE minf, mtau, hinf, htau, nfinf, nftau, nsinf, nstau
+	: borgka
+	RANGE gkabar, gka, ika
+	GLOBAL ninf, linf, taul, taun
+	: nca
+	RANGE gncabar, gnca, inca, cinf, ctau, dinf, dtau
+	: lca
+	RANGE glcabar, ilca, elca, cai
+	GLOBAL mlinf, mltau
+	: cat
+	RANGE gcatbar, itca, etca
+	: gskch
+	RANGE gskbar, gsk, isk, qinf, qtau
+	: cagk
+	RANGE gkbar, gkca, ikca, ik
+	GLOBAL oinf, otau
+	: ccanl
+	RANGE caiinf, catau, caitot, ncai, lcai, tcai, eca, enca, ktf0
+	RANGE gfd
+	POINTER qc
+}
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
+INDEPENDENT {t FROM 0 TO 100 WITH 100 (ms)}
+
+PARAMETER {
+	v (mV)
+	celsius (degC)
+	dt (ms)
+	: ichan2
+	enat (mV)
+	gnatbar (mho/cm2)
+	ekf (mV)
+	gkfbar (mho/cm2)
+	eks (mV)
+	gksbar (mho/cm2)
+	gl (mho/cm2)
+	el (mV)
+	: borgka
+	ek (mV)
+	gkabar = 0 (mho/cm2)
+	vhalfn = -33.6 (mV)
+	vhalfl = -83 (mV)
+	a0l = 0.08 (/ms)
+	a0n = 0.02 (/ms)
+	zetan = -3 (1)
+	zetal = 4 (1)
+	gmn = 0.6 (1)
+	gml = 1 (1)
+	: nca
+	gncabar (mho/cm2)
+	: lca
+	glcabar (mho/cm2)
+	ki = .001 (mM)
+	cai (mM)
+	cao (mM)
+	tfa = 1
+	: cat
+	gcatbar = .003 (mho/cm2)
+	: gskch
+	gskbar (mho/cm2)
+	esk (mV)
+	: cagk
+	gkbar = .01 (mho/cm2)
+	d1 = .84
+	d2 = 1.
+	k1 = .48e-3 (mM)
+	k2 = .13e-6 (mM)
+	abar = .28 (/ms)
+	bbar = .48 (/ms)
+	st = 1 (1)
+	: ccanl
+	depth = 200 (nm)
+	catau = 9 (ms)
+	caiinf = 50.e-6 (mM)
+	caout = 2 (mM)
+}
+
+STATE {
+	m h nf ns
+	n l
+	c d
+	ml
+	mt ht
+	q
+	o
+	ncai (mM)
+	lcai (mM)
+	tcai (mM)
+}
+
+ASSIGNED {
+	: ichan2
+	gnat (mho/cm2)
+	gkf (mho/cm2)
+	gks (mho/cm2)
+	inat (mA/cm2)
+	ikf (mA/cm2)
+	iks (mA/cm2)
+	il (mA/cm2)
+	minf hinf nfinf nsinf
+	mtau (ms) htau (ms) nftau (ms) nstau (ms)
+	mexp hexp nfexp nsexp
+	: borgka
+	gka (mho/cm2)
+	ika (mA/cm2)
+	ninf linf
+	taul taun
+	: nca
+	gnca (mho/cm2)
+	inca (mA/cm2)
+	cinf dinf
+	ctau (ms) dtau (ms)
+	cexp dexp
+	: lca
+	glca (mho/cm2)
+	ilca (mA/cm2)
+	elca (mV)
+	mlinf
+	mltau (ms)
+	: cat
+	gcat (mho/cm2)
+	itca (mA/cm2)
+	etca (mV)
+	: gskch
+	gsk (mho/cm2)
+	isk (mA/cm2)
+	qinf
+	qtau (ms)
+	qexp
+	: cagk
+	gkca (mho/cm2)
+	ikca (mA/cm2)
+	ik (mA/cm2)
+	oinf
+	otau (ms)
+	caik (mM)
+	: ccanl
+	caitot (mM)
+	eca (mV)
+	enca (mV)
+	ktf0 (mV)
+	: per-channel dI/dv, in calling order without ccanl
+	gfd[7] (mho/cm2)
+	: lazy update: dI/dv of inat, ikf and iks, v of the last current update
+	dfd[3] (mho/cm2)
+	vq (mV)
+	qc
+}
+
+VERBATIM
+static void _gcmem_install(NrnThread*, int);
+ENDVERBATIM
+
+BREAKPOINT {
+	SOLVE pre
+	SOLVE integrate METHOD cnexp
+	SOLVE post
+	cur_cagk(v)
+	cur_lca(v)
+	cur_borgka(v)
+	cur_gskch(v)
+	cur_ichan2(v)
+	cur_nca(v)
+	cur_cat(v)
+	ik = ikca + ika
+}
+
+UNITSOFF
+
+INITIAL {
+	: cagk, before ccanl has set the concentrations
+	caik = ncai + lcai + tcai
+	orate(v, caik)
+	o = oinf
+	: lca
+	lrate(v)
+	ml = mlinf
+	: borgka
+	karates(v)
+	n = ninf
+	l = linf
+	: ccanl
+	ncai = caiinf/3
+	lcai = caiinf/3
+	tcai = caiinf/3
+	caitot = caiinf
+	eca = 130
+	enca = eca
+	elca = eca
+	etca = eca
+	ktf0 = ktf()
+	: gskch
+	qrate(ncai + lcai + tcai)
+	q = qinf
+	: ichan2
+	trates(v)
+	m = minf
+	h = hinf
+	nf = nfinf
+	ns = nsinf
+	: nca
+	ncatrates(v)
+	c = cinf
+	d = dinf
+	: cat
+	mt = mtinf(v)
+	ht = htinf(v)
+VERBATIM
+	_gcmem_install(_nt, _p_qc != 0);
+ENDVERBATIM
+}
+
+: cagk, lca and borgka, cnexp as generated, borgka only where it has a
+: conductance
+PROCEDURE pre() {
+	orate(v, caik)
+	o = o + (1. - exp(dt*((-1.0)/otau)))*(-((oinf)/otau)/((-1.0)/otau) - o)
+	lrate(v)
+	ml = ml + (1. - exp(dt*((-1.0)/mltau)))*(-((mlinf)/mltau)/((-1.0)/mltau) - ml)
+	if (gkabar != 0) {
+		karates(v)
+		n = n + (1. - exp(dt*((-1.0)/taun)))*(-((ninf)/taun)/((-1.0)/taun) - n)
+		l = l + (1. - exp(dt*((-1.0)/taul)))*(-((linf)/taul)/((-1.0)/taul) - l)
+	}
+}
+
+: ccanl
+DERIVATIVE integrate {
+	ncai' = -(inca)/depth/FARADAY * (1e7) + (caiinf/3 - ncai)/catau
+	lcai' = -(ilca)/depth/FARADAY * (1e7) + (caiinf/3 - lcai)/catau
+	tcai' = -(itca)/depth/FARADAY * (1e7) + (caiinf/3 - tcai)/catau
+}
+
+: rest of ccanl, gskch, ichan2, nca and cat (cnexp as generated)
+PROCEDURE post() {
+	caitot = ncai + lcai + tcai
+	eca = ktf0 * log(caout/caitot)
+	enca = eca
+	elca = eca
+	etca = eca
+	qrate(ncai + lcai + tcai)
+	q = q + (qinf - q) * qexp
+	trates(v)
+	m = m + mexp*(minf-m)
+	h = h + hexp*(hinf-h)
+	nf = nf + nfexp*(nfinf-nf)
+	ns = ns + nsexp*(nsinf-ns)
+	ncatrates(v)
+	c = c + cexp*(cinf-c)
+	d = d + dexp*(dinf-d)
+	mt = mt + (1. - exp(dt*((-1.0)/mttau(v))))*(-((mtinf(v))/mttau(v))/((-1.0)/mttau(v)) - mt)
+	ht = ht + (1. - exp(dt*((-1.0)/httau(v))))*(-((htinf(v))/httau(v))/((-1.0)/httau(v)) - ht)
+}
+
+: currents, one procedure per channel as in its BREAKPOINT
+
+PROCEDURE cur_cagk(v (mV)) {
+	gkca = gkbar*o^st
+	ikca = gkca*(v - ek)
+}
+
+PROCEDURE cur_lca(v (mV)) {
+	glca = glcabar*ml*ml*h2(cai)
+	ilca = glca*ghk(v, cai, cao)
+}
+
+PROCEDURE cur_borgka(v (mV)) {
+	gka = gkabar*n*l
+	ika = gka*(v-ek)
+}
+
+PROCEDURE cur_gskch(v (mV)) {
+	gsk = gskbar * q*q
+	isk = gsk * (v-esk)
+}
+
+PROCEDURE cur_ichan2(v (mV)) {
+	gnat = gnatbar*m*m*m*h
+	inat = gnat*(v - enat)
+	gkf = gkfbar*nf*nf*nf*nf
+	ikf = gkf*(v-ekf)
+	gks = gksbar*ns*ns*ns*ns
+	iks = gks*(v-eks)
+	il = gl*(v-el)
+}
+
+PROCEDURE cur_nca(v (mV)) {
+	gnca = gncabar*c*c*d
+	inca = gnca*(v-enca)
+}
+
+PROCEDURE cur_cat(v (mV)) {
+	gcat = gcatbar*mt*mt*ht
+	itca = gcat*ghk(v, cai, cao)
+}
+
+: ichan2
+
+LOCAL q10
+
+PROCEDURE rates(v) {
+	LOCAL alpha, beta, sum
+	q10 = 3^((celsius - 6.3)/10)
+	alpha = -0.3*vtrap((v+60-17),-5)
+	beta = 0.3*vtrap((v+60-45),5)
+	sum = alpha+beta
+	mtau = 1/sum      minf = alpha/sum
+	alpha = 0.23/exp((v+60+5)/20)
+	beta = 3.33/(1+exp((v+60-47.5)/-10))
+	sum = alpha+beta
+	htau = 1/sum
+	hinf = alpha/sum
+	alpha = -0.028*vtrap((v+65-35),-6)
+	beta = 0.1056/exp((v+65-10)/40)
+	sum = alpha+beta
+	nstau = 1/sum      nsinf = alpha/sum
+	alpha = -0.07*vtrap((v+65-47),-6)
+	beta = 0.264/exp((v+65-22)/40)
+	sum = alpha+beta
+	nftau = 1/sum      nfinf = alpha/sum
+}
+
+PROCEDURE trates(v) {
+	LOCAL tinc
+	TABLE minf, mexp, hinf, hexp, nfinf, nfexp, nsinf, nsexp, mtau, htau, nftau, nstau
+	DEPEND dt, celsius FROM -100 TO 100 WITH 200
+	rates(v)
+	tinc = -dt * q10
+	mexp = 1 - exp(tinc/mtau)
+	hexp = 1 - exp(tinc/htau)
+	nfexp = 1 - exp(tinc/nftau)
+	nsexp = 1 - exp(tinc/nstau)
+}
+
+FUNCTION vtrap(x,y) {
+	if (fabs(x/y) < 1e-6) {
+		vtrap = y*(1 - x/y/2)
+	}else{
+		vtrap = x/(exp(x/y) - 1)
+	}
+}
+
+: borgka
+
+FUNCTION alpn(v(mV)) {
+	alpn = exp(1.e-3*zetan*(v-vhalfn)*9.648e4/(8.315*(273.16+celsius)))
+}
+
+FUNCTION betn(v(mV)) {
+	betn = exp(1.e-3*zetan*gmn*(v-vhalfn)*9.648e4/(8.315*(273.16+celsius)))
+}
+
+FUNCTION alpl(v(mV)) {
+	alpl = exp(1.e-3*zetal*(v-vhalfl)*9.648e4/(8.315*(273.16+celsius)))
+}
+
+FUNCTION betl(v(mV)) {
+	betl = exp(1.e-3*zetal*gml*(v-vhalfl)*9.648e4/(8.315*(273.16+celsius)))
+}
+
+PROCEDURE karates(v (mV)) {
+	LOCAL a,q10
+	q10=3^((celsius-30)/10)
+	a = alpn(v)
+	ninf = 1/(1 + a)
+	taun = betn(v)/(q10*a0n*(1+a))
+	a = alpl(v)
+	linf = 1/(1+ a)
+	taul = betl(v)/(q10*a0l*(1 + a))
+}
+
+: nca
+
+PROCEDURE ncarates(v) {
+	LOCAL alpha, beta, sum
+	q10 = 3^((celsius - 6.3)/10)
+	alpha = -0.19*vtrap(v-19.88,-10)
+	beta = 0.046*exp(-v/20.73)
+	sum = alpha+beta
+	ctau = 1/sum      cinf = alpha/sum
+	alpha = 0.00016/exp(-v/48.4)
+	beta = 1/(exp((-v+39)/10)+1)
+	sum = alpha+beta
+	dtau = 1/sum      dinf = alpha/sum
+}
+
+PROCEDURE ncatrates(v) {
+	LOCAL tinc
+	TABLE cinf, cexp, dinf, dexp, ctau, dtau
+	DEPEND dt, celsius FROM -100 TO 100 WITH 200
+	ncarates(v)
+	tinc = -dt * q10
+	cexp = 1 - exp(tinc/ctau)
+	dexp = 1 - exp(tinc/dtau)
+}
+
+: lca and cat
+
+FUNCTION h2(cai(mM)) {
+	h2 = ki/(ki+cai)
+}
+
+FUNCTION ghk(v(mV), ci(mM), co(mM)) (mV) {
+	LOCAL nu,f
+	f = KTF(celsius)/2
+	nu = v/f
+	ghk=-f*(1. - (ci/co)*exp(nu))*efun(nu)
+}
+
+FUNCTION KTF(celsius (DegC)) (mV) {
+	KTF = ((25./293.15)*(celsius + 273.15))
+}
+
+FUNCTION efun(z) {
+	if (fabs(z) < 1e-4) {
+		efun = 1 - z/2
+	}else{
+		efun = z/(exp(z) - 1)
+	}
+}
+
+FUNCTION alp(v(mV)) (1/ms) {
+	TABLE FROM -150 TO 150 WITH 200
+	alp = 15.69*(-1.0*v+81.5)/(exp((-1.0*v+81.5)/10.0)-1.0)
+}
+
+FUNCTION bet(v(mV)) (1/ms) {
+	TABLE FROM -150 TO 150 WITH 200
+	bet = 0.29*exp(-v/10.86)
+}
+
+PROCEDURE lrate(v (mV)) {
+	LOCAL a
+	a = alp(v)
+	mltau = 1/(tfa*(a + bet(v)))
+	mlinf = tfa*a*mltau
+}
+
+FUNCTION htinf(v(mV)) {
+	LOCAL a,b
+	TABLE FROM -150 TO 150 WITH 200
+	a = 1.e-6*exp(-v/16.26)
+	b = 1/(exp((-v+29.79)/10)+1)
+	htinf = a/(a+b)
+}
+
+FUNCTION mtinf(v(mV)) {
+	LOCAL a,b
+	TABLE FROM -150 TO 150 WITH 200
+	a = 0.2*(-1.0*v+19.26)/(exp((-1.0*v+19.26)/10.0)-1.0)
+	b = 0.009*exp(-v/22.03)
+	mtinf = a/(a+b)
+}
+
+FUNCTION mttau(v(mV)) (ms) {
+	LOCAL a,b
+	TABLE FROM -150 TO 150 WITH 200
+	a = 0.2*(-1.0*v+19.26)/(exp((-1.0*v+19.26)/10.0)-1.0)
+	b = 0.009*exp(-v/22.03)
+	mttau = 1/(a+b)
+}
+
+FUNCTION httau(v(mV)) (ms) {
+	LOCAL a,b
+	TABLE FROM -150 TO 150 WITH 200
+	a = 1.e-6*exp(-v/16.26)
+	b = 1/(exp((-v+29.79)/10.)+1.)
+	httau = 1/(a+b)
+}
+
+: gskch
+
+PROCEDURE qrate(cai) {
+	LOCAL alpha, beta, tinc
+	q10 = 3^((celsius - 6.3)/10)
+	alpha = 1.25e1 * cai * cai
+	beta = 0.00025
+	qtau = 1 / (alpha + beta)
+	qinf = alpha * qtau
+	tinc = -dt*q10
+	qexp = 1 - exp(tinc/qtau)*q10
+}
+
+: cagk
+
+FUNCTION oalp(v (mV), ca (mM)) (1/ms) {
+	oalp = ca*abar/(ca + exp1(k1,d1,v))
+}
+
+FUNCTION obet(v (mV), ca (mM)) (1/ms) {
+	obet = bbar/(1 + ca/exp1(k2,d2,v))
+}
+
+FUNCTION exp1(kd (mM), dd, v (mV)) (mM) {
+	exp1 = kd*exp(-2*dd*FARADAYK*v/RK/(273.15 + celsius))
+}
+
+PROCEDURE orate(v (mV), ca (mM)) {
+	LOCAL a
+	a = oalp(v,ca)
+	otau = 1/(a + obet(v, ca))
+	oinf = a*otau
+}
+
+: ccanl
+
+FUNCTION ktf() (mV) {
+	ktf = (1000)*R*(celsius +273.15)/(2*FARADAY)
+}
+
+UNITSON
+
+VERBATIM
+#include <stdlib.h>
+#include "nrnsoa.h"
+#include "cellquiet.h"
+
+/* dI/dv and rhs of one channel the way its own nrn_cur computes them:
+i(v + .001) first, then i(v), which leaves the channel's variables at v */
+#define _GCMEM_FD(_cur, _i, _ion_i, _ion_didv, _k) \
+	_cur(_threadargscomma_ _v + .001); \
+	_gv = 0.; _gv += _i; \
+	_di = _i; \
+	_cur(_threadargscomma_ _v); \
+	_rhs = 0.; _rhs += _i; \
+	_ion_didv += (_di - _i)/.001; \
+	gfd[_k] = (_gv - _rhs)/.001; \
+	_ion_i += _i; \
+	*_prhs -= _rhs;
+
+/* a channel of a frozen compartment: current of the last update, linear in v */
+#define _GCMEM_HOLD(_i, _ion_i, _ion_didv, _g) \
+	_ion_didv += _g; \
+	_ion_i += _i + _g*_dv; \
+	_rhs += _i + _g*_dv;
+
+static void _gcmem_cur(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar; Datum* _thread;
+	Node* _nd; int* _ni; double _v, _gv, _di, _rhs, *_prhs, _dv;
+	double _dinat, _dikf, _diks;
+	cellquiet_t* _q;
+	int _iml, _cntml;
+#if CACHEVEC
+	_ni = _ml->_nodeindices;
+#endif
+	_cntml = _ml->_nodecount;
+	_thread = _ml->_thread;
+	for (_iml = 0; _iml < _cntml; ++_iml) {
+		_p = _ml->_data[_iml]; _ppvar = _ml->_pdata[_iml];
+#if CACHEVEC
+		if (use_cachevec) {
+			_v = VEC_V(_ni[_iml]);
+			_prhs = &VEC_RHS(_ni[_iml]);
+		}else
+#endif
+		{
+			_nd = _ml->_nodelist[_iml];
+			_v = NODEV(_nd);
+			_prhs = &NODERHS(_nd);
+		}
+		enat = _ion_enat;
+		ekf = _ion_ekf;
+		eks = _ion_eks;
+		ek = _ion_ek;
+		esk = _ion_esk;
+		enca = _ion_enca;
+		elca = _ion_elca;
+		etca = _ion_etca;
+		cai = _ion_cai;
+		cao = _ion_cao;
+		_q = _p_qc ? CELLQUIET(_p_qc) : 0;
+		if (_q) {
+			cellquiet_cur(_q, _nt->_t);
+		}
+		if (_q && _q->_frozen) {
+			_dv = _v - vq;
+			_rhs = 0.;
+			_GCMEM_HOLD(ikca, _ion_ik, _ion_dikdv, gfd[0])
+			_GCMEM_HOLD(ilca, _ion_ilca, _ion_dilcadv, gfd[1])
+			_GCMEM_HOLD(ika, _ion_ik, _ion_dikdv, gfd[2])
+			_GCMEM_HOLD(isk, _ion_isk, _ion_diskdv, gfd[3])
+			_GCMEM_HOLD(inat, _ion_inat, _ion_dinatdv, dfd[0])
+			_GCMEM_HOLD(ikf, _ion_ikf, _ion_dikfdv, dfd[1])
+			_GCMEM_HOLD(iks, _ion_iks, _ion_diksdv, dfd[2])
+			_rhs += il + gl*_dv;
+			_GCMEM_HOLD(inca, _ion_inca, _ion_dincadv, gfd[5])
+			_GCMEM_HOLD(itca, _ion_itca, _ion_ditcadv, gfd[6])
+			*_prhs -= _rhs;
+			v = _v;
+			continue;
+		}
+		vq = _v;
+		_GCMEM_FD(cur_cagk, ikca, _ion_ik, _ion_dikdv, 0)
+		_GCMEM_FD(cur_lca, ilca, _ion_ilca, _ion_dilcadv, 1)
+		if (gkabar != 0.) {
+			_GCMEM_FD(cur_borgka, ika, _ion_ik, _ion_dikdv, 2)
+		}else{
+			gka = 0.;
+			ika = 0.;
+			gfd[2] = 0.;
+		}
+		_GCMEM_FD(cur_gskch, isk, _ion_isk, _ion_diskdv, 3)
+		/* ichan2 has four currents in one _nrn_current */
+		cur_ichan2(_threadargscomma_ _v + .001);
+		_gv = 0.; _gv += inat; _gv += ikf; _gv += iks; _gv += il;
+		_dinat = inat; _dikf = ikf; _diks = iks;
+		cur_ichan2(_threadargscomma_ _v);
+		_rhs = 0.; _rhs += inat; _rhs += ikf; _rhs += iks; _rhs += il;
+		dfd[0] = (_dinat - inat)/.001;
+		dfd[1] = (_dikf - ikf)/.001;
+		dfd[2] = (_diks - iks)/.001;
+		_ion_dinatdv += dfd[0];
+		_ion_dikfdv += dfd[1];
+		_ion_diksdv += dfd[2];
+		gfd[4] = (_gv - _rhs)/.001;
+		_ion_inat += inat;
+		_ion_ikf += ikf;
+		_ion_iks += iks;
+		*_prhs -= _rhs;
+		_GCMEM_FD(cur_nca, inca, _ion_inca, _ion_dincadv, 5)
+		_GCMEM_FD(cur_cat, itca, _ion_itca, _ion_ditcadv, 6)
+		ik = ikca + ika;
+		v = _v;
+	}
+}
+
+static void _gcmem_jacob(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Node* _nd; int* _ni; double* _pd;
+	int _iml, _cntml, _k;
+#if CACHEVEC
+	_ni = _ml->_nodeindices;
+#endif
+	_cntml = _ml->_nodecount;
+	for (_iml = 0; _iml < _cntml; ++_iml) {
+		_p = _ml->_data[_iml];
+#if CACHEVEC
+		if (use_cachevec) {
+			_pd = &VEC_D(_ni[_iml]);
+		}else
+#endif
+		{
+			_nd = _ml->_nodelist[_iml];
+			_pd = &NODED(_nd);
+		}
+		for (_k = 0; _k < 7; ++_k) {
+			*_pd += gfd[_k];
+		}
+	}
+}
+
+/* lazy update: the instances that are not frozen, as a Memb_list for the
+generated nrn_state, and their states before it */
+enum { _GCMEM_NSTATE = 16 };
+static const int _gcmem_scol[_GCMEM_NSTATE] = {
+	m_columnindex, h_columnindex, nf_columnindex, ns_columnindex,
+	n_columnindex, l_columnindex, c_columnindex, d_columnindex,
+	ml_columnindex, mt_columnindex, ht_columnindex, q_columnindex,
+	o_columnindex, ncai_columnindex, lcai_columnindex, tcai_columnindex
+};
+
+typedef struct {
+	int _cap;
+	double** _data;
+	Datum** _pdata;
+	Node** _nodelist;
+	int* _ni;
+	double* _snap;
+} _gcmem_sub_t;
+static _gcmem_sub_t _gcmem_sub[NRNSOA_MAXTHREAD];
+
+static void _gcmem_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar;
+	cellquiet_t* _q;
+	_Memb_list _sub;
+	_gcmem_sub_t* _s = _gcmem_sub + _nt->id;
+	double _v;
+	int _iml, _k, _j, _n = 0, _cntml = _ml->_nodecount;
+	if (_s->_cap < _cntml) {
+		_s->_cap = _cntml;
+		_s->_data = (double**)realloc(_s->_data, _cntml * sizeof(double*));
+		_s->_pdata = (Datum**)realloc(_s->_pdata, _cntml * sizeof(Datum*));
+		_s->_nodelist = (Node**)realloc(_s->_nodelist, _cntml * sizeof(Node*));
+		_s->_ni = (int*)realloc(_s->_ni, _cntml * sizeof(int));
+		_s->_snap = (double*)realloc(_s->_snap, (size_t)_cntml * _GCMEM_NSTATE * sizeof(double));
+	}
+	for (_iml = 0; _iml < _cntml; ++_iml) {
+		_p = _ml->_data[_iml]; _ppvar = _ml->_pdata[_iml];
+		_q = _p_qc ? CELLQUIET(_p_qc) : 0;
+		if (_q) {
+			cellquiet_state(_q, _nt->_t);
+#if CACHEVEC
+			if (use_cachevec) {
+				_v = VEC_V(_ml->_nodeindices[_iml]);
+			}else
+#endif
+			{
+				_v = NODEV(_ml->_nodelist[_iml]);
+			}
+			if (fabs(_v - vq) > _q->_tol) {
+				_q->_quiet = 0;
+			}
+			if (_q->_frozen) {
+				continue;
+			}
+			for (_j = 0; _j < _GCMEM_NSTATE; ++_j) {
+				_s->_snap[_n*_GCMEM_NSTATE + _j] = _p[_gcmem_scol[_j]];
+			}
+		}
+		_s->_data[_n] = _p;
+		_s->_pdata[_n] = _ppvar;
+		_s->_nodelist[_n] = _ml->_nodelist[_iml];
+#if CACHEVEC
+		_s->_ni[_n] = _ml->_nodeindices[_iml];
+#endif
+		++_n;
+	}
+	if (_n == _cntml) {
+		nrn_state(_nt, _ml, _type);
+	}else if (_n) {
+		_sub = *_ml;
+		_sub._nodecount = _n;
+		_sub._data = _s->_data;
+		_sub._pdata = _s->_pdata;
+		_sub._nodelist = _s->_nodelist;
+#if CACHEVEC
+		_sub._nodeindices = _s->_ni;
+#endif
+		nrn_state(_nt, &_sub, _type);
+	}
+	for (_k = 0; _k < _n; ++_k) {
+		_p = _s->_data[_k]; _ppvar = _s->_pdata[_k];
+		_q = _p_qc ? CELLQUIET(_p_qc) : 0;
+		if (!_q || !_q->_quiet) {
+			continue;
+		}
+		for (_j = 0; _j < _GCMEM_NSTATE; ++_j) {
+			_v = _s->_snap[_k*_GCMEM_NSTATE + _j];
+			if (fabs(_p[_gcmem_scol[_j]] - _v) > _q->_tol*(fabs(_v) + 1e-12)) {
+				_q->_quiet = 0;
+				break;
+			}
+		}
+	}
+}
+
+static void _gcmem_install(NrnThread* _nt, int _lazy) {
+	nrnsoa_thread_check(_nt, "gcmem");
+	nrnsoa_install(_mechtype, _gcmem_cur, _lazy ? _gcmem_state : 0);
+	nrnsoa_install_jacob(_mechtype, _gcmem_jacob);
+}
+ENDVERBATIM
@@ -15,6 +15,7 @@ UNITS {
 
 NEURON {
 	SUFFIX gskch
+	THREADSAFE
 	USEION sk READ esk WRITE isk VALENCE 1
 	USEION nca READ ncai VALENCE 2
 	USEION lca READ lcai VALENCE 2
@@ -22,6 +23,10 @@ NEURON {
 	RANGE gsk, gskbar, qinf, qtau, isk
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 INDEPENDENT {t FROM 0 TO 1 WITH 1 (ms)}
 
 PARAMETER {
@@ -70,9 +75,8 @@ PROCEDURE state() {  :Computes state variable q at current v and dt.
 
 }
 
-LOCAL q10
 PROCEDURE rate(cai) {  :Computes rate and other constants at current v.
-	LOCAL alpha, beta, tinc
+	LOCAL alpha, beta, tinc, q10
 	q10 = 3^((celsius - 6.3)/10)
 		:"q" activation system
 alpha = 1.25e1 * cai * cai
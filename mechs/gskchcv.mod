@@ -0,0 +1,75 @@
+TITLE gskchcv.mod  gskch for CVode
+
+COMMENT
+gskch with q in a DERIVATIVE block (METHOD cnexp), for CVode and the local
+variable time step, see ichan2cv.mod. q' = (qinf - q)*q10/qtau; gskch's
+fixed step factor 1 - exp(-dt*q10/qtau)*q10 only integrates this equation
+at celsius = 6.3, where q10 = 1 (the default of the network). Parameters
+as in gskch with the suffix gskchcv.
+ENDCOMMENT
+
+UNITS {
+	(molar) = (1/liter)
+	(mM) = (millimolar)
+	(mA) = (milliamp)
+	(mV) = (millivolt)
+}
+
+NEURON {
+	SUFFIX gskchcv
+	THREADSAFE
+	USEION sk READ esk WRITE isk VALENCE 1
+	USEION nca READ ncai VALENCE 2
+	USEION lca READ lcai VALENCE 2
+	USEION tca READ tcai VALENCE 2
+	RANGE gsk, gskbar, qinf, qtau, isk
+}
+
+PARAMETER {
+	celsius = 6.3 (degC)
+	v (mV)
+	gskbar (mho/cm2)
+	esk (mV)
+}
+
+STATE { q }
+
+ASSIGNED {
+	isk (mA/cm2)
+	gsk (mho/cm2)
+	ncai (mM)
+	lcai (mM)
+	tcai (mM)
+	qinf
+	qtau (ms)
+	tadj
+}
+
+BREAKPOINT {
+	SOLVE state METHOD cnexp
+	gsk = gskbar * q*q
+	isk = gsk * (v-esk)
+}
+
+UNITSOFF
+
+INITIAL {
+	rate(ncai + lcai + tcai)
+	q = qinf
+}
+
+DERIVATIVE state {
+	rate(ncai + lcai + tcai)
+	q' = (qinf - q)*tadj/qtau
+}
+
+PROCEDURE rate(cai (mM)) {
+	LOCAL alpha, beta
+	tadj = 3^((celsius - 6.3)/10)
+	alpha = 1.25e1 * cai * cai
+	beta = 0.00025
+	qtau = 1 / (alpha + beta)
+	qinf = alpha * qtau
+}
+
+UNITSON
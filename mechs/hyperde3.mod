@@ -25,6 +25,7 @@ UNITS {
 ? interface 
 NEURON { 
 SUFFIX hyperde3 
+THREADSAFE
 USEION hyf READ ehyf WRITE ihyf VALENCE 1
 USEION hys READ ehys WRITE ihys VALENCE 1
 USEION hyhtf READ ehyhtf WRITE ihyhtf VALENCE 1
@@ -34,6 +35,10 @@ RANGE ghyfbar, ghysbar, ghyhtfbar, ghyhtsbar
 RANGE hyfinf, hysinf, hyftau, hystau
 RANGE hyhtfinf, hyhtsinf, hyhtftau, hyhtstau, ihyf, ihys
 }
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
  
 INDEPENDENT {t FROM 0 TO 100 WITH 100 (ms)}
  
@@ -93,6 +98,11 @@ BREAKPOINT {
 		
 		}
  
+VERBATIM
+#include "vtable.h"
+static void _hyperde3_vtable_install(int);
+ENDVERBATIM
+
 UNITSOFF
  
 INITIAL {
@@ -102,6 +112,9 @@ INITIAL {
       hys = hysinf
 	hyhtf = hyhtfinf
 	hyhts = hyhtsinf
+VERBATIM
+	vtable_invalidate(_nt);
+ENDVERBATIM
 }
 
 ? states
@@ -167,5 +180,107 @@ FUNCTION vtrap(x,y) {  :Traps for 0 in denominator of rate eqns.
         }
 }
  
+PROCEDURE shared_tables(on) {	:1 nrn_state takes trates() from the tables of vtable.h
+VERBATIM
+	_hyperde3_vtable_install((int)_lon);
+ENDVERBATIM
+}
+
 UNITSON
 
+COMMENT
+nrn_state on the shared tables of vtable.h, see ichan2.mod: the values of
+trates() are one slice of the -120..100 mV grid of its TABLE, filled from
+_f_trates() by the thread table check whenever dt or celsius change, and
+the state update is that of PROCEDURE states(). No other mechanism
+tabulates on this grid, so the bins are not shared.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+#define _VT_NCOL 12
+static int _vt_id = -1;
+static vtable_grid_t* _vt_grid;
+static int _vt_on;
+
+static void _vt_check(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	int _k, _c;
+	double* _r;
+	_check_table_thread(_p, _ppvar, _thread, _nt, _type);
+	if (!_vt_on || !vtable_stale(_vt_id, dt, celsius)) {
+		return;
+	}
+	_c = vtable_col(_vt_id);
+	for (_k = 0; _k <= _vt_grid->_n; ++_k) {
+		_f_trates(_p, _ppvar, _thread, _nt, vtable_x(_vt_grid, _k));
+		_r = vtable_row(_vt_grid, _k) + _c;
+		_r[0] = hyfinf;
+		_r[1] = hyhtfinf;
+		_r[2] = hyfexp;
+		_r[3] = hyhtfexp;
+		_r[4] = hyftau;
+		_r[5] = hyhtftau;
+		_r[6] = hysinf;
+		_r[7] = hyhtsinf;
+		_r[8] = hysexp;
+		_r[9] = hyhtsexp;
+		_r[10] = hystau;
+		_r[11] = hyhtstau;
+	}
+	vtable_filled(_vt_id, dt, celsius);
+}
+
+static void _vt_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+#if CACHEVEC
+	double* _p; Datum* _ppvar;
+	int* _ni = _ml->_nodeindices;
+	int _i, _k, _c, _cntml = _ml->_nodecount;
+	double _theta;
+	if (use_cachevec && usetable && !vtable_stale(_vt_id, dt, celsius)) {
+		vtable_prepare(_vt_grid, _nt);
+		_c = vtable_col(_vt_id);
+		for (_i = 0; _i < _cntml; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			v = VEC_V(_ni[_i]);
+			ehyf = _ion_ehyf;
+			ehys = _ion_ehys;
+			ehyhtf = _ion_ehyhtf;
+			ehyhts = _ion_ehyhts;
+			_k = vtable_bin(_vt_grid, _nt, _ni[_i], v, &_theta);
+			hyfinf = vtable_at(_vt_grid, _k, _theta, _c);
+			hyhtfinf = vtable_at(_vt_grid, _k, _theta, _c + 1);
+			hyfexp = vtable_at(_vt_grid, _k, _theta, _c + 2);
+			hyhtfexp = vtable_at(_vt_grid, _k, _theta, _c + 3);
+			hyftau = vtable_at(_vt_grid, _k, _theta, _c + 4);
+			hyhtftau = vtable_at(_vt_grid, _k, _theta, _c + 5);
+			hysinf = vtable_at(_vt_grid, _k, _theta, _c + 6);
+			hyhtsinf = vtable_at(_vt_grid, _k, _theta, _c + 7);
+			hysexp = vtable_at(_vt_grid, _k, _theta, _c + 8);
+			hyhtsexp = vtable_at(_vt_grid, _k, _theta, _c + 9);
+			hystau = vtable_at(_vt_grid, _k, _theta, _c + 10);
+			hyhtstau = vtable_at(_vt_grid, _k, _theta, _c + 11);
+			hyf = hyf + hyfexp*(hyfinf-hyf);
+			hys = hys + hysexp*(hysinf-hys);
+			hyhtf = hyhtf + hyhtfexp*(hyhtfinf-hyhtf);
+			hyhts = hyhts + hyhtsexp*(hyhtsinf-hyhts);
+		}
+		return;
+	}
+#endif
+	nrn_state(_nt, _ml, _type);
+}
+
+static void _hyperde3_vtable_install(int _on) {
+	_vt_on = _on;
+	if (_on) {
+		_vt_id = vtable_register("hyperde3", _VT_NCOL, -120., 100., 220);
+		_vt_grid = vtable_grid(_vt_id);
+		_nrn_thread_table_reg(_mechtype, _vt_check);
+		nrnsoa_install(_mechtype, 0, _vt_state);
+	} else {
+		_nrn_thread_table_reg(_mechtype, _check_table_thread);
+		nrnsoa_install(_mechtype, 0, nrn_state);
+	}
+}
+ENDVERBATIM
@@ -0,0 +1,103 @@
+TITLE hyperde3cv.mod  hyperde3 for CVode
+
+COMMENT
+hyperde3 (Chen et al. 2001, see hyperde3.mod) with the gates in a
+DERIVATIVE block (METHOD cnexp), for CVode and the local variable time
+step, see ichan2cv.mod. Parameters as in hyperde3 with the suffix
+hyperde3cv.
+ENDCOMMENT
+
+UNITS {
+	(mA) = (milliamp)
+	(mV) = (millivolt)
+}
+
+NEURON {
+	SUFFIX hyperde3cv
+	THREADSAFE
+	USEION hyf READ ehyf WRITE ihyf VALENCE 1
+	USEION hys READ ehys WRITE ihys VALENCE 1
+	USEION hyhtf READ ehyhtf WRITE ihyhtf VALENCE 1
+	USEION hyhts READ ehyhts WRITE ihyhts VALENCE 1
+	RANGE ghyf, ghys, ghyhtf, ghyhts
+	RANGE ghyfbar, ghysbar, ghyhtfbar, ghyhtsbar
+	RANGE hyfinf, hysinf, hyftau, hystau
+	RANGE hyhtfinf, hyhtsinf, hyhtftau, hyhtstau, ihyf, ihys
+}
+
+PARAMETER {
+	v (mV)
+	celsius = 6.3 (degC)
+	ghyfbar (mho/cm2)
+	ghysbar (mho/cm2)
+	ehyf (mV)
+	ehys (mV)
+	ghyhtfbar (mho/cm2)
+	ghyhtsbar (mho/cm2)
+	ehyhtf (mV)
+	ehyhts (mV)
+}
+
+STATE {
+	hyf hys hyhtf hyhts
+}
+
+ASSIGNED {
+	ghyf (mho/cm2)
+	ghys (mho/cm2)
+	ghyhtf (mho/cm2)
+	ghyhts (mho/cm2)
+	ihyf (mA/cm2)
+	ihys (mA/cm2)
+	ihyhtf (mA/cm2)
+	ihyhts (mA/cm2)
+	hyfinf hysinf hyhtfinf hyhtsinf
+	hyftau (ms) hystau (ms) hyhtftau (ms) hyhtstau (ms)
+	tadj
+}
+
+BREAKPOINT {
+	SOLVE states METHOD cnexp
+	ghyf = ghyfbar * hyf*hyf
+	ihyf = ghyf * (v-ehyf)
+	ghys = ghysbar * hys*hys
+	ihys = ghys * (v-ehys)
+	ghyhtf = ghyhtfbar * hyhtf*hyhtf
+	ihyhtf = ghyhtf * (v-ehyhtf)
+	ghyhts = ghyhtsbar * hyhts*hyhts
+	ihyhts = ghyhts * (v-ehyhts)
+}
+
+UNITSOFF
+
+INITIAL {
+	rates(v)
+	hyf = hyfinf
+	hys = hysinf
+	hyhtf = hyhtfinf
+	hyhts = hyhtsinf
+}
+
+DERIVATIVE states {
+	rates(v)
+	hyf' = (hyfinf - hyf)*tadj/hyftau
+	hys' = (hysinf - hys)*tadj/hystau
+	hyhtf' = (hyhtfinf - hyhtf)*tadj/hyhtftau
+	hyhts' = (hyhtsinf - hyhts)*tadj/hyhtstau
+}
+
+PROCEDURE rates(v) {
+	TABLE hyfinf, hyhtfinf, hyftau, hyhtftau, hysinf, hyhtsinf, hystau, hyhtstau, tadj
+	DEPEND celsius FROM -120 TO 100 WITH 220
+	tadj = 3^((celsius - 6.3)/10)
+	hyfinf = 1 / (1 + exp( (v+91)/10 ))
+	hyftau = 14.9 + 14.1 / (1+exp(-(v+95.2)/0.5))
+	hysinf = 1 / (1 + exp( (v+91)/10 ))
+	hystau = 80 + 172.7 / (1+exp(-(v+59.3)/-0.83))
+	hyhtfinf = 1 / (1 + exp( (v+87)/10 ))
+	hyhtftau = 23.2 + 16.1 / (1+exp(-(v+91.2)/0.83))
+	hyhtsinf = 1 / (1 + exp( (v+87)/10 ))
+	hyhtstau = 227.3 + 170.7*exp(-0.5*((v+80.4)/11)^2)
+}
+
+UNITSON
@@ -19,6 +19,7 @@ UNITS {
 ? interface 
 NEURON { 
 SUFFIX ichan2 
+THREADSAFE
 USEION nat READ enat WRITE inat VALENCE 1
 USEION kf READ ekf WRITE ikf  VALENCE 1
 USEION ks READ eks WRITE iks  VALENCE 1
@@ -27,7 +28,12 @@ RANGE  gnat, gkf, gks
 RANGE gnatbar, gkfbar, gksbar
 RANGE gl, el
 RANGE minf, mtau, hinf, htau, nfinf, nftau, inat, ikf, nsinf, nstau, iks
+GLOBAL batch_tol
 }
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
  
 INDEPENDENT {t FROM 0 TO 100 WITH 100 (ms)}
  
@@ -43,6 +49,7 @@ PARAMETER {
 	gksbar (mho/cm2)
 	gl (mho/cm2)    
  	el (mV)
+	batch_tol = 1e-9	: verification tolerance of the batch kernels
 }
  
 STATE {
@@ -89,7 +96,10 @@ INITIAL {
 	h = hinf
       nf = nfinf
       ns = nsinf
-
+VERBATIM
+	_ichan2_batch_invalidate(_nt);
+	vtable_invalidate(_nt);
+ENDVERBATIM
 }
 
 ? states
@@ -157,6 +167,403 @@ FUNCTION vtrap(x,y) {  :Traps for 0 in denominator of rate eqns.
                 vtrap = x/(exp(x/y) - 1)
         }
 }
+
+VERBATIM
+static void _ichan2_batch_install(int);
+static void _ichan2_batch_invalidate(NrnThread*);
+static double _ichan2_batch_maxerr;
+#include "vtable.h"
+static void _ichan2_vtable_install(int);
+ENDVERBATIM
+
+PROCEDURE batch_mode(mode) {	:0 generated scalar kernels (default)
+				:1 SIMD batch kernels, see nrnsimd.h
+				:2 batch kernels checked against scalar on every step
+VERBATIM
+	_ichan2_batch_install((int)_lmode);
+ENDVERBATIM
+}
+
+PROCEDURE shared_tables(on) {	:1 nrn_state takes trates() from the tables of vtable.h
+VERBATIM
+	_ichan2_vtable_install((int)_lon);
+ENDVERBATIM
+}
+
+FUNCTION batch_error() {	:largest deviation seen in mode 2 since batch_mode()
+VERBATIM
+	_lbatch_error = _ichan2_batch_maxerr;
+ENDVERBATIM
+}
  
 UNITSON
 
+COMMENT
+Batch kernels. Process NRNSIMD_WIDTH instances of the Memb_list per
+iteration: the table lookup of trates() is done once per lane group and the
+gate updates and currents run on lane vectors. Instances are still stored
+one row per instance, so columns are gathered/scattered around the
+arithmetic. Groups with a NaN voltage and the tail of the list go through
+the generated nrn_state/nrn_cur, as does everything when usetable_ichan2 = 0.
+The maximal conductances and el are read from a column mirror (nrnsoa.h),
+refreshed at finitialize. The conductance returned to nrn_jacob is the analytic sum of gnat, gkf, gks
+and gl rather than the finite difference of the generated nrn_cur; the
+currents are linear in v so both agree to rounding.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsimd.h"
+#include "nrnsoa.h"
+
+enum { _SOA_GNATBAR, _SOA_GKFBAR, _SOA_GKSBAR, _SOA_GL, _SOA_EL, _SOA_NCOL };
+static nrnsoa_t _soa[NRNSOA_MAXTHREAD];
+
+static nrnsoa_t* _soa_fill(NrnThread* _nt, _Memb_list* _ml) {
+	nrnsoa_t* _s = _soa + _nt->id;
+	if (nrnsoa_check(_s, _ml, _SOA_NCOL, dt)) {
+		nrnsoa_gather(_s, _SOA_GNATBAR, gnatbar_columnindex);
+		nrnsoa_gather(_s, _SOA_GKFBAR, gkfbar_columnindex);
+		nrnsoa_gather(_s, _SOA_GKSBAR, gksbar_columnindex);
+		nrnsoa_gather(_s, _SOA_GL, gl_columnindex);
+		nrnsoa_gather(_s, _SOA_EL, el_columnindex);
+	}
+	return _s;
+}
+
+static void _ichan2_batch_invalidate(NrnThread* _nt) {
+	nrnsoa_thread_check(_nt, "ichan2");
+	_soa[_nt->id]._stale = 1;
+}
+
+static void _batch_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar;
+	double* _pl[NRNSIMD_WIDTH];
+	double _vl[NRNSIMD_WIDTH];
+	int _bin[NRNSIMD_WIDTH];
+	int _i, _k, _cntml = _ml->_nodecount;
+	nrnsimd_v _theta, _s, _inf, _ex;
+	if (!usetable) {
+		nrn_state(_nt, _ml, _type);
+		return;
+	}
+	for (_i = 0; _i + NRNSIMD_WIDTH <= _cntml; _i += NRNSIMD_WIDTH) {
+		for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+			_pl[_k] = _ml->_data[_i + _k];
+#if CACHEVEC
+			if (use_cachevec) {
+				_vl[_k] = VEC_V(_ml->_nodeindices[_i + _k]);
+			}else
+#endif
+			{
+				_vl[_k] = NODEV(_ml->_nodelist[_i + _k]);
+			}
+		}
+		if (nrnsimd_table_bins(_vl, _mfac_trates, _tmin_trates, 200, _bin, &_theta)) {
+			break;
+		}
+		for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+			_p = _pl[_k]; _ppvar = _ml->_pdata[_i + _k];
+			v = _vl[_k];
+			enat = _ion_enat;
+			ekf = _ion_ekf;
+			eks = _ion_eks;
+		}
+#define _BATCH_GATE(_x) \
+		_inf = nrnsimd_table_interp(_t_##_x##inf, _bin, _theta); \
+		_ex = nrnsimd_table_interp(_t_##_x##exp, _bin, _theta); \
+		nrnsimd_scatter_col(_pl, _x##inf_columnindex, _inf); \
+		nrnsimd_scatter_col(_pl, _x##exp_columnindex, _ex); \
+		_s = nrnsimd_gather_col(_pl, _x##_columnindex); \
+		_s = nrnsimd_add(_s, nrnsimd_mul(_ex, nrnsimd_sub(_inf, _s))); \
+		nrnsimd_scatter_col(_pl, _x##_columnindex, _s);
+#define _BATCH_TAU(_x) \
+		nrnsimd_scatter_col(_pl, _x##tau_columnindex, \
+			nrnsimd_table_interp(_t_##_x##tau, _bin, _theta));
+		_BATCH_GATE(m)
+		_BATCH_GATE(h)
+		_BATCH_GATE(nf)
+		_BATCH_GATE(ns)
+		_BATCH_TAU(m)
+		_BATCH_TAU(h)
+		_BATCH_TAU(nf)
+		_BATCH_TAU(ns)
+#undef _BATCH_GATE
+#undef _BATCH_TAU
+	}
+	nrnsimd_tail(nrn_state, _nt, _ml, _type, _i);
+}
+
+/* Currents of the lane group starting at instance _i, in the order
+gnat gkf gks inat ikf iks il g rhs, without touching _p or the ions. */
+#define _BATCH_NCUR 9
+static void _batch_cur_group(nrnsoa_t* _s, _Memb_list* _ml, int _i, double* _pl[], double _out[][NRNSIMD_WIDTH]) {
+	Datum* _ppvar;
+	double _vl[NRNSIMD_WIDTH], _el[3][NRNSIMD_WIDTH];
+	int _k;
+	nrnsimd_v _v, _m, _h, _gnat, _gkf, _gks, _inat, _ikf, _iks, _il, _gl;
+	for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+		_pl[_k] = _ml->_data[_i + _k];
+		_ppvar = _ml->_pdata[_i + _k];
+#if CACHEVEC
+		if (use_cachevec) {
+			_vl[_k] = VEC_V(_ml->_nodeindices[_i + _k]);
+		}else
+#endif
+		{
+			_vl[_k] = NODEV(_ml->_nodelist[_i + _k]);
+		}
+		_el[0][_k] = _ion_enat;
+		_el[1][_k] = _ion_ekf;
+		_el[2][_k] = _ion_eks;
+	}
+	_v = nrnsimd_load(_vl);
+	/* same association order as the generated _nrn_current */
+	_m = nrnsimd_gather_col(_pl, m_columnindex);
+	_h = nrnsimd_gather_col(_pl, h_columnindex);
+	_gnat = nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(
+		nrnsimd_load(nrnsoa_col(_s, _SOA_GNATBAR) + _i), _m), _m), _m), _h);
+	_m = nrnsimd_gather_col(_pl, nf_columnindex);
+	_gkf = nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(
+		nrnsimd_load(nrnsoa_col(_s, _SOA_GKFBAR) + _i), _m), _m), _m), _m);
+	_m = nrnsimd_gather_col(_pl, ns_columnindex);
+	_gks = nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(nrnsimd_mul(
+		nrnsimd_load(nrnsoa_col(_s, _SOA_GKSBAR) + _i), _m), _m), _m), _m);
+	_gl = nrnsimd_load(nrnsoa_col(_s, _SOA_GL) + _i);
+	_inat = nrnsimd_mul(_gnat, nrnsimd_sub(_v, nrnsimd_load(_el[0])));
+	_ikf = nrnsimd_mul(_gkf, nrnsimd_sub(_v, nrnsimd_load(_el[1])));
+	_iks = nrnsimd_mul(_gks, nrnsimd_sub(_v, nrnsimd_load(_el[2])));
+	_il = nrnsimd_mul(_gl, nrnsimd_sub(_v, nrnsimd_load(nrnsoa_col(_s, _SOA_EL) + _i)));
+	nrnsimd_store(_out[0], _gnat);
+	nrnsimd_store(_out[1], _gkf);
+	nrnsimd_store(_out[2], _gks);
+	nrnsimd_store(_out[3], _inat);
+	nrnsimd_store(_out[4], _ikf);
+	nrnsimd_store(_out[5], _iks);
+	nrnsimd_store(_out[6], _il);
+	nrnsimd_store(_out[7], nrnsimd_add(nrnsimd_add(nrnsimd_add(_gnat, _gkf), _gks), _gl));
+	nrnsimd_store(_out[8], nrnsimd_add(nrnsimd_add(nrnsimd_add(_inat, _ikf), _iks), _il));
+}
+
+static void _batch_cur(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p; Datum* _ppvar;
+	double* _pl[NRNSIMD_WIDTH];
+	double _out[_BATCH_NCUR][NRNSIMD_WIDTH];
+	int _i, _k, _cntml = _ml->_nodecount;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	for (_i = 0; _i + NRNSIMD_WIDTH <= _cntml; _i += NRNSIMD_WIDTH) {
+		_batch_cur_group(_s, _ml, _i, _pl, _out);
+		for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+			_p = _pl[_k]; _ppvar = _ml->_pdata[_i + _k];
+			enat = _ion_enat;
+			ekf = _ion_ekf;
+			eks = _ion_eks;
+			gnat = _out[0][_k];
+			gkf = _out[1][_k];
+			gks = _out[2][_k];
+			inat = _out[3][_k];
+			ikf = _out[4][_k];
+			iks = _out[5][_k];
+			il = _out[6][_k];
+			_g = _out[7][_k];
+			_ion_dinatdv += gnat;
+			_ion_dikfdv += gkf;
+			_ion_diksdv += gks;
+			_ion_inat += inat;
+			_ion_ikf += ikf;
+			_ion_iks += iks;
+#if CACHEVEC
+			if (use_cachevec) {
+				VEC_RHS(_ml->_nodeindices[_i + _k]) -= _out[8][_k];
+			}else
+#endif
+			{
+				NODERHS(_ml->_nodelist[_i + _k]) -= _out[8][_k];
+			}
+		}
+	}
+	nrnsimd_tail(nrn_cur, _nt, _ml, _type, _i);
+}
+
+/* Mode 2: run the batch kernel on a copy of the states, then the scalar
+kernel for real, and record how far apart they are. Only meant for
+single threaded test runs. */
+static void _batch_report(double _err) {
+	if (_err > _ichan2_batch_maxerr) {
+		if (_err > batch_tol && _ichan2_batch_maxerr <= batch_tol) {
+			fprintf(stderr, "ichan2: batch kernel deviates from scalar by %g at t=%g (batch_tol_ichan2 = %g)\n",
+				_err, nrn_threads->_t, batch_tol);
+		}
+		_ichan2_batch_maxerr = _err;
+	}
+}
+
+static void _verify_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	static const int _cols[] = {m_columnindex, h_columnindex, nf_columnindex, ns_columnindex};
+	int _i, _j, _cntml = _ml->_nodecount;
+	double _err = 0.;
+	double* _save = (double*)malloc(2 * 4 * (_cntml + 1) * sizeof(double));
+	double* _batch = _save + 4 * _cntml;
+	for (_i = 0; _i < _cntml; ++_i) {
+		for (_j = 0; _j < 4; ++_j) {
+			_save[4 * _i + _j] = _ml->_data[_i][_cols[_j]];
+		}
+	}
+	_batch_state(_nt, _ml, _type);
+	for (_i = 0; _i < _cntml; ++_i) {
+		for (_j = 0; _j < 4; ++_j) {
+			_batch[4 * _i + _j] = _ml->_data[_i][_cols[_j]];
+			_ml->_data[_i][_cols[_j]] = _save[4 * _i + _j];
+		}
+	}
+	nrn_state(_nt, _ml, _type);
+	for (_i = 0; _i < _cntml; ++_i) {
+		for (_j = 0; _j < 4; ++_j) {
+			double _e = nrnsimd_err(_batch[4 * _i + _j], _ml->_data[_i][_cols[_j]]);
+			if (_e > _err) {
+				_err = _e;
+			}
+		}
+	}
+	free(_save);
+	_batch_report(_err);
+}
+
+static void _verify_cur(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	static const int _cols[] = {gnat_columnindex, gkf_columnindex, gks_columnindex,
+		inat_columnindex, ikf_columnindex, iks_columnindex, il_columnindex, _g_columnindex};
+	double* _pl[NRNSIMD_WIDTH];
+	double _out[_BATCH_NCUR][NRNSIMD_WIDTH];
+	int _i, _j, _k, _ngroup, _cntml = _ml->_nodecount;
+	double _err = 0.;
+	double* _batch;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	_ngroup = _cntml / NRNSIMD_WIDTH;
+	_batch = (double*)malloc((8 * _ngroup * NRNSIMD_WIDTH + 1) * sizeof(double));
+	for (_i = 0; _i < _ngroup; ++_i) {
+		_batch_cur_group(_s, _ml, _i * NRNSIMD_WIDTH, _pl, _out);
+		for (_j = 0; _j < 8; ++_j) {
+			for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+				_batch[8 * (_i * NRNSIMD_WIDTH + _k) + _j] = _out[_j][_k];
+			}
+		}
+	}
+	nrn_cur(_nt, _ml, _type);
+	for (_i = 0; _i < _ngroup * NRNSIMD_WIDTH; ++_i) {
+		for (_j = 0; _j < 8; ++_j) {
+			double _e = nrnsimd_err(_batch[8 * _i + _j], _ml->_data[_i][_cols[_j]]);
+			if (_e > _err) {
+				_err = _e;
+			}
+		}
+	}
+	free(_batch);
+	_batch_report(_err);
+}
+
+static void _ichan2_batch_install(int _mode) {
+	switch (_mode) {
+	case 1:
+		nrnsoa_install(_mechtype, _batch_cur, _batch_state);
+		break;
+	case 2:
+		nrnsoa_install(_mechtype, _verify_cur, _verify_state);
+		break;
+	default:
+		nrnsoa_install(_mechtype, nrn_cur, nrn_state);
+		break;
+	}
+	_ichan2_batch_maxerr = 0.;
+}
+ENDVERBATIM
+
+COMMENT
+nrn_state on the shared tables of vtable.h. The twelve values of trates()
+are one slice of the -100..100 mV grid of its TABLE, which nca shares,
+filled from _f_trates() by the thread table check (serially, before the
+step) whenever dt or celsius change. The
+state update is that of PROCEDURE states(). Installing it replaces whatever
+nrn_state batch_mode() installed; shared_tables(0) goes back to the
+generated one. With usetable_ichan2 = 0 the generated nrn_state is used.
+ENDCOMMENT
+
+VERBATIM
+#define _VT_NCOL 12
+static int _vt_id = -1;
+static vtable_grid_t* _vt_grid;
+static int _vt_on;
+
+static void _vt_check(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	int _k, _c;
+	double* _r;
+	_check_table_thread(_p, _ppvar, _thread, _nt, _type);
+	if (!_vt_on || !vtable_stale(_vt_id, dt, celsius)) {
+		return;
+	}
+	/* _f_trates() writes its results into the row of instance 0, which
+	nrn_state overwrites for that instance anyway */
+	_c = vtable_col(_vt_id);
+	for (_k = 0; _k <= _vt_grid->_n; ++_k) {
+		_f_trates(_p, _ppvar, _thread, _nt, vtable_x(_vt_grid, _k));
+		_r = vtable_row(_vt_grid, _k) + _c;
+		_r[0] = minf; _r[1] = mexp;
+		_r[2] = hinf; _r[3] = hexp;
+		_r[4] = nfinf; _r[5] = nfexp;
+		_r[6] = nsinf; _r[7] = nsexp;
+		_r[8] = mtau; _r[9] = htau;
+		_r[10] = nftau; _r[11] = nstau;
+	}
+	vtable_filled(_vt_id, dt, celsius);
+}
+
+static void _vt_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+#if CACHEVEC
+	double* _p; Datum* _ppvar;
+	int* _ni = _ml->_nodeindices;
+	int _i, _k, _c, _cntml = _ml->_nodecount;
+	double _theta;
+	if (use_cachevec && usetable && !vtable_stale(_vt_id, dt, celsius)) {
+		vtable_prepare(_vt_grid, _nt);
+		_c = vtable_col(_vt_id);
+		for (_i = 0; _i < _cntml; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			v = VEC_V(_ni[_i]);
+			enat = _ion_enat;
+			ekf = _ion_ekf;
+			eks = _ion_eks;
+			_k = vtable_bin(_vt_grid, _nt, _ni[_i], v, &_theta);
+			minf = vtable_at(_vt_grid, _k, _theta, _c);
+			mexp = vtable_at(_vt_grid, _k, _theta, _c + 1);
+			hinf = vtable_at(_vt_grid, _k, _theta, _c + 2);
+			hexp = vtable_at(_vt_grid, _k, _theta, _c + 3);
+			nfinf = vtable_at(_vt_grid, _k, _theta, _c + 4);
+			nfexp = vtable_at(_vt_grid, _k, _theta, _c + 5);
+			nsinf = vtable_at(_vt_grid, _k, _theta, _c + 6);
+			nsexp = vtable_at(_vt_grid, _k, _theta, _c + 7);
+			mtau = vtable_at(_vt_grid, _k, _theta, _c + 8);
+			htau = vtable_at(_vt_grid, _k, _theta, _c + 9);
+			nftau = vtable_at(_vt_grid, _k, _theta, _c + 10);
+			nstau = vtable_at(_vt_grid, _k, _theta, _c + 11);
+			m = m + mexp*(minf-m);
+			h = h + hexp*(hinf-h);
+			nf = nf + nfexp*(nfinf-nf);
+			ns = ns + nsexp*(nsinf-ns);
+		}
+		return;
+	}
+#endif
+	nrn_state(_nt, _ml, _type);
+}
+
+static void _ichan2_vtable_install(int _on) {
+	_vt_on = _on;
+	if (_on) {
+		_vt_id = vtable_register("ichan2", _VT_NCOL, -100., 100., 200);
+		_vt_grid = vtable_grid(_vt_id);
+		_nrn_thread_table_reg(_mechtype, _vt_check);
+		nrnsoa_install(_mechtype, 0, _vt_state);
+	} else {
+		_nrn_thread_table_reg(_mechtype, _check_table_thread);
+		nrnsoa_install(_mechtype, 0, nrn_state);
+	}
+}
+ENDVERBATIM
@@ -0,0 +1,123 @@
+TITLE ichan2cv.mod  ichan2 for CVode
+
+COMMENT
+ichan2 with the gates in a DERIVATIVE block, for CVode and the local
+variable time step. m' = (minf - m)/(mtau/q10) is the equation that
+ichan2's PROCEDURE states() integrates exactly over a fixed dt; with
+METHOD cnexp the fixed step update is the same up to rounding, and nocmodl
+generates the ODE right hand side and its (diagonal) Jacobian for CVode.
+The rates are tabulated in v only, since the table no longer holds the
+dt dependent factors. Parameters as in ichan2 with the suffix ichan2cv;
+ouropy.genneuron.GenNeuron.mech_variants inserts it in place of ichan2.
+ENDCOMMENT
+
+UNITS {
+	(mA) = (milliamp)
+	(mV) = (millivolt)
+}
+
+NEURON {
+	SUFFIX ichan2cv
+	THREADSAFE
+	USEION nat READ enat WRITE inat VALENCE 1
+	USEION kf READ ekf WRITE ikf VALENCE 1
+	USEION ks READ eks WRITE iks VALENCE 1
+	NONSPECIFIC_CURRENT il
+	RANGE gnat, gkf, gks
+	RANGE gnatbar, gkfbar, gksbar
+	RANGE gl, el
+	RANGE minf, mtau, hinf, htau, nfinf, nftau, inat, ikf, nsinf, nstau, iks
+}
+
+PARAMETER {
+	v (mV)
+	celsius = 6.3 (degC)
+	enat (mV)
+	gnatbar (mho/cm2)
+	ekf (mV)
+	gkfbar (mho/cm2)
+	eks (mV)
+	gksbar (mho/cm2)
+	gl (mho/cm2)
+	el (mV)
+}
+
+STATE {
+	m h nf ns
+}
+
+ASSIGNED {
+	gnat (mho/cm2)
+	gkf (mho/cm2)
+	gks (mho/cm2)
+	inat (mA/cm2)
+	ikf (mA/cm2)
+	iks (mA/cm2)
+	il (mA/cm2)
+	minf hinf nfinf nsinf
+	mtau (ms) htau (ms) nftau (ms) nstau (ms)
+	tadj
+}
+
+BREAKPOINT {
+	SOLVE states METHOD cnexp
+	gnat = gnatbar*m*m*m*h
+	inat = gnat*(v - enat)
+	gkf = gkfbar*nf*nf*nf*nf
+	ikf = gkf*(v-ekf)
+	gks = gksbar*ns*ns*ns*ns
+	iks = gks*(v-eks)
+	il = gl*(v-el)
+}
+
+UNITSOFF
+
+INITIAL {
+	rates(v)
+	m = minf
+	h = hinf
+	nf = nfinf
+	ns = nsinf
+}
+
+DERIVATIVE states {
+	rates(v)
+	m' = (minf - m)*tadj/mtau
+	h' = (hinf - h)*tadj/htau
+	nf' = (nfinf - nf)*tadj/nftau
+	ns' = (nsinf - ns)*tadj/nstau
+}
+
+PROCEDURE rates(v) {
+	LOCAL alpha, beta, sum
+	TABLE minf, hinf, nfinf, nsinf, mtau, htau, nftau, nstau, tadj
+	DEPEND celsius FROM -100 TO 100 WITH 200
+	tadj = 3^((celsius - 6.3)/10)
+	alpha = -0.3*vtrap((v+60-17),-5)
+	beta = 0.3*vtrap((v+60-45),5)
+	sum = alpha+beta
+	mtau = 1/sum      minf = alpha/sum
+	alpha = 0.23/exp((v+60+5)/20)
+	beta = 3.33/(1+exp((v+60-47.5)/-10))
+	sum = alpha+beta
+	htau = 1/sum
+	hinf = alpha/sum
+	alpha = -0.028*vtrap((v+65-35),-6)
+	beta = 0.1056/exp((v+65-10)/40)
+	sum = alpha+beta
+	nstau = 1/sum      nsinf = alpha/sum
+	alpha = -0.07*vtrap((v+65-47),-6)
+	beta = 0.264/exp((v+65-22)/40)
+	sum = alpha+beta
+	nftau = 1/sum      nfinf = alpha/sum
+}
+
+FUNCTION vtrap(x,y) {
+	if (fabs(x/y) < 1e-6) {
+		vtrap = y*(1 - x/y/2)
+	}else{
+		vtrap = x/(exp(x/y) - 1)
+	}
+}
+
+UNITSON
@@ -19,11 +19,16 @@ UNITS {
 ? interface 
 NEURON { 
 SUFFIX nca
+THREADSAFE
 USEION nca READ enca WRITE inca VALENCE 2 
 RANGE  gnca
 RANGE gncabar
 RANGE cinf, ctau, dinf, dtau, inca
 }
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
  
 INDEPENDENT {t FROM 0 TO 100 WITH 100 (ms)}
  
@@ -55,12 +60,20 @@ BREAKPOINT {
 	inca = gnca*(v-enca)
 }
  
+VERBATIM
+#include "vtable.h"
+static void _nca_vtable_install(int);
+ENDVERBATIM
+
 UNITSOFF
  
 INITIAL {
 	trates(v)
 	c = cinf
 	d = dinf
+VERBATIM
+	vtable_invalidate(_nt);
+ENDVERBATIM
 }
 
 ? states
@@ -113,5 +126,89 @@ FUNCTION vtrap(x,y) {  :Traps for 0 in denominator of rate eqns.
         }
 }
  
+PROCEDURE shared_tables(on) {	:1 nrn_state takes trates() from the tables of vtable.h
+VERBATIM
+	_nca_vtable_install((int)_lon);
+ENDVERBATIM
+}
+
 UNITSON
 
+COMMENT
+nrn_state on the shared tables of vtable.h, see ichan2.mod: the values of
+trates() are one slice of the -100..100 mV grid of its TABLE, shared with
+ichan2, filled from _f_trates() by the thread table check whenever dt or
+celsius change, and the state update is that of PROCEDURE states().
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+#define _VT_NCOL 6
+static int _vt_id = -1;
+static vtable_grid_t* _vt_grid;
+static int _vt_on;
+
+static void _vt_check(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	int _k, _c;
+	double* _r;
+	_check_table_thread(_p, _ppvar, _thread, _nt, _type);
+	if (!_vt_on || !vtable_stale(_vt_id, dt, celsius)) {
+		return;
+	}
+	_c = vtable_col(_vt_id);
+	for (_k = 0; _k <= _vt_grid->_n; ++_k) {
+		_f_trates(_p, _ppvar, _thread, _nt, vtable_x(_vt_grid, _k));
+		_r = vtable_row(_vt_grid, _k) + _c;
+		_r[0] = cinf;
+		_r[1] = cexp;
+		_r[2] = dinf;
+		_r[3] = dexp;
+		_r[4] = ctau;
+		_r[5] = dtau;
+	}
+	vtable_filled(_vt_id, dt, celsius);
+}
+
+static void _vt_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+#if CACHEVEC
+	double* _p; Datum* _ppvar;
+	int* _ni = _ml->_nodeindices;
+	int _i, _k, _c, _cntml = _ml->_nodecount;
+	double _theta;
+	if (use_cachevec && usetable && !vtable_stale(_vt_id, dt, celsius)) {
+		vtable_prepare(_vt_grid, _nt);
+		_c = vtable_col(_vt_id);
+		for (_i = 0; _i < _cntml; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			v = VEC_V(_ni[_i]);
+			enca = _ion_enca;
+			_k = vtable_bin(_vt_grid, _nt, _ni[_i], v, &_theta);
+			cinf = vtable_at(_vt_grid, _k, _theta, _c);
+			cexp = vtable_at(_vt_grid, _k, _theta, _c + 1);
+			dinf = vtable_at(_vt_grid, _k, _theta, _c + 2);
+			dexp = vtable_at(_vt_grid, _k, _theta, _c + 3);
+			ctau = vtable_at(_vt_grid, _k, _theta, _c + 4);
+			dtau = vtable_at(_vt_grid, _k, _theta, _c + 5);
+			c = c + cexp*(cinf-c);
+			d = d + dexp*(dinf-d);
+		}
+		return;
+	}
+#endif
+	nrn_state(_nt, _ml, _type);
+}
+
+static void _nca_vtable_install(int _on) {
+	_vt_on = _on;
+	if (_on) {
+		_vt_id = vtable_register("nca", _VT_NCOL, -100., 100., 200);
+		_vt_grid = vtable_grid(_vt_id);
+		_nrn_thread_table_reg(_mechtype, _vt_check);
+		nrnsoa_install(_mechtype, 0, _vt_state);
+	} else {
+		_nrn_thread_table_reg(_mechtype, _check_table_thread);
+		nrnsoa_install(_mechtype, 0, nrn_state);
+	}
+}
+ENDVERBATIM
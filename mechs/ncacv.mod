@@ -0,0 +1,85 @@
+TITLE ncacv.mod  nca for CVode
+
+COMMENT
+nca with the gates in a DERIVATIVE block (METHOD cnexp), for CVode and the
+local variable time step, see ichan2cv.mod. Parameters as in nca with the
+suffix ncacv.
+ENDCOMMENT
+
+UNITS {
+	(mA) = (milliamp)
+	(mV) = (millivolt)
+}
+
+NEURON {
+	SUFFIX ncacv
+	THREADSAFE
+	USEION nca READ enca WRITE inca VALENCE 2
+	RANGE gnca
+	RANGE gncabar
+	RANGE cinf, ctau, dinf, dtau, inca
+}
+
+PARAMETER {
+	v (mV)
+	celsius = 6.3 (degC)
+	gncabar (mho/cm2)
+}
+
+STATE {
+	c d
+}
+
+ASSIGNED {
+	gnca (mho/cm2)
+	inca (mA/cm2)
+	enca (mV)
+	cinf dinf
+	ctau (ms) dtau (ms)
+	tadj
+}
+
+BREAKPOINT {
+	SOLVE states METHOD cnexp
+	gnca = gncabar*c*c*d
+	inca = gnca*(v-enca)
+}
+
+UNITSOFF
+
+INITIAL {
+	rates(v)
+	c = cinf
+	d = dinf
+}
+
+DERIVATIVE states {
+	rates(v)
+	c' = (cinf - c)*tadj/ctau
+	d' = (dinf - d)*tadj/dtau
+}
+
+PROCEDURE rates(v) {
+	LOCAL alpha, beta, sum
+	TABLE cinf, dinf, ctau, dtau, tadj
+	DEPEND celsius FROM -100 TO 100 WITH 200
+	tadj = 3^((celsius - 6.3)/10)
+	alpha = -0.19*vtrap(v-19.88,-10)
+	beta = 0.046*exp(-v/20.73)
+	sum = alpha+beta
+	ctau = 1/sum      cinf = alpha/sum
+	alpha = 0.00016/exp(-v/48.4)
+	beta = 1/(exp((-v+39)/10)+1)
+	sum = alpha+beta
+	dtau = 1/sum      dinf = alpha/sum
+}
+
+FUNCTION vtrap(x,y) {
+	if (fabs(x/y) < 1e-6) {
+		vtrap = y*(1 - x/y/2)
+	}else{
+		vtrap = x/(exp(x/y) - 1)
+	}
+}
+
+UNITSON
@@ -6,16 +6,24 @@ NEURON	{
   ARTIFICIAL_CELL NetStim125
   RANGE interval, number, start, forcestop 
   RANGE noise
-  THREADSAFE : only true if every instance has its own distinct Random
+  RANGE rng_id
+  THREADSAFE
   POINTER donotuse
 }
 
+VERBATIM
+#include "nrnexp.h"
+#include "cbrng.h"
+static uint32_t _netstim125_seed;
+ENDVERBATIM
+
 PARAMETER {
 	interval	= 10 (ms) <1e-9,1e9>: time between spikes (msec)
 	number	= 10 <0,1e9>	: number of spikes (independent of noise)
 	start		= 50 (ms)	: start of first spike
 	forcestop 	= 200 (ms)	: stop of firing spikes
 	noise		= 0 <0,1>	: amount of randomness (0.0 - 1.0)
+	rng_id		= -1		: key of the random numbers, -1 for exprand
 }
 
 ASSIGNED {
@@ -23,15 +31,20 @@ ASSIGNED {
 	on
 	ispike
 	donotuse
+	ndraw		: counter of the random numbers
 }
 
-PROCEDURE seed(x) {
+PROCEDURE seed(x) {	: seed of exprand and of the rng_id streams
 	set_seed(x)
+VERBATIM
+	_netstim125_seed = (uint32_t)_lx;
+ENDVERBATIM
 }
 
 INITIAL {
 	on = 0 : off
 	ispike = 0
+	ndraw = 0
 	if (noise < 0) {
 		noise = 0
 	}
@@ -86,16 +99,21 @@ VERBATIM
 		: distribution MUST be set to Random.negexp(1)
 		*/
 		_lerand = nrn_random_pick(_p_donotuse);
+	}else if (rng_id >= 0.) {
+		/* exponential from the counter-based generator of cbrng.h,
+		keyed by rng_id and the seed of seed(), so the stream of an
+		instance does not depend on the thread or host it is on */
+		double _u0, _u1;
+		cbrng_uniform2((uint32_t)rng_id, _netstim125_seed, (uint64_t)ndraw, 0, &_u0, &_u1);
+		ndraw = ndraw + 1.;
+		_lerand = -log(_u0);
 	}else{
-		/* only can be used in main thread */
-		if (_nt != nrn_threads) {
-hoc_execerror("multithread random in NetStim"," only via hoc Random");
+		/* without rng_id the one stream of exprand as before, which
+		only a single thread may draw from */
+		if (nrn_nthread > 1) {
+hoc_execerror("NetStim125: more than one thread needs rng_id (e.g. the gid) or a Random", 0);
 		}
 ENDVERBATIM
-		: the old standby. Cannot use if reproducible parallel sim
-		: independent of nhost or which host this instance is on
-		: is desired, since each instance on this cpu draws from
-		: the same stream
 		erand = exprand(1)
 VERBATIM
 	}
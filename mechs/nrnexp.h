@@ -0,0 +1,100 @@
+/*
+nrnexp.h
+
+exp() backend of the compiled mechanisms. The generated C of every
+mechanism starts with #define exp hoc_Exp: an out-of-line call that checks
+for overflow, prints a warning above exp(700) and sets errno. It cannot be
+inlined, which keeps the compiler from vectorizing the cnexp updates of
+tmgsyn/tmgexp2syn, the Boltzmann terms of bgka and similar loops. Mechanisms
+that include this header (top-level VERBATIM right after the NEURON block)
+take exp from the backend selected at compile time with NRNEXP, e.g.
+
+    nrnivmodl -incflags "-DNRNEXP=2" mechs
+
+    0  hoc_Exp (default, what the generated code uses)
+    1  libm exp; no range warning, exp(x) = inf above x = 709.78
+    2  inline polynomial, relative error < 5e-16 against libm
+    3  inline polynomial of lower degree, relative error < 1e-8
+
+2 and 3 keep the hoc_Exp range convention (0 below -700, exp(700) above
+700, NaN stays NaN) but without the warning, and are branch free so that
+loops calling them can be vectorized. gcc only if-converts the range
+selects with -fno-trapping-math, which is safe as long as floating point
+exceptions are not trapped (nrn_feenableexcept):
+
+    nrnivmodl -incflags "-DNRNEXP=2 -fno-trapping-math -march=native" mechs
+
+The error bounds are against libm exp, from a standalone build of this
+header on 2.2e7 points of [-700, 700] and [-2, 2] (gcc 12, -O2, with and
+without -fno-trapping-math -march=native): 4.7e-16 for 2, 7.0e-9 for 3.
+What they do to the spike times of a network has not been measured; run
+rd/exp_backend_accuracy.py with a library per backend before switching a
+study away from the default.
+exp_backend() (nrnexp.mod) returns the backend a set of compiled mechanisms
+uses.
+*/
+
+#ifndef NRNEXP_H
+#define NRNEXP_H
+
+#ifndef NRNEXP
+#define NRNEXP 0
+#endif
+
+#if NRNEXP == 1
+
+#include <math.h>
+#undef exp
+
+#elif NRNEXP == 2 || NRNEXP == 3
+
+#include <stdint.h>
+#include <string.h>
+#undef exp
+#define exp nrnexp_poly
+
+/* exp(x) = 2^k exp(r), k = round(x / ln2), |r| <= ln2 / 2. k is rounded by
+adding 1.5 * 2^52, which leaves k in the low mantissa bits; ln2 is split in
+two parts (fdlibm) so that k * _NRNEXP_LN2HI is exact for |k| <= 1024. */
+#define _NRNEXP_SHIFT 6755399441055744.0
+#define _NRNEXP_LOG2E 1.4426950408889634
+#define _NRNEXP_LN2HI 6.93147180369123816490e-01
+#define _NRNEXP_LN2LO 1.90821492927058770002e-10
+
+static inline double nrnexp_poly(double _x) {
+    double _xc, _kd, _k, _r, _p, _s;
+    uint64_t _kb;
+    _xc = _x > 700. ? 700. : _x;
+    _xc = _xc < -700. ? -700. : _xc;
+    _kd = _xc * _NRNEXP_LOG2E + _NRNEXP_SHIFT;
+    _k = _kd - _NRNEXP_SHIFT;
+    _r = (_xc - _k * _NRNEXP_LN2HI) - _k * _NRNEXP_LN2LO;
+#if NRNEXP == 2
+    /* Taylor series to r^12, remainder < 3e-16 on |r| <= ln2 / 2 */
+    _p = 1. / 479001600.;
+    _p = _p * _r + 1. / 39916800.;
+    _p = _p * _r + 1. / 3628800.;
+    _p = _p * _r + 1. / 362880.;
+    _p = _p * _r + 1. / 40320.;
+    _p = _p * _r + 1. / 5040.;
+#else
+    /* Taylor series to r^7, remainder < 8e-9 on |r| <= ln2 / 2 */
+    _p = 1. / 5040.;
+#endif
+    _p = _p * _r + 1. / 720.;
+    _p = _p * _r + 1. / 120.;
+    _p = _p * _r + 1. / 24.;
+    _p = _p * _r + 1. / 6.;
+    _p = _p * _r + 0.5;
+    _p = _p * _r + 1.;
+    _p = _p * _r + 1.;
+    memcpy(&_kb, &_kd, sizeof(_kb));
+    _kb = (_kb - (uint64_t) 0x4338000000000000 + 1023) << 52; /* 0x43380.. = _NRNEXP_SHIFT */
+    memcpy(&_s, &_kb, sizeof(_s));
+    _s = _x < -700. ? 0. : _s; /* a NaN _x has given a NaN _p */
+    return _p * _s;
+}
+
+#endif
+
+#endif
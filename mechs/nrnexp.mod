@@ -0,0 +1,26 @@
+TITLE nrnexp.mod  exp() backend the mechanisms were compiled with
+
+COMMENT
+No mechanism of its own. exp_backend() returns NRNEXP of nrnexp.h (0 hoc_Exp,
+1 libm, 2 and 3 inline polynomials) and exp_eval(x) the exp() of that
+backend, for rd/exp_backend_accuracy.py.
+ENDCOMMENT
+
+NEURON {
+	SUFFIX nothing
+	THREADSAFE
+}
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
+FUNCTION exp_backend() {
+VERBATIM
+	_lexp_backend = (double) NRNEXP;
+ENDVERBATIM
+}
+
+FUNCTION exp_eval(x) {
+	exp_eval = exp(x)
+}
@@ -0,0 +1,70 @@
+/*
+nrnptr.h
+
+Pointers into the data of other mechanisms that stay valid when NEURON moves
+that data. With CVode.cache_efficient(1), and whenever the thread layout
+changes under it, the range and point process data is reallocated in node
+order and every double* taken with hoc_pgetarg (&syn.g) before points at
+freed memory. Vector.record and POINTERs are fixed up by NEURON through
+nrn_recalc_ptr(); an owner of such pointers attaches its array here and gets
+the same treatment:
+
+    nrnptr_attach(&o->_owner, &o->_ptr, &o->_n)    in the CONSTRUCTOR
+    nrnptr_detach(&o->_owner)                      in the DESTRUCTOR
+
+The list of owners is per mechanism (every mod file that includes this has
+its own), the callback is registered with the first owner.
+
+Included from VERBATIM blocks.
+*/
+
+#ifndef NRNPTR_H
+#define NRNPTR_H
+
+extern double* nrn_recalc_ptr(double*);
+extern void nrn_register_recalc_ptr_callback(void (*)(void));
+
+typedef struct nrnptr_owner {
+    double*** _ptr; /* the owner's array of pointers */
+    int* _n;        /* and its length */
+    struct nrnptr_owner* _next;
+} nrnptr_owner_t;
+
+static inline nrnptr_owner_t** nrnptr_head(void) {
+    static nrnptr_owner_t* _head;
+    return &_head;
+}
+
+static inline void nrnptr_recalc(void) {
+    nrnptr_owner_t* _o;
+    int _k;
+    for (_o = *nrnptr_head(); _o; _o = _o->_next) {
+        for (_k = 0; _k < *_o->_n; ++_k) {
+            (*_o->_ptr)[_k] = nrn_recalc_ptr((*_o->_ptr)[_k]);
+        }
+    }
+}
+
+static inline void nrnptr_attach(nrnptr_owner_t* _o, double*** _ptr, int* _n) {
+    static int _registered;
+    if (!_registered) {
+        _registered = 1;
+        nrn_register_recalc_ptr_callback(nrnptr_recalc);
+    }
+    _o->_ptr = _ptr;
+    _o->_n = _n;
+    _o->_next = *nrnptr_head();
+    *nrnptr_head() = _o;
+}
+
+static inline void nrnptr_detach(nrnptr_owner_t* _o) {
+    nrnptr_owner_t** _p;
+    for (_p = nrnptr_head(); *_p; _p = &(*_p)->_next) {
+        if (*_p == _o) {
+            *_p = _o->_next;
+            break;
+        }
+    }
+}
+
+#endif
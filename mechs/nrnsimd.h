@@ -0,0 +1,154 @@
+/*
+nrnsimd.h
+
+Lane helpers for the batch kernels that replace the generated per-instance
+nrn_state/nrn_cur loops of a mechanism. Included from VERBATIM blocks, so it
+is compiled together with the C that nocmodl generates for the .mod file
+(nrnivmodl passes the mechs folder as include path).
+
+The lane width is fixed at compile time:
+    AVX-512  8 doubles per lane group
+    AVX/AVX2 4 doubles per lane group
+    other    1 (plain C, same arithmetic as the generated code)
+Build with e.g. nrnivmodl -incflags "-march=native" to get the wide paths.
+
+A batch kernel is installed by swapping the function pointers NEURON keeps in
+memb_func[type]; the generated functions stay registered as the scalar
+reference and are used for the tail of each Memb_list and for verification.
+*/
+
+#ifndef NRNSIMD_H
+#define NRNSIMD_H
+
+/* No intrinsic headers here: by the time a VERBATIM block is compiled the
+generated code has #defined v, m, h, t, dt, ... which those headers use as
+identifiers. GCC/clang vector extensions give the same instructions. */
+#if defined(__GNUC__) && defined(__AVX512F__)
+#define NRNSIMD_WIDTH 8
+#elif defined(__GNUC__) && defined(__AVX__)
+#define NRNSIMD_WIDTH 4
+#else
+#define NRNSIMD_WIDTH 1
+#endif
+
+#if NRNSIMD_WIDTH > 1
+typedef double nrnsimd_v __attribute__((vector_size(8 * NRNSIMD_WIDTH)));
+static inline nrnsimd_v nrnsimd_load(const double* _p) {
+    nrnsimd_v _a;
+    __builtin_memcpy(&_a, _p, sizeof(_a));
+    return _a;
+}
+static inline void nrnsimd_store(double* _p, nrnsimd_v _a) {
+    __builtin_memcpy(_p, &_a, sizeof(_a));
+}
+static inline nrnsimd_v nrnsimd_set1(double _x) {
+    return _x - (nrnsimd_v){0.};
+}
+#else
+typedef double nrnsimd_v;
+#define nrnsimd_load(_p) (*(_p))
+#define nrnsimd_store(_p, _a) (*(_p) = (_a))
+#define nrnsimd_set1(_x) (_x)
+#endif
+#define nrnsimd_add(_a, _b) ((_a) + (_b))
+#define nrnsimd_sub(_a, _b) ((_a) - (_b))
+#define nrnsimd_mul(_a, _b) ((_a) * (_b))
+#define nrnsimd_div(_a, _b) ((_a) / (_b))
+
+/* Bin index and interpolation weight of a TABLE lookup, computed the same
+way the generated _n_<proc>() does: xi = mfac*(v - tmin), clamped to the
+table ends. The upper end is expressed as bin n-1 with theta = 1 so that no
+lane reads past the table. Lanes with a NaN voltage return 1 so the caller
+can hand the group to the scalar path, which propagates the NaN. */
+static int nrnsimd_table_bins(const double* _vlane, double _mfac, double _tmin,
+                              int _n, int* _ilane, nrnsimd_v* _theta) {
+    int _k, _bad = 0;
+    double _xi, _th[NRNSIMD_WIDTH];
+    for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+        _xi = _mfac * (_vlane[_k] - _tmin);
+        if (isnan(_xi)) {
+            _bad = 1;
+            _xi = 0.;
+        }
+        if (_xi <= 0.) {
+            _ilane[_k] = 0;
+            _th[_k] = 0.;
+        } else if (_xi >= (double) _n) {
+            _ilane[_k] = _n - 1;
+            _th[_k] = 1.;
+        } else {
+            _ilane[_k] = (int) _xi;
+            _th[_k] = _xi - (double) _ilane[_k];
+        }
+    }
+    *_theta = nrnsimd_load(_th);
+    return _bad;
+}
+
+/* tbl[i] + theta*(tbl[i+1] - tbl[i]) for every lane */
+static nrnsimd_v nrnsimd_table_interp(const double* _tbl, const int* _ilane,
+                                      nrnsimd_v _theta) {
+    int _k;
+    double _lo[NRNSIMD_WIDTH], _hi[NRNSIMD_WIDTH];
+    nrnsimd_v _a, _b;
+    for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+        _lo[_k] = _tbl[_ilane[_k]];
+        _hi[_k] = _tbl[_ilane[_k] + 1];
+    }
+    _a = nrnsimd_load(_lo);
+    _b = nrnsimd_load(_hi);
+    return nrnsimd_add(_a, nrnsimd_mul(_theta, nrnsimd_sub(_b, _a)));
+}
+
+/* One column of NRNSIMD_WIDTH instance rows (_ml->_data[i..]) as a lane
+group, and back. */
+static nrnsimd_v nrnsimd_gather_col(double* const* _rows, int _col) {
+    int _k;
+    double _y[NRNSIMD_WIDTH];
+    for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+        _y[_k] = _rows[_k][_col];
+    }
+    return nrnsimd_load(_y);
+}
+
+static void nrnsimd_scatter_col(double* const* _rows, int _col, nrnsimd_v _a) {
+    int _k;
+    double _y[NRNSIMD_WIDTH];
+    nrnsimd_store(_y, _a);
+    for (_k = 0; _k < NRNSIMD_WIDTH; ++_k) {
+        _rows[_k][_col] = _y[_k];
+    }
+}
+
+/* Difference between a batch result and the scalar reference, relative
+to |reference| once that exceeds 1. A NaN on one side only is HUGE_VAL. */
+static double nrnsimd_err(double _batch, double _ref) {
+    double _d, _s;
+    if (isnan(_batch) || isnan(_ref)) {
+        return isnan(_batch) && isnan(_ref) ? 0. : HUGE_VAL;
+    }
+    _d = fabs(_batch - _ref);
+    _s = fabs(_ref);
+    return _s > 1. ? _d / _s : _d;
+}
+
+/* Runs the generated (scalar) kernel on instances first..nodecount-1 of a
+Memb_list, for the tail that does not fill a lane group. */
+static void nrnsimd_tail(void (*_f)(NrnThread*, _Memb_list*, int), NrnThread* _nt,
+                         _Memb_list* _ml, int _type, int _first) {
+    _Memb_list _sub;
+    if (_first >= _ml->_nodecount) {
+        return;
+    }
+    _sub = *_ml;
+    _sub._nodelist += _first;
+#if CACHEVEC
+    _sub._nodeindices += _first;
+#endif
+    _sub._data += _first;
+    _sub._pdata += _first;
+    _sub._nodecount -= _first;
+    _f(_nt, &_sub, _type);
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+nrnsoa.h
+
+Column mirror of a mechanism's Memb_list. NEURON 7/8 stores every instance
+as one row of _p[] (_ml->_data[i]), so a loop over instances reads one
+column with a stride of the row length and drags the rest of the row
+through the cache. The mirror keeps one contiguous array per column for
+the columns a kernel only reads during a run (parameters, node area) and
+for per-instance constants derived from them, e.g. the cnexp decay factor
+1 - exp(-dt/tau). Which columns are mirrored is given by the *_columnindex
+defines of the generated code.
+
+States stay in the rows: NET_RECEIVE, Vector.record and hoc address them
+there between time steps, so the kernels update them in place. This is a
+mirror of the parameters, not a column layout of the mechanism: every
+state a kernel updates is still read and written with the row stride.
+What the kernels gain comes mostly from the derived constants (no exp()
+or division per instance and step), not from the layout. In a standalone
+copy of the tmgsyn state update (gcc 12 -O2, libm exp) the mirror took
+2.4 ns per instance and step against 14.5 ns for the generated loop with
+1e4 instances in cache, and 17-20 against 29-34 ns with 2e5-2e6 instances,
+where the row stride of g dominates. The network has not been timed; see
+rd/column_layout_benchmark.py.
+
+The mirror is rebuilt when the Memb_list is reallocated, when its instance
+count or dt changes and after finitialize (nrnsoa_invalidate() from the
+INITIAL block). Parameters changed in the middle of a run are only picked
+up after the next finitialize.
+
+Included from VERBATIM blocks after the generated declarations; one mirror
+per thread, indexed by NrnThread id, for up to NRNSOA_MAXTHREAD threads.
+Mechanisms call nrnsoa_thread_check() from their INITIAL block, which
+finitialize runs on the main thread, so that more threads stop the run
+with an error instead of writing past the arrays.
+*/
+
+#ifndef NRNSOA_H
+#define NRNSOA_H
+
+#define NRNSOA_MAXTHREAD 64
+
+typedef struct {
+    double** _data; /* _ml->_data the mirror was built for */
+    int _n;         /* instances */
+    int _ncol;      /* mirrored columns */
+    int _stale;
+    double _dt;
+    double* _col;   /* column c of instance i at col[c*n + i] */
+} nrnsoa_t;
+
+static inline void nrnsoa_thread_check(NrnThread* _nt, const char* _mech) {
+    if (_nt->id >= NRNSOA_MAXTHREAD) {
+        hoc_execerror(_mech, "supports at most 64 threads (NRNSOA_MAXTHREAD)");
+    }
+}
+
+static double* nrnsoa_col(nrnsoa_t* _s, int _c) {
+    return _s->_col + (size_t) _c * _s->_n;
+}
+
+static void nrnsoa_invalidate(nrnsoa_t* _s, int _nthread) {
+    int _k;
+    for (_k = 0; _k < _nthread; ++_k) {
+        _s[_k]._stale = 1;
+    }
+}
+
+/* Returns 1 if the mirror was (re)allocated and must be refilled. */
+static int nrnsoa_check(nrnsoa_t* _s, _Memb_list* _ml, int _ncol, double _dt) {
+    if (!_s->_stale && _s->_data == _ml->_data && _s->_n == _ml->_nodecount && _s->_dt == _dt) {
+        return 0;
+    }
+    if (_s->_n != _ml->_nodecount || _s->_ncol != _ncol || !_s->_col) {
+        free(_s->_col);
+        _s->_col = (double*) malloc(((size_t) _ncol * _ml->_nodecount + 1) * sizeof(double));
+    }
+    _s->_data = _ml->_data;
+    _s->_n = _ml->_nodecount;
+    _s->_ncol = _ncol;
+    _s->_dt = _dt;
+    _s->_stale = 0;
+    return 1;
+}
+
+/* Installs kernels in memb_func[type], a 0 leaves the entry as it is; the
+jacob entry is only replaced by mechanisms that keep their own _g. The
+field names can be shadowed by the mechanism's own block names (e.g.
+DERIVATIVE state), hence the push/pop. */
+#pragma push_macro("state")
+#pragma push_macro("current")
+#undef state
+#undef current
+static void nrnsoa_install(int _type, void (*_cur)(NrnThread*, _Memb_list*, int),
+                           void (*_state)(NrnThread*, _Memb_list*, int)) {
+    if (_cur) {
+        memb_func[_type].current = _cur;
+    }
+    if (_state) {
+        memb_func[_type].state = _state;
+    }
+}
+
+static void nrnsoa_install_jacob(int _type, void (*_jacob)(NrnThread*, _Memb_list*, int)) {
+    memb_func[_type].jacob = _jacob;
+}
+#pragma pop_macro("current")
+#pragma pop_macro("state")
+
+/* column c of the mirror <- column colindex of the rows */
+static void nrnsoa_gather(nrnsoa_t* _s, int _c, int _colindex) {
+    int _i;
+    double* _dst = nrnsoa_col(_s, _c);
+    for (_i = 0; _i < _s->_n; ++_i) {
+        _dst[_i] = _s->_data[_i][_colindex];
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+TITLE runctl.mod  fixed step run loop in C
+
+COMMENT
+No mechanism of its own.
+
+	advance_until(tstop)
+
+does what the hoc or Python loop
+
+	while (t < tstop) { fadvance() }
+
+does, with the same fadvance() (fixed step or CVode, threads, events), but
+without returning to the interpreter between the steps. It returns the
+number of steps taken and stops early when stoprun is set.
+pydentate.neuron_tools.run_neuron_simulator runs the warmup and the
+simulation with it and calls back into Python only every `interval` ms.
+ENDCOMMENT
+
+NEURON {
+	SUFFIX nothing
+	THREADSAFE
+}
+
+VERBATIM
+extern void fadvance(void);
+extern double hoc_xpop(void);
+extern double* hoc_val_pointer(const char*);
+extern int stoprun;
+ENDVERBATIM
+
+FUNCTION advance_until(tstop (ms)) {
+VERBATIM
+	double* _pt = hoc_val_pointer("t");
+	double _n = 0.;
+	stoprun = 0;
+	while (*_pt < _ltstop && !stoprun) {
+		fadvance();
+		hoc_xpop();
+		_n += 1.;
+	}
+	_ladvance_until = _n;
+ENDVERBATIM
+}
@@ -0,0 +1,210 @@
+: Plays the spike trains of many event sources from one sorted buffer
+
+COMMENT
+VecStim schedules a self event for every spike of every instance and looks
+its Vector up again on each event. SpikePlayer takes the spikes of all
+sources at once, as (time, source index) pairs, and keeps them sorted by time
+in contiguous arrays. It wakes up at the time of the next spike and sends
+every spike of the following dt, [t, t + dt), with net_event() from its
+source at the spike's own time, then schedules the next wake-up at the first
+spike after that. So there is at most one self event per time step (nwake
+counts them) however many sources fire in it, and none in steps without
+spikes.
+
+The spike times are not quantized: a NetCon of a source delivers at spike
+time + delay as from one VecStim per source, and records the spike time.
+Only the moment the spike is handed to the NetCons is up to dt early, so a
+NetCon sees a spike of the next step before the player's own step is over;
+with the fixed step the events still reach their targets in the step of
+spike time + delay. In spikes of one step the order is time, then source
+index.
+
+A source is any point process with NetCons, typically an idle VecStim (no
+Vector played). play(tvec, srcvec, sources) copies the buffer: srcvec[i] is
+the index in the List sources of the source that fires at tvec[i]. The List
+and its objects must be kept alive by the caller. Spikes before the time of
+finitialize are skipped. The sources must be in the same thread as the
+player.
+
+	player = new SpikePlayer()
+	player.play(tvec, srcvec, sources)
+ENDCOMMENT
+
+NEURON {
+	ARTIFICIAL_CELL SpikePlayer
+	RANGE nspike, nsource, nwake
+	THREADSAFE
+}
+
+PARAMETER {
+	dt (ms)
+}
+
+ASSIGNED {
+	index
+	nspike
+	nsource
+	nwake
+	space
+}
+
+VERBATIM
+#include <stdlib.h>
+extern double* vector_vec();
+extern int vector_capacity();
+extern void* vector_arg();
+extern Object** hoc_objgetarg(int);
+extern int ivoc_list_count(Object*);
+extern Object* ivoc_list_item(Object*, int);
+extern Point_process* ob2pntproc(Object*);
+extern void net_event(Point_process*, double);
+
+typedef struct {
+	int _n;
+	double* _t;
+	int* _src;
+	int _nsrc;
+	Point_process** _pnt;
+} SpikeBuffer;
+
+#define SPIKEBUF (*((SpikeBuffer**)(&space)))
+
+static const double* _sort_t;
+
+static int _spike_cmp(const void* _a, const void* _b) {
+	int _i = *(const int*)_a, _j = *(const int*)_b;
+	if (_sort_t[_i] != _sort_t[_j]) {
+		return _sort_t[_i] < _sort_t[_j] ? -1 : 1;
+	}
+	return _i - _j;
+}
+
+static void _spikebuf_free(SpikeBuffer* _b) {
+	if (_b) {
+		free(_b->_t);
+		free(_b->_src);
+		free(_b->_pnt);
+		free(_b);
+	}
+}
+ENDVERBATIM
+
+CONSTRUCTOR {
+VERBATIM
+	SPIKEBUF = (SpikeBuffer*)0;
+ENDVERBATIM
+}
+
+DESTRUCTOR {
+VERBATIM
+	_spikebuf_free(SPIKEBUF);
+	SPIKEBUF = (SpikeBuffer*)0;
+ENDVERBATIM
+}
+
+INITIAL {
+	index = 0
+	nwake = 0
+	skip()
+	if (index < nspike) {
+		net_send(next_time() - t, 1)
+	}
+}
+
+NET_RECEIVE (w) {
+	if (flag == 1) {
+		nwake = nwake + 1
+		deliver()
+		if (index < nspike) {
+			net_send(next_time() - t, 1)
+		}
+	}
+}
+
+PROCEDURE skip() {
+VERBATIM
+	SpikeBuffer* _b = SPIKEBUF;
+	int _i = (int)index;
+	if (_b) {
+		while (_i < _b->_n && _b->_t[_i] < t) {
+			++_i;
+		}
+	}
+	index = (double)_i;
+ENDVERBATIM
+}
+
+FUNCTION next_time() (ms) {
+VERBATIM
+	_lnext_time = SPIKEBUF->_t[(int)index];
+ENDVERBATIM
+}
+
+: sends every spike of [t, t + dt) at its own time
+PROCEDURE deliver() {
+VERBATIM
+	SpikeBuffer* _b = SPIKEBUF;
+	int _i = (int)index;
+	double _tend = t + dt;
+	if (_b) {
+		while (_i < _b->_n && _b->_t[_i] < _tend) {
+			net_event(_b->_pnt[_b->_src[_i]], _b->_t[_i] > t ? _b->_t[_i] : t);
+			++_i;
+		}
+	}
+	index = (double)_i;
+ENDVERBATIM
+}
+
+PROCEDURE play() {
+VERBATIM
+	void *_vt, *_vs;
+	Object* _list;
+	SpikeBuffer* _b;
+	double *_pt, *_ps;
+	int *_order, _i, _n;
+	_spikebuf_free(SPIKEBUF);
+	SPIKEBUF = (SpikeBuffer*)0;
+	nspike = 0;
+	nsource = 0;
+	if (ifarg(3)) {
+		_vt = vector_arg(1);
+		_vs = vector_arg(2);
+		_list = *hoc_objgetarg(3);
+		_n = vector_capacity(_vt);
+		if (vector_capacity(_vs) != _n) {
+			hoc_execerror("SpikePlayer.play:", "tvec and srcvec differ in size");
+		}
+		_pt = vector_vec(_vt);
+		_ps = vector_vec(_vs);
+		_b = (SpikeBuffer*)calloc(1, sizeof(SpikeBuffer));
+		_b->_nsrc = ivoc_list_count(_list);
+		_b->_pnt = (Point_process**)calloc(_b->_nsrc + 1, sizeof(Point_process*));
+		for (_i = 0; _i < _b->_nsrc; ++_i) {
+			_b->_pnt[_i] = ob2pntproc(ivoc_list_item(_list, _i));
+		}
+		_order = (int*)malloc((_n + 1) * sizeof(int));
+		for (_i = 0; _i < _n; ++_i) {
+			if (_ps[_i] < 0 || _ps[_i] >= _b->_nsrc) {
+				free(_order);
+				_spikebuf_free(_b);
+				hoc_execerror("SpikePlayer.play:", "source index out of range");
+			}
+			_order[_i] = _i;
+		}
+		_sort_t = _pt;
+		qsort(_order, _n, sizeof(int), _spike_cmp);
+		_b->_n = _n;
+		_b->_t = (double*)malloc((_n + 1) * sizeof(double));
+		_b->_src = (int*)malloc((_n + 1) * sizeof(int));
+		for (_i = 0; _i < _n; ++_i) {
+			_b->_t[_i] = _pt[_order[_i]];
+			_b->_src[_i] = (int)_ps[_order[_i]];
+		}
+		free(_order);
+		SPIKEBUF = _b;
+		nspike = _n;
+		nsource = _b->_nsrc;
+	}
+ENDVERBATIM
+}
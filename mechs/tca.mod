@@ -22,11 +22,16 @@ PARAMETER {
 
 NEURON {
 	SUFFIX cat
+	THREADSAFE
 	USEION tca READ etca WRITE itca VALENCE 2
 	USEION ca READ cai, cao VALENCE 2
         RANGE gcatbar,cai, itca, etca
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 STATE {
 	m h 
 }
@@ -37,11 +42,17 @@ ASSIGNED {
 	etca (mV)
 }
 
+VERBATIM
+#include "vtable.h"
+static void _cat_vtable_install(int);
+ENDVERBATIM
+
 INITIAL {
       m = minf(v)
       h = hinf(v)
 	VERBATIM
 	cai=_ion_cai;
+	vtable_invalidate(_nt);
 	ENDVERBATIM
 }
 
@@ -111,3 +122,86 @@ FUNCTION h_tau(v(mV)) (ms) {
 	b = 1/(exp((-v+29.79)/10.)+1.)
 	h_tau = 1/(a+b)
 }
+
+PROCEDURE shared_tables(on) {	:1 nrn_state takes minf, hinf, m_tau, h_tau from the tables of vtable.h
+VERBATIM
+	_cat_vtable_install((int)_lon);
+ENDVERBATIM
+}
+
+COMMENT
+nrn_state on the shared tables of vtable.h (see ichan2.mod). The four
+tabulated functions are one slice of the -150..150 mV, 1.5 mV grid of their
+TABLEs, which lca shares. The slice is filled by the thread
+table check, serially before the step. The update is the generated cnexp
+one with minf(v), m_tau(v), hinf(v) and h_tau(v) looked up once each.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+#define _VT_NCOL 4
+static int _vt_id = -1;
+static vtable_grid_t* _vt_grid;
+static int _vt_on;
+
+static void _vt_check(double* _p, Datum* _ppvar, Datum* _thread, NrnThread* _nt, int _type) {
+	int _k, _c;
+	double* _r;
+	_check_table_thread(_p, _ppvar, _thread, _nt, _type);
+	if (!_vt_on || !vtable_stale(_vt_id, 0., 0.)) {
+		return;
+	}
+	_c = vtable_col(_vt_id);
+	for (_k = 0; _k <= _vt_grid->_n; ++_k) {
+		_r = vtable_row(_vt_grid, _k) + _c;
+		_r[0] = _f_minf(_threadargscomma_ vtable_x(_vt_grid, _k));
+		_r[1] = _f_m_tau(_threadargscomma_ vtable_x(_vt_grid, _k));
+		_r[2] = _f_hinf(_threadargscomma_ vtable_x(_vt_grid, _k));
+		_r[3] = _f_h_tau(_threadargscomma_ vtable_x(_vt_grid, _k));
+	}
+	vtable_filled(_vt_id, 0., 0.);
+}
+
+static void _vt_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+#if CACHEVEC
+	double* _p; Datum* _ppvar;
+	int* _ni = _ml->_nodeindices;
+	int _i, _k, _c, _cntml = _ml->_nodecount;
+	double _theta, _mi, _mt, _hi, _ht;
+	if (use_cachevec && usetable && !vtable_stale(_vt_id, 0., 0.)) {
+		vtable_prepare(_vt_grid, _nt);
+		_c = vtable_col(_vt_id);
+		for (_i = 0; _i < _cntml; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			v = VEC_V(_ni[_i]);
+			etca = _ion_etca;
+			cai = _ion_cai;
+			cao = _ion_cao;
+			_k = vtable_bin(_vt_grid, _nt, _ni[_i], v, &_theta);
+			_mi = vtable_at(_vt_grid, _k, _theta, _c);
+			_mt = vtable_at(_vt_grid, _k, _theta, _c + 1);
+			_hi = vtable_at(_vt_grid, _k, _theta, _c + 2);
+			_ht = vtable_at(_vt_grid, _k, _theta, _c + 3);
+			m = m + (1. - exp(dt*(( ( ( - 1.0 ) ) ) / _mt)))*(- ( ( ( _mi ) ) / _mt ) / ( ( ( ( - 1.0 ) ) ) / _mt ) - m);
+			h = h + (1. - exp(dt*(( ( ( - 1.0 ) ) ) / _ht)))*(- ( ( ( _hi ) ) / _ht ) / ( ( ( ( - 1.0 ) ) ) / _ht ) - h);
+		}
+		return;
+	}
+#endif
+	nrn_state(_nt, _ml, _type);
+}
+
+static void _cat_vtable_install(int _on) {
+	_vt_on = _on;
+	if (_on) {
+		_vt_id = vtable_register("cat", _VT_NCOL, -150., 150., 200);
+		_vt_grid = vtable_grid(_vt_id);
+		_nrn_thread_table_reg(_mechtype, _vt_check);
+		nrnsoa_install(_mechtype, 0, _vt_state);
+	} else {
+		_nrn_thread_table_reg(_mechtype, _check_table_thread);
+		nrnsoa_install(_mechtype, 0, nrn_state);
+	}
+}
+ENDVERBATIM
@@ -70,6 +70,16 @@ synaptic input via NetCon objects.
 Each stream keeps track of its own 
 weight and activation history.
 
+An event adds the present conductance g = B - A of the
+instance plus the increment of the stream to A and B. With
+several streams on one instance g includes the other streams.
+lumped = 1 keeps the A and B parts of each stream in the
+NetCon (ga, gb) and adds those of the stream instead, so that
+streams sharing an instance behave as with one instance each.
+The stream's own g is taken at the event time, where the
+default uses the g of the last time step. The g of the
+instance is then left to BREAKPOINT.
+
 The printf() statements are for testing purposes only.
 ENDCOMMENT
 
@@ -79,13 +89,19 @@ NEURON {
 	POINT_PROCESS tmgexp2syn
 	: THE RANGE STATEMENT ASSERTS THAT THESE VARIABLES CAN BE ACCESSED IN HOC THROUGH RANGE VARIABLE SYNTAX
 	RANGE e, i, g
-	RANGE tau_1, tau_2, tau_rec, tau_facil, U, u0
+	RANGE tau_1, tau_2, tau_rec, tau_facil, U, u0, lumped
 	: THE NONSPECIFIC CURRENT DEFINITION HAS TWO CONSEQUENCES
 	: FIRST, i HAS TO BE ACCOUNTED FOR IN CHARGE BALANCE EQUATIONS
 	: SECOND, i DOES NOT CONTRIBUTE DIRECTLY TO MASS BALANCS OF ANY IONS
 	NONSPECIFIC_CURRENT i
 	: RANGE g
+	THREADSAFE
+	GLOBAL column_layout
 }
+
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
 : UNITS BLOCK JUST DEFINES NEW NAMES FOR UNITS IN TERMS OF EXISTING UNITS IN THE UNIX UNITS DATABASE
 UNITS {
 	(nA) = (nanoamp)
@@ -119,6 +135,12 @@ PARAMETER {
 	U = 0.04 (1) < 0, 1 >
 	: initial value for the "facilitation variable"
 	u0 = 0 (1) < 0, 1 >
+	: 1 if the instance is shared by several streams, see the
+	: comment at the top
+	lumped = 0
+	: 1 runs nrn_state/nrn_cur on the column mirror of nrnsoa.h,
+	: takes effect at the next finitialize
+	column_layout = 0
 }
 
 : THE ASSIGNED BLOCK IS USEDTO DECLARE TWO KINDS OF VARIABLES
@@ -144,6 +166,10 @@ STATE {
 
 }
 
+VERBATIM
+static void _tmgexp2syn_layout_init(NrnThread*, int);
+ENDVERBATIM
+
 : THE INITIAL BLOCK IS CALLED BE finitialize() TO SET GOOD INITIAL CONDITIONS OF THE MECHANISM
 INITIAL {
 	LOCAL tp
@@ -159,6 +185,9 @@ INITIAL {
 	tp = (tau_1*tau_2)/(tau_2 - tau_1) * log(tau_2/tau_1)
 	factor = -exp(-tp/tau_1) + exp(-tp/tau_2)
 	factor = 1/factor
+VERBATIM
+	_tmgexp2syn_layout_init(_nt, (int)column_layout);
+ENDVERBATIM
 }
 
 : BREAKPOINT IS THE MAIN COMPUTATION BLOCK OF THE MECHANISM
@@ -178,7 +207,8 @@ DERIVATIVE state {
 }
 
 : THE NET_RECEIVE BLOCK SPECIFIES WHAT HAPPENS TO A NET_RECIEVE EVENT FROM A NETCON OBJECT
-NET_RECEIVE(weight (umho), y, z, u, tsyn (ms)) {
+NET_RECEIVE(weight (umho), y, z, u, tsyn (ms), ga (umho), gb (umho)) {
+	LOCAL gs
 INITIAL {
 : these are in NET_RECEIVE to be per-stream
 
@@ -187,10 +217,20 @@ INITIAL {
 :	u = 0
 	u = u0
 	tsyn = t
+	ga = 0
+	gb = 0
 : this header will appear once per stream
 : printf("t\t t-tsyn\t y\t z\t u\t newu\t g\t dg\t newg\t newy\n")
 }
 
+	if (lumped) {
+		: g of this stream alone, kept in gs so that the g of the
+		: instance stays the one BREAKPOINT computed
+		ga = ga*exp(-(t - tsyn)/tau_1)
+		gb = gb*exp(-(t - tsyn)/tau_2)
+		gs = gb - ga
+	}
+
 	: first calculate z at event-
 	:   based on prior y and z
 	z = z*exp(-(t - tsyn)/tau_rec)
@@ -215,12 +255,111 @@ INITIAL {
 
 : printf("\t%g\t%g\t%g", u, g, weight*factor*x*u)
 
-	state_discontinuity(g, g + weight*factor*x*u)
+	if (lumped) {
+		gs = gs + weight*factor*x*u
+	} else {
+		state_discontinuity(g, g + weight*factor*x*u)
+		gs = g
+	}
 	state_discontinuity(y, y + x*u)
 
 	tsyn = t
-	A = A + g
-	B = B + g
+	A = A + gs
+	B = B + gs
+	if (lumped) {
+		ga = ga + gs
+		gb = gb + gs
+	}
 
 : printf("\t%g\t%g\n", g, y)
 }
+
+COMMENT
+Parameter column kernels. e, the node area factor and the cnexp decay factors
+1 - exp(-dt/tau_1), 1 - exp(-dt/tau_2) are kept in contiguous per-instance
+arrays (nrnsoa.h), so the state update needs no exp() and the current no
+division per step. The arithmetic is the same as in the generated
+nrn_state/nrn_cur, the results are bit-identical.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+enum { _SOA_E, _SOA_DECAY1, _SOA_DECAY2, _SOA_AREA, _SOA_NCOL };
+static nrnsoa_t _soa[NRNSOA_MAXTHREAD];
+
+static nrnsoa_t* _soa_fill(NrnThread* _nt, _Memb_list* _ml) {
+	double* _p; Datum* _ppvar;
+	double *_decay1, *_decay2, *_area;
+	int _i;
+	nrnsoa_t* _s = _soa + _nt->id;
+	if (nrnsoa_check(_s, _ml, _SOA_NCOL, dt)) {
+		nrnsoa_gather(_s, _SOA_E, e_columnindex);
+		_decay1 = nrnsoa_col(_s, _SOA_DECAY1);
+		_decay2 = nrnsoa_col(_s, _SOA_DECAY2);
+		_area = nrnsoa_col(_s, _SOA_AREA);
+		for (_i = 0; _i < _s->_n; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			_decay1[_i] = 1. - exp(dt*(( - 1.0 ) / tau_1));
+			_decay2[_i] = 1. - exp(dt*(( - 1.0 ) / tau_2));
+			_area[_i] = 1.e2/(_nd_area);
+		}
+	}
+	return _s;
+}
+
+static void _soa_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p;
+	int _i, _cntml = _ml->_nodecount;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	const double* _decay1 = nrnsoa_col(_s, _SOA_DECAY1);
+	const double* _decay2 = nrnsoa_col(_s, _SOA_DECAY2);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+		A = A + _decay1[_i]*(0.0 - A);
+		B = B + _decay2[_i]*(0.0 - B);
+	}
+}
+
+static void _soa_cur(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p;
+	double _v, _rhs;
+	int _i, _cntml = _ml->_nodecount;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	const double* _e = nrnsoa_col(_s, _SOA_E);
+	const double* _area = nrnsoa_col(_s, _SOA_AREA);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+#if CACHEVEC
+		if (use_cachevec) {
+			_v = VEC_V(_ml->_nodeindices[_i]);
+		}else
+#endif
+		{
+			_v = NODEV(_ml->_nodelist[_i]);
+		}
+		g = B - A;
+		_g = g*((_v + .001) - _e[_i]);
+		_rhs = g*(_v - _e[_i]);
+		v = _v;
+		i = _rhs;
+		_g = (_g - _rhs)/.001;
+		_g *= _area[_i];
+		_rhs *= _area[_i];
+#if CACHEVEC
+		if (use_cachevec) {
+			VEC_RHS(_ml->_nodeindices[_i]) -= _rhs;
+		}else
+#endif
+		{
+			NODERHS(_ml->_nodelist[_i]) -= _rhs;
+		}
+	}
+}
+
+static void _tmgexp2syn_layout_init(NrnThread* _nt, int _mode) {
+	nrnsoa_thread_check(_nt, "tmgexp2syn");
+	nrnsoa_install(_mechtype, _mode ? _soa_cur : nrn_cur, _mode ? _soa_state : nrn_state);
+	_soa[_nt->id]._stale = 1;
+}
+ENDVERBATIM
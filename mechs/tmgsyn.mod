@@ -70,17 +70,28 @@ synaptic input via NetCon objects.
 Each stream keeps track of its own 
 weight and activation history.
 
+g is the sum of the increments of all streams, so streams
+with the same parameters that target the same segment can
+share one instance without changing the result (beyond
+rounding); ouropy's tmgsynConnection(lumped=True) does so.
+
 The printf() statements are for testing purposes only.
 ENDCOMMENT
 
 
 NEURON {
 	POINT_PROCESS tmgsyn
+	THREADSAFE
 	RANGE e, i
 	RANGE tau_1, tau_rec, tau_facil, U, u0
 	NONSPECIFIC_CURRENT i
+	GLOBAL column_layout
 }
 
+VERBATIM
+#include "nrnexp.h"
+ENDVERBATIM
+
 UNITS {
 	(nA) = (nanoamp)
 	(mV) = (millivolt)
@@ -107,6 +118,9 @@ PARAMETER {
 	U = 0.04 (1) < 0, 1 >
 	: initial value for the "facilitation variable"
 	u0 = 0 (1) < 0, 1 >
+	: 1 runs nrn_state/nrn_cur on the column mirror of nrnsoa.h,
+	: takes effect at the next finitialize
+	column_layout = 0
 }
 
 ASSIGNED {
@@ -119,8 +133,15 @@ STATE {
 	g (umho)
 }
 
+VERBATIM
+static void _tmgsyn_layout_init(NrnThread*, int);
+ENDVERBATIM
+
 INITIAL {
 	g=0
+VERBATIM
+	_tmgsyn_layout_init(_nt, (int)column_layout);
+ENDVERBATIM
 }
 
 BREAKPOINT {
@@ -175,3 +196,87 @@ INITIAL {
 
 : printf("\t%g\t%g\n", g, y)
 }
+
+COMMENT
+Parameter column kernels. e, the node area factor and the cnexp decay factor
+1 - exp(-dt/tau_1) are kept in contiguous per-instance arrays (nrnsoa.h),
+so the state update needs no exp() and the current no division per step.
+g stays in the rows. The arithmetic is the same as in the generated
+nrn_state/nrn_cur, the results are bit-identical.
+ENDCOMMENT
+
+VERBATIM
+#include "nrnsoa.h"
+
+enum { _SOA_E, _SOA_DECAY, _SOA_AREA, _SOA_NCOL };
+static nrnsoa_t _soa[NRNSOA_MAXTHREAD];
+
+static nrnsoa_t* _soa_fill(NrnThread* _nt, _Memb_list* _ml) {
+	double* _p; Datum* _ppvar;
+	double *_decay, *_area;
+	int _i;
+	nrnsoa_t* _s = _soa + _nt->id;
+	if (nrnsoa_check(_s, _ml, _SOA_NCOL, dt)) {
+		nrnsoa_gather(_s, _SOA_E, e_columnindex);
+		_decay = nrnsoa_col(_s, _SOA_DECAY);
+		_area = nrnsoa_col(_s, _SOA_AREA);
+		for (_i = 0; _i < _s->_n; ++_i) {
+			_p = _ml->_data[_i]; _ppvar = _ml->_pdata[_i];
+			_decay[_i] = 1. - exp(dt*(( - 1.0 ) / tau_1));
+			_area[_i] = 1.e2/(_nd_area);
+		}
+	}
+	return _s;
+}
+
+static void _soa_state(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p;
+	int _i, _cntml = _ml->_nodecount;
+	const double* _decay = nrnsoa_col(_soa_fill(_nt, _ml), _SOA_DECAY);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+		g = g + _decay[_i]*(0.0 - g);
+	}
+}
+
+static void _soa_cur(NrnThread* _nt, _Memb_list* _ml, int _type) {
+	double* _p;
+	double _v, _rhs;
+	int _i, _cntml = _ml->_nodecount;
+	nrnsoa_t* _s = _soa_fill(_nt, _ml);
+	const double* _e = nrnsoa_col(_s, _SOA_E);
+	const double* _area = nrnsoa_col(_s, _SOA_AREA);
+	for (_i = 0; _i < _cntml; ++_i) {
+		_p = _ml->_data[_i];
+#if CACHEVEC
+		if (use_cachevec) {
+			_v = VEC_V(_ml->_nodeindices[_i]);
+		}else
+#endif
+		{
+			_v = NODEV(_ml->_nodelist[_i]);
+		}
+		_g = g*((_v + .001) - _e[_i]);
+		_rhs = g*(_v - _e[_i]);
+		v = _v;
+		i = _rhs;
+		_g = (_g - _rhs)/.001;
+		_g *= _area[_i];
+		_rhs *= _area[_i];
+#if CACHEVEC
+		if (use_cachevec) {
+			VEC_RHS(_ml->_nodeindices[_i]) -= _rhs;
+		}else
+#endif
+		{
+			NODERHS(_ml->_nodelist[_i]) -= _rhs;
+		}
+	}
+}
+
+static void _tmgsyn_layout_init(NrnThread* _nt, int _mode) {
+	nrnsoa_thread_check(_nt, "tmgsyn");
+	nrnsoa_install(_mechtype, _mode ? _soa_cur : nrn_cur, _mode ? _soa_state : nrn_state);
+	_soa[_nt->id]._stale = 1;
+}
+ENDVERBATIM
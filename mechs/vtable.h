@@ -0,0 +1,110 @@
+/*
+vtable.h
+
+Voltage tables shared between mechanisms. ichan2, nca, hyperde3, cat and lca
+each keep their own TABLE of rate functions of v, and each of them turns the
+same v into a bin index and an interpolation weight in every compartment on
+every step. With shared tables switched on (PROCEDURE shared_tables in those
+mechanisms) their nrn_state takes the rates from a grid shared with the
+mechanisms that tabulate on the same voltage points:
+
+    grid     the FROM vmin TO vmax WITH n of the mechanism's own TABLE;
+             mechanisms registering the same range share one grid
+             (ichan2 and nca: -100..100 mV, 1 mV; cat and lca: -150..150 mV,
+             1.5 mV; hyperde3: -120..100 mV, 1 mV)
+    rows     vmin + k*dx, k = 0..n, the points the TABLE tabulates
+    columns  the tabulated functions of every mechanism on the grid, one
+             contiguous slice per mechanism, so the two rows an interpolation
+             reads are adjacent in memory
+
+The bin and weight of a node are computed as in the generated lookup, by the
+first mechanism on the grid that asks for them in a time step, and reused by
+the others (vtable_bin(), keyed on the node index and t). Outside vmin..vmax
+the lookup clamps at the end rows like the TABLE does, so a mechanism gets
+the values of its own TABLE. INITIAL blocks call vtable_invalidate() so that
+bins from a previous run are not taken for the same t.
+
+Storage lives in vtable.mod. Included from VERBATIM blocks after the
+generated declarations.
+*/
+
+#ifndef VTABLE_H
+#define VTABLE_H
+
+#define VTABLE_MAXTHREAD 64
+#define VTABLE_MAXGRID 8
+
+typedef struct {
+    int* _k;
+    double* _theta;
+    double* _t; /* _nt->_t the bin was computed at */
+    int* _gen;  /* bins of another generation are stale */
+    int _n;
+    int _cur;
+} vtable_bins_t;
+
+typedef struct {
+    double _vmin, _vmax, _dx, _mfac;
+    int _n;        /* intervals; rows 0.._n plus a copy of the last one */
+    int _ncol;
+    double* _rows;
+    vtable_bins_t _bins[VTABLE_MAXTHREAD];
+} vtable_grid_t;
+
+/* Returns the slice id of _name, adding a slice of _ncol columns the first
+time on the grid FROM _vmin TO _vmax WITH _n. Adding a slice changes the
+column count of its grid and makes every slice on it stale. */
+extern int vtable_register(const char* _name, int _ncol, double _vmin, double _vmax, int _n);
+/* grid and first column of a slice */
+extern vtable_grid_t* vtable_grid(int _id);
+extern int vtable_col(int _id);
+/* 1 if the slice has to be filled again (new layout, dt or celsius) */
+extern int vtable_stale(int _id, double _dt, double _celsius);
+extern void vtable_filled(int _id, double _dt, double _celsius);
+/* sizes the bin cache of a thread, call before vtable_bin() */
+extern void vtable_prepare(vtable_grid_t* _g, NrnThread* _nt);
+extern void vtable_invalidate(NrnThread* _nt);
+
+/* the voltages are multiples of dx that the generated table loop reaches
+exactly by adding dx, so the points are the same */
+static double vtable_x(const vtable_grid_t* _g, int _k) {
+    return _g->_vmin + _k * _g->_dx;
+}
+
+static double* vtable_row(const vtable_grid_t* _g, int _k) {
+    return _g->_rows + (size_t) _k * _g->_ncol;
+}
+
+/* Bin of node _ni at voltage _v, clamped like the generated _n_<table>()
+lookups. A NaN voltage gives a NaN weight, so everything interpolated from
+it is NaN as well. */
+static inline int vtable_bin(vtable_grid_t* _g, NrnThread* _nt, int _ni, double _v, double* _theta) {
+    vtable_bins_t* _b = _g->_bins + _nt->id;
+    double _xi;
+    int _k;
+    if (_b->_t[_ni] != _nt->_t || _b->_gen[_ni] != _b->_cur) {
+        _xi = _g->_mfac * (_v - _g->_vmin);
+        if (_xi > 0. && _xi < (double) _g->_n) {
+            _k = (int) _xi;
+            _b->_theta[_ni] = _xi - (double) _k;
+        } else if (_xi >= (double) _g->_n) {
+            _k = _g->_n;
+            _b->_theta[_ni] = 0.;
+        } else {
+            _k = 0;
+            _b->_theta[_ni] = isnan(_xi) ? _xi : 0.;
+        }
+        _b->_k[_ni] = _k;
+        _b->_t[_ni] = _nt->_t;
+        _b->_gen[_ni] = _b->_cur;
+    }
+    *_theta = _b->_theta[_ni];
+    return _b->_k[_ni];
+}
+
+static inline double vtable_at(const vtable_grid_t* _g, int _k, double _theta, int _c) {
+    const double* _r = _g->_rows + (size_t) _k * _g->_ncol + _c;
+    return _r[0] + _theta * (_r[_g->_ncol] - _r[0]);
+}
+
+#endif
@@ -0,0 +1,137 @@
+TITLE vtable.mod  storage of the voltage tables shared between mechanisms
+
+COMMENT
+No mechanism of its own; holds the grids and their per-thread bin caches
+declared in vtable.h, which the mechanisms using shared tables link against.
+vtable_columns() returns the number of registered columns of all grids.
+ENDCOMMENT
+
+NEURON {
+	SUFFIX nothing
+	THREADSAFE
+}
+
+VERBATIM
+#include <stdlib.h>
+#include <string.h>
+#include "vtable.h"
+
+#define VTABLE_MAXSLICE 32
+
+static vtable_grid_t _grid[VTABLE_MAXGRID];
+static int _ngrid;
+
+static struct {
+	const char* _name;
+	int _grid, _col, _ncol, _valid;
+	double _dt, _celsius;
+} _slice[VTABLE_MAXSLICE];
+static int _nslice;
+
+static int _grid_find(double _vmin, double _vmax, int _n) {
+	int _g;
+	for (_g = 0; _g < _ngrid; ++_g) {
+		if (_grid[_g]._vmin == _vmin && _grid[_g]._vmax == _vmax && _grid[_g]._n == _n) {
+			return _g;
+		}
+	}
+	if (_ngrid == VTABLE_MAXGRID) {
+		hoc_execerror("vtable:", "too many grids");
+	}
+	/* as the generated table check */
+	_grid[_ngrid]._vmin = _vmin;
+	_grid[_ngrid]._vmax = _vmax;
+	_grid[_ngrid]._n = _n;
+	_grid[_ngrid]._dx = (_vmax - _vmin) / _n;
+	_grid[_ngrid]._mfac = 1. / _grid[_ngrid]._dx;
+	return _ngrid++;
+}
+
+int vtable_register(const char* _name, int _ncol, double _vmin, double _vmax, int _n) {
+	int _id, _g;
+	for (_id = 0; _id < _nslice; ++_id) {
+		if (strcmp(_slice[_id]._name, _name) == 0) {
+			return _id;
+		}
+	}
+	if (_nslice == VTABLE_MAXSLICE) {
+		hoc_execerror("vtable: too many mechanisms registered", _name);
+	}
+	_g = _grid_find(_vmin, _vmax, _n);
+	_slice[_nslice]._name = _name;
+	_slice[_nslice]._grid = _g;
+	_slice[_nslice]._col = _grid[_g]._ncol;
+	_slice[_nslice]._ncol = _ncol;
+	_grid[_g]._ncol += _ncol;
+	free(_grid[_g]._rows);
+	_grid[_g]._rows = (double*) calloc((size_t) (_n + 2) * _grid[_g]._ncol, sizeof(double));
+	for (_id = 0; _id < _nslice; ++_id) {
+		if (_slice[_id]._grid == _g) {
+			_slice[_id]._valid = 0;
+		}
+	}
+	_slice[_nslice]._valid = 0;
+	return _nslice++;
+}
+
+vtable_grid_t* vtable_grid(int _id) {
+	return _grid + _slice[_id]._grid;
+}
+
+int vtable_col(int _id) {
+	return _slice[_id]._col;
+}
+
+int vtable_stale(int _id, double _dt, double _celsius) {
+	return !_slice[_id]._valid || _slice[_id]._dt != _dt || _slice[_id]._celsius != _celsius;
+}
+
+/* row n + 1 repeats row n for lookups clamped at the top */
+void vtable_filled(int _id, double _dt, double _celsius) {
+	vtable_grid_t* _g = vtable_grid(_id);
+	int _c;
+	for (_c = _slice[_id]._col; _c < _slice[_id]._col + _slice[_id]._ncol; ++_c) {
+		vtable_row(_g, _g->_n + 1)[_c] = vtable_row(_g, _g->_n)[_c];
+	}
+	_slice[_id]._valid = 1;
+	_slice[_id]._dt = _dt;
+	_slice[_id]._celsius = _celsius;
+}
+
+void vtable_prepare(vtable_grid_t* _g, NrnThread* _nt) {
+	vtable_bins_t* _b = _g->_bins + _nt->id;
+	if (_b->_n >= _nt->end) {
+		return;
+	}
+	free(_b->_k);
+	free(_b->_theta);
+	free(_b->_t);
+	free(_b->_gen);
+	_b->_n = _nt->end;
+	_b->_k = (int*) calloc(_b->_n, sizeof(int));
+	_b->_theta = (double*) calloc(_b->_n, sizeof(double));
+	_b->_t = (double*) calloc(_b->_n, sizeof(double));
+	_b->_gen = (int*) calloc(_b->_n, sizeof(int));
+	_b->_cur++;
+}
+
+void vtable_invalidate(NrnThread* _nt) {
+	int _g;
+	if (_nt->id >= VTABLE_MAXTHREAD) {
+		hoc_execerror("vtable:", "supports at most 64 threads (VTABLE_MAXTHREAD)");
+	}
+	for (_g = 0; _g < _ngrid; ++_g) {
+		_grid[_g]._bins[_nt->id]._cur++;
+	}
+}
+ENDVERBATIM
+
+FUNCTION vtable_columns() {
+VERBATIM
+	int _g;
+	_lvtable_columns = 0.;
+	for (_g = 0; _g < _ngrid; ++_g) {
+		_lvtable_columns += _grid[_g]._ncol;
+	}
+ENDVERBATIM
+}
@@ -0,0 +1,180 @@
+// -*- coding: utf-8 -*-
+/*
+_ringconn.cpp
+
+Connectivity on the ring of gennetwork.pos(). Cell i of a population of n
+sits at angle 2*pi*i/n, so the target pool of a presynaptic cell (the
+target_pool postsynaptic cells closest to it) is an index window around
+i*n_post/n_pre. Distances are compared as exact integer arc lengths,
+min(|j*n_pre - i*n_post| mod n_pre*n_post), ties go to the lower index.
+
+ring_csr() picks divergence cells of each pool without replacement and a
+segment index for every picked cell and returns CSR arrays (pre -> post,
+segment). Every presynaptic cell draws from its own generator seeded with
+(seed, pre index), so the result does not depend on the number of threads.
+This is not the numpy generator; connectivity.ring_connectivity() has a
+compat mode for that. Built by setup.py, used through ouropy.connectivity.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// splitmix64 (Steele, Lea & Flood 2014) on a counter
+struct Stream {
+    uint64_t state;
+
+    Stream(uint64_t seed, uint64_t index) : state(seed) {
+        state = next() ^ index;
+        next();
+    }
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, n), n > 0, without modulo bias
+    uint64_t below(uint64_t n) {
+        uint64_t threshold = (0 - n) % n;
+        for (;;) {
+            uint64_t x = next();
+            if (x >= threshold) {
+                return x % n;
+            }
+        }
+    }
+};
+
+struct Ring {
+    int64_t n_pre, n_post, target_pool, divergence;
+    const int64_t* n_segs;
+    uint64_t seed;
+    int64_t* post;
+    int64_t* seg;
+
+    int64_t arc(int64_t i, int64_t j) const {
+        int64_t period = n_pre * n_post;
+        int64_t a = ((j * n_pre - i * n_post) % period + period) % period;
+        return std::min(a, period - a);
+    }
+
+    // the target_pool closest post cells of pre cell i, closest first. Cell
+    // i lies between post cells center and center + 1; walking away from it
+    // on both sides gives two runs of growing distance, which are merged.
+    void pool(int64_t i, std::vector<int64_t>& out) const {
+        int64_t size = std::min(target_pool, n_post);
+        int64_t left = i * n_post / n_pre, right = left + 1;
+        out.clear();
+        while (static_cast<int64_t>(out.size()) < size) {
+            int64_t a = left % n_post, b = right % n_post;
+            int64_t da = arc(i, a), db = arc(i, b);
+            if (da < db || (da == db && a < b)) {
+                out.push_back(a);
+                left += n_post - 1;
+            } else {
+                out.push_back(b);
+                ++right;
+            }
+        }
+    }
+
+    void run(int64_t begin, int64_t end) const {
+        std::vector<int64_t> cells;
+        for (int64_t i = begin; i < end; ++i) {
+            Stream rng(seed, static_cast<uint64_t>(i));
+            pool(i, cells);
+            // partial Fisher-Yates: the first divergence cells are the picks
+            for (int64_t k = 0; k < divergence; ++k) {
+                int64_t r = k + static_cast<int64_t>(rng.below(cells.size() - k));
+                std::swap(cells[k], cells[r]);
+                post[i * divergence + k] = cells[k];
+                seg[i * divergence + k] = static_cast<int64_t>(rng.below(n_segs[cells[k]]));
+            }
+        }
+    }
+};
+
+PyObject* ring_csr(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"n_pre", "n_post", "target_pool", "divergence", "n_segs", "seed", "nthreads", nullptr};
+    long long n_pre, n_post, target_pool, divergence;
+    unsigned long long seed;
+    int nthreads = 0;
+    Py_buffer segs_buf;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "LLLLy*K|i", const_cast<char**>(keywords), &n_pre, &n_post,
+                                     &target_pool, &divergence, &segs_buf, &seed, &nthreads)) {
+        return nullptr;
+    }
+    std::string error;
+    if (n_pre < 0 || n_post < 1 || target_pool < 0 || divergence < 0) {
+        error = "population sizes, target_pool and divergence must not be negative";
+    } else if (divergence > std::min(target_pool, n_post)) {
+        error = "divergence is larger than the target pool";
+    } else if (segs_buf.len != n_post * static_cast<Py_ssize_t>(sizeof(int64_t))) {
+        error = "n_segs must hold one int64 per postsynaptic cell";
+    } else {
+        const int64_t* n_segs = static_cast<const int64_t*>(segs_buf.buf);
+        for (long long j = 0; j < n_post; ++j) {
+            if (n_segs[j] < 1) {
+                error = "every postsynaptic cell needs at least one target segment";
+                break;
+            }
+        }
+    }
+    if (!error.empty()) {
+        PyBuffer_Release(&segs_buf);
+        PyErr_SetString(PyExc_ValueError, error.c_str());
+        return nullptr;
+    }
+
+    std::vector<int64_t> indptr(n_pre + 1), post(n_pre * divergence), seg(n_pre * divergence);
+    for (long long i = 0; i <= n_pre; ++i) {
+        indptr[i] = i * divergence;
+    }
+    Ring ring = {n_pre, n_post, target_pool, divergence, static_cast<const int64_t*>(segs_buf.buf),
+                 static_cast<uint64_t>(seed), post.data(), seg.data()};
+    if (nthreads < 1) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nthreads = static_cast<int>(std::min<long long>(nthreads, std::max(1LL, n_pre / 64)));
+
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<std::thread> workers;
+    for (int k = 1; k < nthreads; ++k) {
+        workers.emplace_back(&Ring::run, &ring, n_pre * k / nthreads, n_pre * (k + 1) / nthreads);
+    }
+    ring.run(0, n_pre / nthreads);
+    for (auto& w : workers) {
+        w.join();
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&segs_buf);
+
+    auto to_bytes = [](const std::vector<int64_t>& v) {
+        return PyBytes_FromStringAndSize(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(int64_t));
+    };
+    return Py_BuildValue("(NNN)", to_bytes(indptr), to_bytes(post), to_bytes(seg));
+}
+
+PyMethodDef methods[] = {
+    {"ring_csr", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(ring_csr)), METH_VARARGS | METH_KEYWORDS,
+     "ring_csr(n_pre, n_post, target_pool, divergence, n_segs, seed, nthreads=0)\n\n"
+     "CSR connectivity on the ring as bytes of int64: (indptr, post, seg)."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef module = {PyModuleDef_HEAD_INIT, "_ringconn", "Ring connectivity builder.", -1, methods, nullptr, nullptr, nullptr, nullptr};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__ringconn(void) {
+    return PyModule_Create(&module);
+}
@@ -0,0 +1,67 @@
+# -*- coding: utf-8 -*-
+"""
+Connectivity on the ring of gennetwork.pos(), as used by tmgsynConnection:
+every presynaptic cell connects to divergence cells picked from the
+target_pool postsynaptic cells closest to it, and to one target segment of
+each picked cell.
+
+ring_connectivity() returns CSR arrays (indptr, post, seg): the targets of
+presynaptic cell i are post[indptr[i]:indptr[i+1]], seg holds the index of the
+chosen segment in the target's get_segs_by_name() list.
+
+mode="compat" makes the same numpy random draws, in the same order, as the
+original per pair distance loop in tmgsynConnection, so a network built with
+the same np.random.seed is the same. The distances are computed with the
+Python float arithmetic of that loop (x ** 2 is libm's pow, which can differ
+in the last bit from numpy's vectorized square and reorder nearly equal
+distances), in one comprehension per presynaptic cell.
+
+mode="native" uses the C++ builder ouropy/_ringconn.cpp (built by setup.py).
+It finds the target pool as an index window and draws from its own
+generator per presynaptic cell, seeded with (seed, cell index), so it is
+O(n_pre * target_pool), runs on nthreads threads and gives the same result
+for any number of threads, but not the numpy draws of compat mode. seed
+defaults to a number drawn from np.random.
+"""
+
+import math
+
+import numpy as np
+
+try:
+    from ouropy import _ringconn
+except ImportError:
+    _ringconn = None
+
+
+def ring_connectivity(n_pre, n_post, target_pool, divergence, n_segs, mode="compat", seed=None, nthreads=0):
+    """CSR connectivity (indptr, post, seg) on the ring, see the module
+    docstring. n_segs holds the number of target segments of every
+    postsynaptic cell."""
+    n_segs = np.ascontiguousarray(n_segs, dtype=np.int64)
+    if mode == "native":
+        if _ringconn is None:
+            raise ImportError("ouropy._ringconn is not built, run setup.py build_ext --inplace or use mode='compat'")
+        if seed is None:
+            seed = np.random.randint(2**31)
+        indptr, post, seg = _ringconn.ring_csr(n_pre, n_post, target_pool, divergence, n_segs, seed, nthreads)
+        return (np.frombuffer(indptr, dtype=np.int64), np.frombuffer(post, dtype=np.int64), np.frombuffer(seg, dtype=np.int64))
+    if mode != "compat":
+        raise ValueError("mode must be 'compat' or 'native'")
+
+    pre_rad = (np.arange(n_pre, dtype=float) / n_pre) * (2 * np.pi)
+    post_rad = (np.arange(n_post, dtype=float) / n_post) * (2 * np.pi)
+    pre_x, pre_y = np.cos(pre_rad).tolist(), np.sin(pre_rad).tolist()
+    post_xy = list(zip(np.cos(post_rad).tolist(), np.sin(post_rad).tolist()))
+    sqrt = math.sqrt
+    post = []
+    seg = []
+    for idx in range(n_pre):
+        x0, y0 = pre_x[idx], pre_y[idx]
+        curr_dist = [sqrt((x0 - x) ** 2 + (y0 - y) ** 2) for x, y in post_xy]
+        closest_cells = np.argsort(curr_dist)[0:target_pool]
+        picked_cells = np.random.choice(closest_cells, divergence, replace=False)
+        post.extend(picked_cells)
+        seg.extend(np.random.choice(n_segs[tar_c]) for tar_c in picked_cells)
+    indptr = np.arange(n_pre + 1, dtype=np.int64) * divergence
+    return indptr, np.array(post, dtype=np.int64), np.array(seg, dtype=np.int64)
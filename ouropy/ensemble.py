@@ -0,0 +1,86 @@
+# -*- coding: utf-8 -*-
+"""
+Several trials of one network, e.g. the runs of a paradigm with different
+input seeds, simulated side by side in one NEURON run. The trials are
+ordinary networks built one after the other with the same network seed, so
+their cells, mechanisms and recurrent connections are the same; only the
+inputs differ. They share the mechanism plans of GenNeuron, the rate tables
+and the run loop, and every trial keeps its own SpikeRecorder.
+
+Ensemble.partitions orders the root sections of the cells by cell and then
+by trial, [cell][trial], and use_ensemble turns on CVode.cache_efficient.
+The intent is that NEURON then lays out the nodes and the data of every
+mechanism in that order, so that the K instances of a mechanism in the same
+compartment of the K trials are neighbours; this has not been checked,
+rd/ensemble_benchmark.py prints the soma node indices to check it:
+
+    nets = [TunedNetwork(nw_seed, patterns[k], pp_gcs[k], pp_bcs[k]) for k in range(K)]
+    ens = Ensemble(nets)
+    neuron_tools.use_ensemble(ens, nthread=4)
+    neuron_tools.run_neuron_simulator()
+    spikes = ens.timestamps(k)      # of trial k, per population
+
+This is K full copies of the network in one process, not one shared copy of
+the structure: every trial has its own sections, mechanism instances and
+connections, so the memory grows with K as for K separate runs. What can be
+saved is the process start and mechanism loading per run, the per step
+overhead of the run loop and whatever the layout gives; none of it has been
+measured yet, see rd/ensemble_benchmark.py for the time and the memory.
+Serial networks only (not GenNetwork.parallel).
+"""
+
+import numpy as np
+
+from ouropy.gennetwork import GenNetwork
+from ouropy.loadbalance import LoadBalancer, greedy_partition
+
+
+class Ensemble(object):
+    """The trials of one network, see the module docstring.
+
+    Attributes
+    ----------
+    networks - list
+        one GenNetwork per trial, all with the same populations
+    """
+
+    def __init__(self, networks):
+        if GenNetwork.parallel:
+            raise ValueError("Ensemble needs serial networks")
+        self.networks = list(networks)
+        if not self.networks:
+            raise ValueError("Ensemble needs at least one network")
+        layout = self._layout(self.networks[0])
+        for nw in self.networks[1:]:
+            if self._layout(nw) != layout:
+                raise ValueError("the networks of an Ensemble must have the same populations")
+
+    @staticmethod
+    def _layout(network):
+        return [(pop.cell_type, pop.get_cell_number()) for pop in network.populations]
+
+    def __len__(self):
+        return len(self.networks)
+
+    def partitions(self, nthread=1, balancer=None):
+        """The cells of all trials in nthread lists for
+        neuron_tools.use_threads, each cell followed by the same cell of the
+        other trials. The K copies of a cell stay in one thread; the cells
+        are dealt out by cost (balancer, default LoadBalancer()) and keep
+        the order of the network within a thread."""
+        if balancer is None:
+            balancer = LoadBalancer()
+        units = []
+        for p, pop in enumerate(self.networks[0].populations):
+            for i in range(pop.get_cell_number()):
+                units.append([nw.populations[p].cells[i] for nw in self.networks])
+        costs = [balancer.cell_cost(unit[0]) * len(unit) for unit in units]
+        loads = np.zeros(nthread)
+        parts = greedy_partition(costs, nthread, loads)
+        balancer.predicted = loads
+        return [[cell for unit, part in zip(units, parts) if part == t for cell in unit] for t in range(nthread)]
+
+    def timestamps(self, trial):
+        """Spike times of every cell of trial, one list per population, see
+        gennetwork.Population.get_timestamps."""
+        return [pop.get_timestamps() for pop in self.networks[trial].populations]
@@ -15,6 +15,8 @@ import time
 import os
 import shelve
 import scipy.stats as stats
+from ouropy.connectivity import ring_connectivity
+from ouropy.gennetwork import bulk_tmgsyn, lumped_gvec, lumped_tmgsyn
 
 
 class GenConnection(object):
@@ -49,9 +51,14 @@ class GenConnection(object):
 
 class tmgsynConnection(GenConnection):
 
+    lumped = False
+    connectivity = "compat"
+    bulk = False
+
     def __init__(self, pre_pop, post_pop,
                  target_pool, target_segs, divergence,
-                 tau_1, tau_facil, U, tau_rec, e, thr, delay, weight):
+                 tau_1, tau_facil, U, tau_rec, e, thr, delay, weight,
+                 lumped=None, connectivity=None, bulk=None, rec_cond=True):
         """Create a connection with tmgsyn as published by Tsodyks, Pawelzik &
         Markram, 1998.
         The tmgsyn is a dynamic three state implicit resource synapse model.
@@ -97,6 +104,25 @@ class tmgsynConnection(GenConnection):
             delay between presynaptic signal and onset of postsynaptic signal
         weight - numeric
             weight for the netcon object connecting source and target
+        lumped - bool
+            connect all streams that converge on a section through one
+            tmgsyn per parameter set (see lumped_tmgsyn). conductances
+            then holds one recording per shared synapse, the g of all its
+            streams (see lumped_gvec). Defaults to the class attribute
+            tmgsynConnection.lumped.
+        connectivity - str
+            "compat" picks the targets with the same numpy draws as the
+            original pairwise distance loop, "native" with the C++ builder
+            (see ouropy.connectivity). Defaults to the class attribute
+            tmgsynConnection.connectivity.
+        bulk - bool
+            create all synapses, NetCons and conductance recordings in one
+            call of the hoc template BulkTmgsyn (ouropy/bulkconn.hoc).
+            synapses, netcons and conductances are then hoc Lists in
+            synapse order. Not used for lumped connections. Defaults to the
+            class attribute tmgsynConnection.bulk.
+        rec_cond - bool
+            record the conductance of every synapse into conductances.
 
         Returns
         -------
@@ -110,60 +136,80 @@ class tmgsynConnection(GenConnection):
 
         """
         self.init_parameters = locals()
+        if lumped is None:
+            lumped = self.lumped
+        if connectivity is None:
+            connectivity = self.connectivity
+        if bulk is None:
+            bulk = self.bulk
         self.pre_pop = pre_pop
         self.post_pop = post_pop
         pre_pop.add_connection(self)
         post_pop.add_connection(self)
-        pre_pop_rad = (np.arange(pre_pop.get_cell_number(), dtype=float) /
-                       pre_pop.get_cell_number()) * (2*np.pi)
-        post_pop_rad = (np.arange(post_pop.get_cell_number(), dtype=float) /
-                        post_pop.get_cell_number()) * (2*np.pi)
-
-        pre_pop_pos = pos(pre_pop_rad)
-        post_pop_pos = pos(post_pop_rad)
+        seg_pools = [cell.get_segs_by_name(target_segs)
+                     for cell in post_pop.cells]
+        indptr, post_idc, seg_idc = ring_connectivity(
+            pre_pop.get_cell_number(), post_pop.get_cell_number(),
+            target_pool, divergence, [len(x) for x in seg_pools],
+            mode=connectivity)
+        if bulk and not lumped:
+            self.pre_cell_targets = post_idc.reshape(
+                pre_pop.get_cell_number(), divergence)
+            self.bulk_conn, self.syn_post, self.syn_secs = bulk_tmgsyn(
+                pre_pop, seg_pools, indptr, post_idc, seg_idc,
+                (tau_1, tau_facil, U, tau_rec, e, thr, delay, weight),
+                rec_cond)
+            self.synapses = self.bulk_conn.syns
+            self.netcons = self.bulk_conn.netcons
+            self.conductances = self.bulk_conn.gvecs
+            return
         pre_cell_target = []
         synapses = []
         netcons = []
         conductances = []
+        recorded = set()
 
-        for idx, curr_cell_pos in enumerate(pre_pop_pos):
+        for idx in range(pre_pop.get_cell_number()):
 
-            curr_dist = []
-            for post_cell_pos in post_pop_pos:
-                curr_dist.append(euclidian_dist(curr_cell_pos, post_cell_pos))
-
-            sort_idc = np.argsort(curr_dist)
-            closest_cells = sort_idc[0:target_pool]
-            picked_cells = np.random.choice(closest_cells,
-                                            divergence,
-                                            replace=False)
+            picked_cells = post_idc[indptr[idx]:indptr[idx+1]]
             pre_cell_target.append(picked_cells)
-            for tar_c in picked_cells:
+            for tar_c, seg_idx in zip(picked_cells,
+                                      seg_idc[indptr[idx]:indptr[idx+1]]):
 
                 curr_syns = []
                 curr_netcons = []
                 curr_conductances = []
 
-                curr_seg_pool = post_pop[tar_c].get_segs_by_name(target_segs)
-                chosen_seg = np.random.choice(curr_seg_pool)
+                chosen_seg = seg_pools[tar_c][seg_idx]
                 for seg in chosen_seg:
-                    curr_syn = h.tmgsyn(chosen_seg(0.5))
-                    curr_syn.tau_1 = tau_1
-                    curr_syn.tau_facil = tau_facil
-                    curr_syn.U = U
-                    curr_syn.e = e
-                    curr_syn.tau_rec = tau_rec
+                    if lumped:
+                        curr_syn = lumped_tmgsyn(post_pop[tar_c], chosen_seg,
+                                                 tau_1, tau_facil, U,
+                                                 tau_rec, e)
+                    else:
+                        curr_syn = h.tmgsyn(chosen_seg(0.5))
+                        curr_syn.tau_1 = tau_1
+                        curr_syn.tau_facil = tau_facil
+                        curr_syn.U = U
+                        curr_syn.e = e
+                        curr_syn.tau_rec = tau_rec
                     curr_syns.append(curr_syn)
                     curr_netcon = h.NetCon(pre_pop[idx].soma(0.5)._ref_v,
                                            curr_syn, thr, delay,
                                            weight, sec=pre_pop[idx].soma)
-                    curr_gvec = h.Vector()
-                    curr_gvec.record(curr_syn._ref_g)
-                    curr_conductances.append(curr_gvec)
+                    if rec_cond and not lumped:
+                        curr_gvec = h.Vector()
+                        curr_gvec.record(curr_syn._ref_g)
+                        curr_conductances.append(curr_gvec)
+                    elif rec_cond and id(curr_syn) not in recorded:
+                        recorded.add(id(curr_syn))
+                        curr_conductances.append(
+                            lumped_gvec(post_pop[tar_c], curr_syn))
                     curr_netcons.append(curr_netcon)
                     netcons.append(curr_netcons)
                     synapses.append(curr_syns)
-            conductances.append(curr_conductances)
+            if rec_cond:
+                conductances.append(curr_conductances)
         self.conductances = conductances
         self.netcons = netcons
         self.pre_cell_targets = np.array(pre_cell_target)
@@ -842,11 +888,18 @@ class PerforantPathPoissonTmgsyn(GenConnection):
     """
     Patterned Perforant Path simulation as in Yim et al. 2015.
     uses vecevent.mod -> h.VecStim
+    With lumped=True (default PerforantPathPoissonTmgsyn.lumped) the
+    patterns share one tmgsyn per target section, see lumped_tmgsyn, and
+    the recording of its g, see lumped_gvec.
     """
+    lumped = False
+
     def __init__(self, post_pop, t_pattern, spat_pattern, target_segs,
-                 tau_1, tau_facil, U, tau_rec, e, weight):
+                 tau_1, tau_facil, U, tau_rec, e, weight, lumped=None):
 
         self.init_parameters = locals()
+        if lumped is None:
+            lumped = self.lumped
         post_pop.add_connection(self)
         synapses = []
         netcons = []
@@ -858,21 +911,30 @@ class PerforantPathPoissonTmgsyn(GenConnection):
         self.pattern_vec = h.Vector(t_pattern)
         self.vecstim.play(self.pattern_vec)
         conductances = []
+        recorded = set()
 
         for curr_cell in target_cells:
             curr_seg_pool = curr_cell.get_segs_by_name(target_segs)
             curr_conductances = []
             for seg in curr_seg_pool:
-                curr_syn = h.tmgsyn(seg(0.5))
-                curr_syn.tau_1 = tau_1
-                curr_syn.tau_facil = tau_facil
-                curr_syn.U = U
-                curr_syn.tau_rec = tau_rec
-                curr_syn.e = e
+                if lumped:
+                    curr_syn = lumped_tmgsyn(curr_cell, seg, tau_1, tau_facil,
+                                             U, tau_rec, e)
+                else:
+                    curr_syn = h.tmgsyn(seg(0.5))
+                    curr_syn.tau_1 = tau_1
+                    curr_syn.tau_facil = tau_facil
+                    curr_syn.U = U
+                    curr_syn.tau_rec = tau_rec
+                    curr_syn.e = e
                 curr_netcon = h.NetCon(self.vecstim, curr_syn)
-                curr_gvec = h.Vector()
-                curr_gvec.record(curr_syn._ref_g)
-                curr_conductances.append(curr_gvec)
+                if not lumped:
+                    curr_gvec = h.Vector()
+                    curr_gvec.record(curr_syn._ref_g)
+                    curr_conductances.append(curr_gvec)
+                elif id(curr_syn) not in recorded:
+                    recorded.add(id(curr_syn))
+                    curr_conductances.append(lumped_gvec(curr_cell, curr_syn))
                 curr_netcon.weight[0] = weight
                 netcons.append(curr_netcon)
                 synapses.append(curr_syn)
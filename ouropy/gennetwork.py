@@ -17,6 +17,8 @@ import numpy as np
 import scipy.stats as stats
 from neuron import h
 
+from ouropy.connectivity import ring_connectivity
+
 
 class GenNetwork(object):
     """The GenNetwork class organizes populations and connections to a network.
@@ -47,8 +49,36 @@ class GenNetwork(object):
     ---------
     >>> GenNetwork([GranuleCell, MossyCell], [500,15])
     Create an unconnected network of 500 Granule and 15 Mossy cells.
+
+    Distributed mode
+    ----------------
+    With GenNetwork.parallel = True (set before the populations are built)
+    every cell gets a global id, populations in the order they are made,
+    and only exists on the rank that assign_ranks gives it (round robin over
+    the gids by default). Population.cells holds None for the cells of other
+    ranks. tmgsynConnection and PerforantPathPoissonTmgsyn make the same
+    random draws on every rank, create the synapses of the local target
+    cells and connect them with pc.gid_connect; the other connection classes
+    are serial only. Run with neuron_tools.run_neuron_simulator(pc=GenNetwork.pc)
+    under mpirun. Population.get_timestamps gathers the spikes of all ranks.
+
+    Other ranks' spikes are queued at the exchange, not as they fire, so
+    with spike times on the step grid the order in which events due in the
+    same step reach a synapse would differ from the serial run; it decides
+    the last bits of linear synapses and, for differing weights, the result
+    of tmgsyn. run_neuron_simulator(pc=...) therefore interpolates the
+    spike times within the step (h.cvode.condition_order(2)), which
+    delivers the events in time order on any number of ranks. The spikes
+    are the same as those of the serial network run with
+    condition_order(2), see rd/parallel_equivalence.py.
     """
 
+    parallel = False
+    pc = None
+    # assign_ranks(cell_type, gids, nhost) -> rank of every gid, None is
+    # round robin, ouropy.loadbalance.LoadBalancer.assign_ranks by cost
+    assign_ranks = None
+
     def __init__(self, celltypes=None, cellnums=None):
         """Initialize instance empty or with cell populations.
         See gennetwork.Population for detailed implementation of Population.
@@ -125,13 +155,7 @@ class GenNetwork(object):
     def plot_aps(self, time=200):
         fig = plt.figure(figsize=(8.27, 11.69))
         for idx, pop in enumerate(self.populations):
-            cells = []
-            for ap_count in pop.ap_counters:
-                # as_numpy() doesn't work on windows 10???
-                try:
-                    cells.append(ap_count[0].as_numpy())
-                except:
-                    cells.append(np.array(ap_count[0]))
+            cells = list(pop.get_timestamps())
             # Workaround for matplotlib bug. plt.eventplot throws error when
             # first element empty
             if not np.array(cells[0]).any():
@@ -205,10 +229,26 @@ class GenNetwork(object):
         curr_shelve["populations"] = [[(i, timestamps) for i, timestamps in enumerate(p.get_timestamps()) if len(timestamps) > 0] for p in self.populations]
         curr_shelve.close()
 
+    def get_spike_recorder(self):
+        """The SpikeRecorder of the network, made on first use."""
+        if getattr(self, "spike_recorder", None) is None:
+            self.spike_recorder = SpikeRecorder()
+        return self.spike_recorder
+
     def __str__(self):
         return str(self.__class__).split("'")[1]
 
 
+def parallel_context():
+    """The ParallelContext of the distributed mode, None if
+    GenNetwork.parallel is False."""
+    if not GenNetwork.parallel:
+        return None
+    if GenNetwork.pc is None:
+        GenNetwork.pc = h.ParallelContext()
+    return GenNetwork.pc
+
+
 class GenConnection(object):
     def __init__(self):
         pass
@@ -238,7 +278,11 @@ class GenConnection(object):
 
 
 class tmgsynConnection(GenConnection):
-    def __init__(self, pre_pop, post_pop, target_pool, target_segs, divergence, tau_1, tau_facil, U, tau_rec, e, thr, delay, weight, rec_cond=False):
+    lumped = False
+    connectivity = "compat"
+    bulk = False
+
+    def __init__(self, pre_pop, post_pop, target_pool, target_segs, divergence, tau_1, tau_facil, U, tau_rec, e, thr, delay, weight, rec_cond=False, lumped=None, connectivity=None, bulk=None):
         """Create a connection with tmgsyn as published by Tsodyks, Pawelzik &
         Markram, 1998.
         The tmgsyn is a dynamic three state implicit resource synapse model.
@@ -284,6 +328,24 @@ class tmgsynConnection(GenConnection):
             delay between presynaptic signal and onset of postsynaptic signal
         weight - numeric
             weight for the netcon object connecting source and target
+        lumped - bool
+            connect all streams that converge on a section through one
+            tmgsyn per parameter set (see lumped_tmgsyn). With rec_cond
+            conductances then holds one recording per shared synapse, the
+            g of all its streams (see lumped_gvec). Defaults to the class
+            attribute tmgsynConnection.lumped.
+        connectivity - str
+            "compat" picks the targets with the same numpy draws as the
+            original pairwise distance loop, "native" with the C++ builder
+            (see ouropy.connectivity). Defaults to the class attribute
+            tmgsynConnection.connectivity.
+        bulk - bool
+            create all synapses, NetCons and conductance recordings in one
+            call of the hoc template BulkTmgsyn (ouropy/bulkconn.hoc).
+            synapses, netcons and conductances are then hoc Lists in
+            synapse order, and conductances are only recorded with
+            rec_cond. Not used for lumped connections. Defaults to the class
+            attribute tmgsynConnection.bulk.
 
         Returns
         -------
@@ -297,48 +359,78 @@ class tmgsynConnection(GenConnection):
 
         """
         self.init_parameters = locals()
+        if lumped is None:
+            lumped = self.lumped
+        if connectivity is None:
+            connectivity = self.connectivity
+        if bulk is None:
+            bulk = self.bulk
+        pc = parallel_context()
+        if pc is not None:
+            if bulk:
+                raise ValueError("bulk connections are not supported in the distributed mode")
+        pre_pop.check_source_threshold(thr)
         self.pre_pop = pre_pop
         self.post_pop = post_pop
         pre_pop.add_connection(self)
         post_pop.add_connection(self)
-        pre_pop_rad = (np.arange(pre_pop.get_cell_number(), dtype=float) / pre_pop.get_cell_number()) * (2 * np.pi)
-        post_pop_rad = (np.arange(post_pop.get_cell_number(), dtype=float) / post_pop.get_cell_number()) * (2 * np.pi)
-
-        pre_pop_pos = pos(pre_pop_rad)
-        post_pop_pos = pos(post_pop_rad)
+        seg_pools = [None if cell is None else cell.get_segs_by_name(target_segs) for cell in post_pop.cells]
+        indptr, post_idc, seg_idc = ring_connectivity(pre_pop.get_cell_number(), post_pop.get_cell_number(), target_pool, divergence, post_pop.count_segs(target_segs), mode=connectivity)
+        if bulk and not lumped:
+            self.pre_cell_targets = post_idc.reshape(pre_pop.get_cell_number(), divergence)
+            self.bulk_conn, self.syn_post, self.syn_secs = bulk_tmgsyn(pre_pop, seg_pools, indptr, post_idc, seg_idc, (tau_1, tau_facil, U, tau_rec, e, thr, delay, weight), rec_cond)
+            self.syn_list = self.bulk_conn.syns
+            self.synapses = self.bulk_conn.syns
+            self.netcons = self.bulk_conn.netcons
+            self.conductances = self.bulk_conn.gvecs
+            return
         pre_cell_target = []
         synapses = []
         netcons = []
         conductances = []
+        self.syn_list = []
+        self.syn_post = []
+        self.syn_secs = []
+        recorded = set()
 
-        for idx, curr_cell_pos in enumerate(pre_pop_pos):
-            curr_dist = []
-            for post_cell_pos in post_pop_pos:
-                curr_dist.append(euclidian_dist(curr_cell_pos, post_cell_pos))
-
-            sort_idc = np.argsort(curr_dist)
-            closest_cells = sort_idc[0:target_pool]
-            picked_cells = np.random.choice(closest_cells, divergence, replace=False)
+        for idx in range(pre_pop.get_cell_number()):
+            picked_cells = post_idc[indptr[idx] : indptr[idx + 1]]
             pre_cell_target.append(picked_cells)
-            for tar_c in picked_cells:
+            for tar_c, seg_idx in zip(picked_cells, seg_idc[indptr[idx] : indptr[idx + 1]]):
                 curr_syns = []
                 curr_netcons = []
                 curr_conductances = []
+                if seg_pools[tar_c] is None:
+                    continue
 
-                curr_seg_pool = post_pop[tar_c].get_segs_by_name(target_segs)
-                chosen_seg = np.random.choice(curr_seg_pool)
+                chosen_seg = seg_pools[tar_c][seg_idx]
                 for seg in chosen_seg:
-                    curr_syn = h.tmgsyn(chosen_seg(0.5))
-                    curr_syn.tau_1 = tau_1
-                    curr_syn.tau_facil = tau_facil
-                    curr_syn.U = U
-                    curr_syn.e = e
-                    curr_syn.tau_rec = tau_rec
+                    if lumped:
+                        curr_syn = lumped_tmgsyn(post_pop[tar_c], chosen_seg, tau_1, tau_facil, U, tau_rec, e)
+                    else:
+                        curr_syn = h.tmgsyn(chosen_seg(0.5))
+                        curr_syn.tau_1 = tau_1
+                        curr_syn.tau_facil = tau_facil
+                        curr_syn.U = U
+                        curr_syn.e = e
+                        curr_syn.tau_rec = tau_rec
                     curr_syns.append(curr_syn)
-                    curr_netcon = h.NetCon(pre_pop[idx].soma(0.5)._ref_v, curr_syn, thr, delay, weight, sec=pre_pop[idx].soma)
-                    curr_gvec = h.Vector()
-                    curr_gvec.record(curr_syn._ref_g)
-                    curr_conductances.append(curr_gvec)
+                    self.syn_list.append(curr_syn)
+                    self.syn_post.append(tar_c)
+                    self.syn_secs.append(chosen_seg)
+                    if pc is None:
+                        curr_netcon = h.NetCon(pre_pop[idx].soma(0.5)._ref_v, curr_syn, thr, delay, weight, sec=pre_pop[idx].soma)
+                    else:
+                        curr_netcon = pc.gid_connect(int(pre_pop.gids[idx]), curr_syn)
+                        curr_netcon.delay = delay
+                        curr_netcon.weight[0] = weight
+                    if rec_cond and not lumped:
+                        curr_gvec = h.Vector()
+                        curr_gvec.record(curr_syn._ref_g)
+                        curr_conductances.append(curr_gvec)
+                    elif rec_cond and id(curr_syn) not in recorded:
+                        recorded.add(id(curr_syn))
+                        curr_conductances.append(lumped_gvec(post_pop[tar_c], curr_syn))
                     curr_netcons.append(curr_netcon)
                     netcons.append(curr_netcons)
                     synapses.append(curr_syns)
@@ -410,6 +502,7 @@ class tmgsynConnectionExponentialProb(GenConnection):
 
         """
         self.init_parameters = locals()
+        pre_pop.check_source_threshold(thr)
         self.pre_pop = pre_pop
         self.post_pop = post_pop
         pre_pop.add_connection(self)
@@ -521,6 +614,7 @@ class tmgsynConnection_old(GenConnection):
 
         """
         self.init_parameters = locals()
+        pre_pop.check_source_threshold(thr)
         self.pre_pop = pre_pop
         self.post_pop = post_pop
         pre_pop.add_connection(self)
@@ -579,6 +673,7 @@ class Exp2SynConnection(GenConnection):
                  tau1, tau2, e, g_max, thr, delay, weight, name = "GC->MC"
         """
         self.init_parameters = locals()
+        pre_pop.check_source_threshold(thr)
         self.pre_pop = pre_pop
         self.post_pop = post_pop
         pre_pop.add_connection(self)
@@ -712,10 +807,23 @@ class PerforantPathPoissonTmgsyn(GenConnection):
     """
     Patterned Perforant Path simulation as in Yim et al. 2015.
     uses vecevent.mod -> h.VecStim
+    With lumped=True (default PerforantPathPoissonTmgsyn.lumped) the
+    patterns share one tmgsyn per target section, see lumped_tmgsyn, and
+    with rec_cond all patterns share the recording of its g, see lumped_gvec.
+    With a BulkSpikePlayer as player (default PerforantPathPoissonTmgsyn.player)
+    the pattern is played from the buffer of the player instead of its own
+    VecStim.
     """
 
-    def __init__(self, post_pop, t_pattern, spat_pattern, target_segs, tau_1, tau_facil, U, tau_rec, e, weight, rec_cond=False):
+    lumped = False
+    player = None
+
+    def __init__(self, post_pop, t_pattern, spat_pattern, target_segs, tau_1, tau_facil, U, tau_rec, e, weight, rec_cond=False, lumped=None, player=None):
         self.init_parameters = locals()
+        if lumped is None:
+            lumped = self.lumped
+        if player is None:
+            player = self.player
         post_pop.add_connection(self)
         synapses = []
         netcons = []
@@ -723,28 +831,46 @@ class PerforantPathPoissonTmgsyn(GenConnection):
         target_cells = post_pop[spat_pattern]
         self.pre_pop = "Implicit"
         self.post_pop = post_pop
-        self.vecstim = h.VecStim()
-        self.pattern_vec = h.Vector(t_pattern)
-        self.vecstim.play(self.pattern_vec)
+        if player is not None:
+            self.vecstim = player.add_source(t_pattern)
+        else:
+            self.vecstim = h.VecStim()
+            self.pattern_vec = h.Vector(t_pattern)
+            self.vecstim.play(self.pattern_vec)
         conductances = []
-
-        for curr_cell in target_cells:
+        self.syn_list = synapses
+        self.syn_post = []
+        self.syn_secs = []
+        recorded = set()
+
+        for curr_idx, curr_cell in zip(spat_pattern, target_cells):
+            if curr_cell is None:
+                continue
             curr_seg_pool = curr_cell.get_segs_by_name(target_segs)
             curr_conductances = []
             for seg in curr_seg_pool:
-                curr_syn = h.tmgsyn(seg(0.5))
-                curr_syn.tau_1 = tau_1
-                curr_syn.tau_facil = tau_facil
-                curr_syn.U = U
-                curr_syn.tau_rec = tau_rec
-                curr_syn.e = e
+                if lumped:
+                    curr_syn = lumped_tmgsyn(curr_cell, seg, tau_1, tau_facil, U, tau_rec, e)
+                else:
+                    curr_syn = h.tmgsyn(seg(0.5))
+                    curr_syn.tau_1 = tau_1
+                    curr_syn.tau_facil = tau_facil
+                    curr_syn.U = U
+                    curr_syn.tau_rec = tau_rec
+                    curr_syn.e = e
                 curr_netcon = h.NetCon(self.vecstim, curr_syn)
-                curr_gvec = h.Vector()
-                curr_gvec.record(curr_syn._ref_g)
-                curr_conductances.append(curr_gvec)
+                if rec_cond and not lumped:
+                    curr_gvec = h.Vector()
+                    curr_gvec.record(curr_syn._ref_g)
+                    curr_conductances.append(curr_gvec)
+                elif rec_cond and id(curr_syn) not in recorded:
+                    recorded.add(id(curr_syn))
+                    curr_conductances.append(lumped_gvec(curr_cell, curr_syn))
                 curr_netcon.weight[0] = weight
                 netcons.append(curr_netcon)
                 synapses.append(curr_syn)
+                self.syn_post.append(curr_idx)
+                self.syn_secs.append(seg)
             if rec_cond:
                 conductances.append(curr_conductances)
 
@@ -754,6 +880,157 @@ class PerforantPathPoissonTmgsyn(GenConnection):
         self.synapses = synapses
 
 
+class BulkSpikePlayer(object):
+    """
+    Plays the spike trains of many sources from one SpikePlayer
+    (spikeplayer.mod), which keeps all spikes in one time sorted buffer and
+    schedules at most one event per time step, instead of one per spike and
+    source, sending the spikes of the step at their own times. add_source
+    returns an idle VecStim that is used as the NetCon source of the train.
+    The buffer is handed to the SpikePlayer at the next finitialize.
+    """
+
+    def __init__(self):
+        self.player = h.SpikePlayer()
+        self.sources = h.List()
+        self.times = []
+        self.source_idc = []
+        self.loaded = False
+        self.fih = h.FInitializeHandler(0, self.load)
+
+    def add_source(self, t_pattern):
+        source = h.VecStim()
+        self.times.extend(t_pattern)
+        self.source_idc.extend([self.sources.count()] * len(t_pattern))
+        self.sources.append(source)
+        self.loaded = False
+        return source
+
+    def load(self):
+        if not self.loaded:
+            self.tvec = h.Vector(self.times)
+            self.srcvec = h.Vector(self.source_idc)
+            self.player.play(self.tvec, self.srcvec, self.sources)
+            self.loaded = True
+
+
+class ConductanceAggregate(object):
+    """
+    Records sums of synaptic conductances with one GAggregate
+    (gaggregate.mod) instead of one Vector per synapse and time step.
+    add_connection assigns the synapses of a connection to bins by
+    postsynaptic cell (by="cell"), by connection (by="connection") or by
+    target section (by="section"). Bins are numbered in the order they are
+    first seen, labels holds their names. g is sampled every `every` ms from
+    the next finitialize on; get_g returns an array of shape
+    (samples, bins). A synapse shared by lumped connections is counted once.
+    """
+
+    def __init__(self, every=1.0):
+        self.agg = h.GAggregate()
+        self.agg.every = every
+        self.vec = h.Vector()
+        self.agg.record(self.vec)
+        self.labels = []
+        self.bins = {}
+        self.added = set()
+
+    def get_bin(self, key, label):
+        if key not in self.bins:
+            self.bins[key] = len(self.labels)
+            self.labels.append(label)
+        return self.bins[key]
+
+    def add_connection(self, conn, by="cell"):
+        if by == "cell":
+            bins = [self.get_bin((str(conn.post_pop), post), (str(conn.post_pop), int(post))) for post in conn.syn_post]
+        elif by == "connection":
+            bins = [self.get_bin(id(conn), conn.get_name())] * len(conn.syn_post)
+        elif by == "section":
+            bins = [self.get_bin(sec.name(), sec.name()) for sec in conn.syn_secs]
+        else:
+            raise ValueError("by must be 'cell', 'connection' or 'section'")
+        if getattr(conn, "bulk_conn", None) is not None:
+            conn.bulk_conn.aggregate(self.agg, h.Vector(bins))
+            return
+        for syn, b in zip(conn.syn_list, bins):
+            if id(syn) not in self.added:
+                self.added.add(id(syn))
+                self.agg.add(syn._ref_g, b)
+
+    def get_g(self):
+        return np.array(self.vec).reshape(-1, int(self.agg.nbin))
+
+
+class SpikeRecorder(object):
+    """
+    Records the spikes of all cells of a network as (gid, time) pairs in one
+    pair of Vectors. The spike detector of a cell is the NetCon source at
+    soma(0.5), which NEURON shares with every NetCon that the connections
+    make from the same soma, so recording adds no detector; all of them
+    use one threshold, see Population.check_source_threshold. The Vectors
+    grow as spikes come in and are cleared by finitialize.
+
+    Cells can also be recorded by an APCount of their own (add_counter),
+    which detects at its own threshold without touching the one of the
+    connections, one Vector per cell.
+
+    times(gids) and block(first, last) return numpy views into the
+    Vectors, which are sorted by gid (stable, so by time within a gid) when
+    they are not. A view is valid until the simulation goes on. With
+    APCounts the Vectors are merged, and the arrays are copies.
+    """
+
+    def __init__(self):
+        self.t = h.Vector()
+        self.gid = h.Vector()
+        self.counted = []
+
+    def add(self, detector, gid):
+        detector.record(self.t, self.gid, gid)
+
+    def add_counter(self, time_vec, gid):
+        """Adds the spike times that an APCount records into time_vec, see
+        genneuron.GenNeuron._AP_counter."""
+        self.counted.append((gid, time_vec))
+
+    def arrays(self):
+        """The spike times and gids, sorted by gid."""
+        if self.counted:
+            t = np.concatenate([np.array(self.t)] + [np.array(v) for _, v in self.counted])
+            gid = np.concatenate([np.array(self.gid)] + [np.full(len(v), g, dtype=float) for g, v in self.counted])
+            order = np.argsort(gid, kind="stable")
+            return t[order], gid[order]
+        # as_numpy() doesn't work on windows 10 ???
+        try:
+            t, gid = self.t.as_numpy(), self.gid.as_numpy()
+            copied = False
+        except:
+            t, gid = np.array(self.t), np.array(self.gid)
+            copied = True
+        if np.any(gid[1:] < gid[:-1]):
+            order = np.argsort(gid, kind="stable")
+            t[:] = t[order]
+            gid[:] = gid[order]
+            if copied:
+                self.t.from_python(t)
+                self.gid.from_python(gid)
+        return t, gid
+
+    def block(self, first, last):
+        """Spike times and gids of gids first to last (inclusive)."""
+        t, gid = self.arrays()
+        lo, hi = np.searchsorted(gid, [first, last + 1])
+        return t[lo:hi], gid[lo:hi]
+
+    def times(self, gids):
+        """One array of spike times per gid in gids."""
+        t, gid = self.arrays()
+        lo = np.searchsorted(gid, gids, side="left")
+        hi = np.searchsorted(gid, gids, side="right")
+        return [t[a:b] for a, b in zip(lo, hi)]
+
+
 """Population ONLY REMAINS IN gennetwork TO KEEP pyDentate RUNNING. THE NEW
 IMPLEMENTATION OF POPULATION IS IN genpopulation"""
 
@@ -798,11 +1075,19 @@ class Population(object):
     network.
     """
 
+    spike_threshold = 10
+    record_threshold = None
+
     def __init__(self, cell_type=None, n_cells=None, parent_network=None):
         self.parent_network = parent_network
         self.cell_type = cell_type
         self.cells = []
+        self.gids = np.zeros(0, dtype=int)
+        self.gid_offset = 0
+        if parent_network is not None:
+            self.gid_offset = sum(p.get_cell_number() for p in getattr(parent_network, "populations", []))
         self.connections = []
+        self.source_thresholds = set()
         self.VClamps = []
         self.VClamps_i = []
         self.VRecords = []
@@ -842,6 +1127,11 @@ class Population(object):
         >>> popul = Population(parent_network = nw)
         >>> popul.make_cells(GranuleCell, 500)
         Create an empty population within nw and then create 500 granule cells
+
+        In the distributed mode (GenNetwork.parallel) the cells get the next
+        global ids of the population and only the cells assigned to this
+        rank are created, with a spike detector at soma(0.5) at
+        spike_threshold registered for their gid. The others are None.
         """
 
         if hasattr(self, "cell_type"):
@@ -853,8 +1143,32 @@ class Population(object):
         if not hasattr(self, "cells"):
             self.cells = []
 
-        for x in range(n_cells):
-            self.cells.append(cell_type())
+        pc = parallel_context()
+        gids = self.gid_offset + len(self.gids) + np.arange(n_cells)
+        if pc is None:
+            for x in range(n_cells):
+                self.cells.append(cell_type())
+            self.gids = np.concatenate((self.gids, gids))
+        else:
+            self.cells = list(self.cells)
+            if GenNetwork.assign_ranks is None:
+                ranks = gids % int(pc.nhost())
+            else:
+                ranks = np.asarray(GenNetwork.assign_ranks(cell_type, gids, int(pc.nhost())))
+            if not hasattr(self, "spike_detectors"):
+                self.spike_detectors = []
+            for gid, rank in zip(gids, ranks):
+                if rank != pc.id():
+                    self.cells.append(None)
+                    continue
+                cell = cell_type()
+                pc.set_gid2node(int(gid), int(rank))
+                detector = h.NetCon(cell.soma(0.5)._ref_v, None, sec=cell.soma)
+                detector.threshold = self.spike_threshold
+                pc.cell(int(gid), detector)
+                self.spike_detectors.append(detector)
+                self.cells.append(cell)
+            self.gids = np.concatenate((self.gids, gids))
 
         self.cells = np.array(self.cells, dtype=object)
 
@@ -869,22 +1183,84 @@ class Population(object):
         """Return the number of cells"""
         return len(self.cells)
 
-    def record_aps(self):
-        counters = []
-        for cell in self.cells:
-            counters.append(cell._AP_counter())
-
-        self.ap_counters = counters
-        return counters
+    def count_segs(self, target_segs):
+        """Number of sections named target_segs of every cell. In the
+        distributed mode the cells of other ranks count as many as the
+        local ones, all cells of a population have the same morphology."""
+        counts = [None if cell is None else len(cell.get_segs_by_name(target_segs)) for cell in self.cells]
+        pc = parallel_context()
+        if pc is None:
+            return counts
+        local = [c for c in counts if c is not None]
+        low = pc.allreduce(min(local) if local else np.inf, 3)
+        high = pc.allreduce(max(local) if local else -np.inf, 2)
+        if low != high:
+            raise ValueError("the cells of " + str(self) + " differ in the number of " + str(target_segs))
+        return [int(high)] * len(counts)
+
+    def check_source_threshold(self, thr):
+        """Checks the threshold thr of a NetCon from the somata of the
+        population. NEURON keeps one threshold per source, shared by all
+        NetCons from it, so thr must be spike_threshold in the distributed
+        mode and once record_aps reads the somata with spike detectors.
+        Raises ValueError otherwise."""
+        if thr == self.spike_threshold:
+            return
+        if parallel_context() is not None:
+            raise ValueError("thr must be the spike_threshold of pre_pop in the distributed mode")
+        if getattr(self, "spike_detectors", None):
+            raise ValueError("thr must be the spike_threshold of pre_pop, whose spikes are recorded by its spike detectors")
+        self.source_thresholds.add(thr)
+
+    def record_aps(self, threshold=None):
+        """Records the spikes of the cells into the SpikeRecorder of the
+        parent network (of the population without one).
+
+        By default (threshold None or spike_threshold) the recorder reads
+        the spike detectors of the somata, which the connections share, so
+        no detector is added and get_spikes returns views into one buffer;
+        in the distributed mode these are the detectors registered for the
+        gids of the local cells. Raises ValueError if connections from the
+        population detect at another threshold, see check_source_threshold.
+
+        At any other threshold (record_threshold, e.g. 0 mV as the APCounts
+        of older versions) every cell gets an APCount at soma(0.5)
+        (ap_counters), which leaves the detectors alone; the spikes are then
+        copied into one array."""
+        if self.parent_network is not None:
+            recorder = self.parent_network.get_spike_recorder()
+        else:
+            recorder = SpikeRecorder()
+        if threshold is None:
+            threshold = self.record_threshold
+        if threshold is not None and threshold != self.spike_threshold:
+            local = [(gid, cell) for gid, cell in zip(self.gids, self.cells) if cell is not None]
+            self.ap_counters = [cell._AP_counter(thr=threshold) for gid, cell in local]
+            for (gid, cell), (time_vec, ap) in zip(local, self.ap_counters):
+                recorder.add_counter(time_vec, int(gid))
+            self.spike_recorder = recorder
+            return recorder
+        if parallel_context() is None:
+            if self.source_thresholds:
+                raise ValueError("connections from " + str(self) + " detect at " + str(sorted(self.source_thresholds)) + ", not at spike_threshold; record_aps(threshold=...) records with APCounts")
+            self.spike_detectors = []
+            for cell in self.cells:
+                detector = h.NetCon(cell.soma(0.5)._ref_v, None, sec=cell.soma)
+                detector.threshold = self.spike_threshold
+                self.spike_detectors.append(detector)
+        local_gids = [gid for gid, cell in zip(self.gids, self.cells) if cell is not None]
+        for gid, detector in zip(local_gids, self.spike_detectors):
+            recorder.add(detector, int(gid))
+        self.spike_recorder = recorder
+        return recorder
+
+    def get_spikes(self):
+        """Spike times and gids of the local cells of the population, as
+        views into the buffers of the SpikeRecorder, sorted by gid."""
+        return self.spike_recorder.block(self.gid_offset, self.gid_offset + self.get_cell_number() - 1)
 
     def plot_aps(self, color="k"):
-        cells = []
-        for x in self.ap_counters:
-            # as_numpy() doesn't work on windows 10 ???
-            try:
-                cells.append(x[0].as_numpy())
-            except:
-                cells.append(np.array(x[0]))
+        cells = list(self.get_timestamps())
 
         # Workaround for matplotlib bug. plt.eventplot throws error when first
         # element empty
@@ -907,18 +1283,11 @@ class Population(object):
         if not os.path.isdir(directory):
             os.mkdir(directory)
         path = os.path.join(directory, f"{fname}.npz")
-        try:
-            ap_list = [x[0].as_numpy() for x in self.ap_counters]
-        except:
-            ap_list = [np.array(x[0]) for x in self.ap_counters]
+        ap_list = self.get_timestamps()
         np.savez(path, *ap_list)
 
     def perc_active_cells(self):
-        try:
-            # as_numpy doesn't work on windows 10 ???
-            timing_arrays = [x[0].as_numpy() for x in self.ap_counters]
-        except:
-            timing_arrays = [np.array(x[0]) for x in self.ap_counters]
+        timing_arrays = self.get_timestamps()
         active_counter = 0
         for x in timing_arrays:
             if x.size != 0:
@@ -938,10 +1307,20 @@ class Population(object):
                 self.cells[cell]._current_clamp_soma(amp=amp, dur=dur, delay=delay)
 
     def get_timestamps(self):
-        try:
-            return [x[0].as_numpy() for x in self.ap_counters]
-        except:
-            return [np.array(x[0]) for x in self.ap_counters]
+        """Spike times of every cell. In the distributed mode the spikes of
+        all ranks are gathered, so every rank has to call it."""
+        pc = parallel_context()
+        if pc is None:
+            return self.spike_recorder.times(self.gids)
+        t, gid = self.get_spikes()
+        parts = pc.py_allgather((np.array(t), np.array(gid)))
+        t = np.concatenate([part[0] for part in parts])
+        gid = np.concatenate([part[1] for part in parts])
+        order = np.argsort(gid, kind="stable")
+        t, gid = t[order], gid[order]
+        lo = np.searchsorted(gid, self.gids, side="left")
+        hi = np.searchsorted(gid, self.gids, side="right")
+        return [t[a:b] for a, b in zip(lo, hi)]
 
     def current_clamp_rnd(self, n_cells, amp=0.3, dur=5, delay=3):
         """DEPRECATE"""
@@ -972,7 +1351,7 @@ class Population(object):
     def get_properties(self):
         """Get the properties of the network"""
         ap_time_stamps = self.get_timestamps()
-        ap_numbers = [x[1].n for x in self.ap_counters]
+        ap_numbers = [len(x) for x in ap_time_stamps]
         try:
             v_rec = [x.as_numpy() for x in self.VRecords]
             vclamp_i = [x.as_numpy() for x in self.VClamps_i]
@@ -1024,3 +1403,62 @@ def pos(rad):
 def euclidian_dist(p1, p2):
     """p1 and p2 must both be of len 2 where p1 = (x1,y1); p2 = (x2,y2)"""
     return math.sqrt((p1[0] - p2[0]) ** 2 + (p1[1] - p2[1]) ** 2)
+
+
+def bulk_tmgsyn(pre_pop, seg_pools, indptr, post_idc, seg_idc, parameters, rec_cond):
+    """Creates the tmgsyns, NetCons and optionally the conductance recordings
+    of a CSR connectivity (see ouropy.connectivity) through one BulkTmgsyn
+    (ouropy/bulkconn.hoc) and returns it. seg_pools are the candidate
+    target sections of every postsynaptic cell, parameters are tau_1,
+    tau_facil, U, tau_rec, e, thr, delay and weight. As in tmgsynConnection
+    every target section gets one synapse per segment, all at 0.5.
+    Also returns the postsynaptic cell index and the section of every
+    synapse."""
+    h.load_file(os.path.join(os.path.dirname(os.path.abspath(__file__)), "bulkconn.hoc"))
+    sources = h.List()
+    for cell in pre_pop.cells:
+        sources.append(h.SectionRef(sec=cell.soma))
+    targets = h.List()
+    for pool in seg_pools:
+        for sec in pool:
+            targets.append(h.SectionRef(sec=sec))
+    offsets = np.cumsum([0] + [len(pool) for pool in seg_pools])
+    tgt = offsets[post_idc] + seg_idc
+    flat_pool = [sec for pool in seg_pools for sec in pool]
+    nseg = np.array([sec.nseg for sec in flat_pool])[tgt]
+    indptr = np.concatenate(([0], np.cumsum(nseg)))[indptr]
+    tgt = np.repeat(tgt, nseg)
+    conn = h.BulkTmgsyn(sources, targets, h.Vector(indptr), h.Vector(tgt), h.Vector(parameters), int(rec_cond))
+    return conn, np.repeat(post_idc, nseg), [flat_pool[k] for k in tgt]
+
+
+def lumped_tmgsyn(cell, sec, tau_1, tau_facil, U, tau_rec, e):
+    """Returns the tmgsyn at sec(0.5) of cell with the given parameters and
+    creates it on the first call for that section and parameter set.
+    tmgsyn keeps y, z, u and tsyn per NetCon and g is the sum of the
+    increments of all streams, so converging connections can share one
+    instance instead of one instance per NetCon."""
+    key = (sec.name(), tau_1, tau_facil, U, tau_rec, e)
+    lumped = cell.__dict__.setdefault("lumped_tmgsyns", {})
+    if key not in lumped:
+        syn = h.tmgsyn(sec(0.5))
+        syn.tau_1 = tau_1
+        syn.tau_facil = tau_facil
+        syn.U = U
+        syn.tau_rec = tau_rec
+        syn.e = e
+        lumped[key] = syn
+    return lumped[key]
+
+
+def lumped_gvec(cell, syn):
+    """Returns the Vector that records g of the lumped tmgsyn syn of cell and
+    starts the recording on the first call. g of a lumped synapse is the sum
+    of all its streams, so it is recorded once, however many NetCons and
+    connections share the synapse."""
+    gvecs = cell.__dict__.setdefault("lumped_gvecs", {})
+    if id(syn) not in gvecs:
+        gvec = h.Vector()
+        gvec.record(syn._ref_g)
+        gvecs[id(syn)] = gvec
+    return gvecs[id(syn)]
@@ -34,7 +34,20 @@ class GenNeuron(object):
     >>> myNeuron.mk_soma()
     >>> myNeuron.mk_dendrite()
     Ball-and-stick neuron with default geometry
+
+    insert_mechs() resolves a parameter set to the sections of the first cell
+    it is applied to and keeps the result per section layout, so further
+    cells of the same type only insert and assign. get_segs_by_name() looks
+    names up in an index of all_secs, which mk_soma and mk_dendrite reset;
+    call _reset_sec_index() after changing all_secs by hand.
+
+    mech_variants maps a mechanism name to one that is inserted in its place
+    with the same parameters (gnatbar_ichan2 becomes gnatbar_ichan2cv), e.g.
+    the CVode variants set by pydentate.neuron_tools.use_cvode_mechanisms.
+    Set it before the cells are made.
     """
+    _mech_plans = {}
+    mech_variants = {}
 
     def mk_soma(self, diam=None, L=None, name=None):
         """Assignes self.soma a hoc section with dimensions diam and L.
@@ -79,6 +92,7 @@ class GenNeuron(object):
         if not hasattr(self, 'all_secs'):
             self.all_secs = []
         self.all_secs.append(self.soma)
+        self._reset_sec_index()
 
     def mk_dendrite(self, n_secs=1, dend_name=None, sec_names=None, diam=None,
                     L=None, soma_loc=1):
@@ -125,6 +139,21 @@ class GenNeuron(object):
         self.dendrites.append(curr_dend)
         for x in curr_dend:
             self.all_secs.append(x)
+        self._reset_sec_index()
+
+    def _reset_sec_index(self):
+        self._sec_index = None
+
+    def _get_sec_index(self):
+        """Dict from section name to the sections of all_secs with that name,
+        in all_secs order, and the tuple of all names."""
+        if getattr(self, '_sec_index', None) is None:
+            names = tuple(x.name() for x in self.all_secs)
+            by_name = {}
+            for name, sec in zip(names, self.all_secs):
+                by_name.setdefault(name, []).append(sec)
+            self._sec_index = (by_name, names)
+        return self._sec_index
 
     def get_segs_by_name(self, name):
         """Returns a list of sections whose .name matches the name parameter.
@@ -148,18 +177,15 @@ class GenNeuron(object):
         if 'all' in name:
             return list(self.all_secs)
 
+        by_name = self._get_sec_index()[0]
         result = []
         if type(name) == str:
-            for x in self.all_secs:
-                if x.name() == name:
-                    result.append(x)
+            result.extend(by_name.get(name, ()))
         else:
             for x in name:
                 if not (type(x) == str):
                     raise TypeError("All elements of name must be str")
-                for y in self.all_secs:
-                    if y.name() == x:
-                        result.append(y)
+                result.extend(by_name.get(x, ()))
 
         return np.array(result, dtype=np.dtype(object))
 
@@ -185,18 +211,46 @@ class GenNeuron(object):
         Insert the parameters loaded from filename into self. See
         ouropy.parameters for details.
         """
-        mechanisms = parameters.get_mechs()
+        names = self._get_sec_index()[1]
+        key = (names, tuple(sorted(self.mech_variants.items())),
+               tuple((x.mech_name, x.sec_name, x.value)
+                     for x in parameters.param_list))
+        plan = GenNeuron._mech_plans.get(key)
+        if plan is None:
+            plan = self._mk_mech_plan(parameters)
+            GenNeuron._mech_plans[key] = plan
+
+        for sec, (mechs, values) in zip(self.all_secs, plan):
+            for z in mechs:
+                sec.insert(z)
+            for attr, value in values:
+                setattr(sec, attr, value)
+
+    def _mk_mech_plan(self, parameters):
+        """Resolves parameters to the sections of self: for every section of
+        all_secs the mechanisms to insert and the (attribute, value) pairs
+        to assign, in parameter order, with mech_variants applied."""
+        variants = self.mech_variants
+
+        def variant(attr):
+            head, sep, mech = attr.rpartition('_')
+            if sep and mech in variants:
+                return head + sep + variants[mech]
+            return attr
+
+        position = dict((id(x), i) for i, x in enumerate(self.all_secs))
+        plan = [(set(), []) for x in self.all_secs]
 
+        mechanisms = parameters.get_mechs()
         for x in mechanisms.keys():
-            sections = self.get_segs_by_name(x)
-            for y in sections:
-                for z in mechanisms[x]:
-                    y.insert(z)
-
-        for x in parameters:
-            sections = self.get_segs_by_name(x.sec_name)
-            for y in sections:
-                setattr(y, x.mech_name, x.value)
+            for y in self.get_segs_by_name(x):
+                plan[position[id(y)]][0].update(variants.get(z, z) for z in mechanisms[x])
+
+        for x in parameters.param_list:
+            for y in self.get_segs_by_name(x.sec_name):
+                plan[position[id(y)]][1].append((variant(x.mech_name), x.value))
+
+        return [(sorted(mechs), values) for mechs, values in plan]
 
     def _current_clamp_soma(self, amp=0.3, dur=500, delay=500):
         """Setup a current clamp at the soma(0.5) section.
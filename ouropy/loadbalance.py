@@ -0,0 +1,193 @@
+# -*- coding: utf-8 -*-
+"""
+Distribution of the cells of a network over threads and ranks by their cost.
+
+The cost of a cell is estimated from its structure: every segment counts 1
+for the cable plus the weight of each density mechanism inserted in it
+(default 1, see LoadBalancer.weights) and of each point process on it, so a
+granule cell with 9 sections costs less than a mossy cell with 17 and more
+mechanisms. LoadBalancer.calibrate() replaces the guess with a measurement:
+it times a short run of n_cells cells of every type on their own and scales
+the estimate of every cell of that type by the measured time per unit.
+
+Cells are given to the least loaded thread or rank, largest first:
+
+    lb = LoadBalancer()
+    lb.describe([GranuleCell, MossyCell, BasketCell, HippCell])   # or calibrate
+    gennetwork.GenNetwork.assign_ranks = lb.assign_ranks           # ranks
+    nw = TunedNetwork(...)
+    neuron_tools.use_threads(4, lb.partition(nw.populations, 4))   # threads
+    neuron_tools.run_neuron_simulator(...)
+    print(lb.report(lb.predicted, lb.achieved_threads(pc)))
+
+assign_ranks is called once per population before its cells exist, so
+there the cells of one population are dealt to the least loaded ranks in
+gid order with the cost of their type (synapses are not counted yet). That
+cost comes from the cells describe() or calibrate() built before the
+network; assign_ranks builds no cells, so that the network gets the same
+cells, random streams and hoc object indices as without load balancing.
+predicted holds the load of every partition after the last assign_ranks or
+partition; the achieved compute times come from ParallelContext.thread_ctime
+(threads) or step_time (ranks) after the run.
+"""
+
+import time
+
+import numpy as np
+from neuron import h
+
+
+def imbalance(loads):
+    """max / mean of the loads, 1 is a perfect balance."""
+    loads = np.asarray(loads, dtype=float)
+    if loads.size == 0 or loads.mean() == 0:
+        return 1.0
+    return loads.max() / loads.mean()
+
+
+def greedy_partition(costs, n_parts, loads=None):
+    """Index of the partition of every cost: largest cost first to the
+    least loaded partition, ties to the lowest index. loads (n_parts,) are
+    the loads to start from and are updated in place."""
+    costs = np.asarray(costs, dtype=float)
+    if loads is None:
+        loads = np.zeros(n_parts)
+    parts = np.zeros(costs.size, dtype=int)
+    for i in np.argsort(-costs, kind="stable"):
+        part = int(np.argmin(loads))
+        parts[i] = part
+        loads[part] += costs[i]
+    return parts
+
+
+class LoadBalancer(object):
+    """Cost estimates and balanced assignments of cells, see the module
+    docstring.
+
+    Attributes
+    ----------
+    weights - dict
+        cost per segment of a mechanism or point process by name, relative
+        to the cable of one segment; others cost default_weight
+    scale - dict
+        measured cost per estimated unit by cell type, set by calibrate
+    predicted - numpy array
+        load of every partition of the last assignment
+    """
+
+    default_weight = 1.0
+
+    def __init__(self, weights=None):
+        self.weights = {} if weights is None else dict(weights)
+        self.scale = {}
+        self.predicted = np.zeros(0)
+        self._type_costs = {}
+        self._rank_loads = None
+
+    def cell_cost(self, cell):
+        """Estimated cost of a GenNeuron from its segments, mechanisms and
+        point processes, times the calibrated scale of its type."""
+        return self._structure_cost(cell) * self.scale.get(type(cell), 1.0)
+
+    def _structure_cost(self, cell):
+        cost = 0.0
+        for sec in cell.all_secs:
+            for seg in sec:
+                cost += 1.0
+                for mech in seg:
+                    cost += self.weights.get(mech.name(), self.default_weight)
+                for pp in seg.point_processes():
+                    cost += self.weights.get(pp.hname().split("[")[0], self.default_weight)
+        return cost
+
+    def describe(self, cell_types):
+        """Records the cost of the structure of every cell type from one
+        cell built now, for type_cost. Call before the network is built."""
+        for cell_type in cell_types:
+            if cell_type not in self._type_costs:
+                self._type_costs[cell_type] = self._structure_cost(cell_type())
+
+    def type_cost(self, cell_type):
+        """cell_cost of a cell of cell_type without synapses, from the cell
+        describe() or calibrate() built."""
+        if cell_type not in self._type_costs:
+            raise ValueError("no cost of %s, call describe() or calibrate() with it before building the network" % cell_type.__name__)
+        return self._type_costs[cell_type] * self.scale.get(cell_type, 1.0)
+
+    def calibrate(self, cell_types, n_cells=50, t_stop=50, dt=0.1, pc=None):
+        """Measures the cost of every cell type: times t_stop ms of n_cells
+        unconnected cells of the type, less the time without them, and sets
+        scale so that cell_cost follows the measurement. The scales are
+        normalized to a mean of 1, so types that are not calibrated keep
+        the plain estimate. Also describes the types, see describe. Call
+        before the network is built. With pc the scales of rank 0 are used
+        on all ranks, so that every rank makes the same assignment."""
+
+        def run_time():
+            h.dt = dt
+            h.finitialize(-60)
+            start = time.perf_counter()
+            while h.t < t_stop - dt / 2:
+                h.fadvance()
+            return time.perf_counter() - start
+
+        base = run_time()
+        scale = {}
+        for cell_type in cell_types:
+            cells = [cell_type() for x in range(n_cells)]
+            estimate = self._structure_cost(cells[0])
+            self._type_costs.setdefault(cell_type, estimate)
+            measured = max(run_time() - base, 0.0) / n_cells
+            scale[cell_type] = measured / estimate
+            del cells
+        mean = np.mean(list(scale.values())) if scale else 0.0
+        for cell_type in scale:
+            scale[cell_type] = scale[cell_type] / mean if mean > 0 else 1.0
+        if pc is not None:
+            scale = pc.py_broadcast(scale, 0)
+        self.scale.update(scale)
+        return dict(scale)
+
+    def assign_ranks(self, cell_type, gids, nhost):
+        """Rank of every gid, for GenNetwork.assign_ranks. The loads of the
+        ranks carry over from the populations made before."""
+        if self._rank_loads is None or self._rank_loads.size != nhost:
+            self._rank_loads = np.zeros(nhost)
+        costs = np.full(len(gids), self.type_cost(cell_type))
+        ranks = greedy_partition(costs, nhost, self._rank_loads)
+        self.predicted = self._rank_loads.copy()
+        return ranks
+
+    def partition(self, populations, nthread):
+        """The cells of populations (gennetwork.Population or sequences of
+        cells) in nthread lists of about the same cost, for
+        neuron_tools.use_threads. Cells of other ranks (None) are left out."""
+        cells = []
+        for pop in populations:
+            cells.extend(c for c in getattr(pop, "cells", pop) if c is not None)
+        costs = [self.cell_cost(c) for c in cells]
+        loads = np.zeros(nthread)
+        parts = greedy_partition(costs, nthread, loads)
+        self.predicted = loads
+        return [[c for c, p in zip(cells, parts) if p == i] for i in range(nthread)]
+
+    def achieved_threads(self, pc):
+        """Compute time of every thread since the last pc.thread_ctime()."""
+        return np.array([pc.thread_ctime(i) for i in range(int(pc.nthread()))])
+
+    def achieved_ranks(self, pc):
+        """Compute time of every rank in psolve, without waiting."""
+        return np.array(pc.py_allgather(pc.step_time()))
+
+    def report(self, predicted, achieved):
+        """Table of the share of every partition in the predicted load and
+        in the achieved time, and the imbalance (max / mean) of both."""
+        predicted = np.asarray(predicted, dtype=float)
+        achieved = np.asarray(achieved, dtype=float)
+        lines = ["partition  predicted  achieved"]
+        for i in range(max(predicted.size, achieved.size)):
+            pred = predicted[i] / predicted.sum() if i < predicted.size and predicted.sum() else np.nan
+            ach = achieved[i] / achieved.sum() if i < achieved.size and achieved.sum() else np.nan
+            lines.append("%9d  %8.1f%%  %7.1f%%" % (i, 100 * pred, 100 * ach))
+        lines.append("imbalance  %9.3f  %8.3f" % (imbalance(predicted), imbalance(achieved)))
+        return "\n".join(lines)
@@ -4,6 +4,7 @@ Created on Tue Jun 27 14:32:33 2017
 
 @author: DanielM
 """
+import os
 
 
 class Parameter(object):
@@ -78,7 +79,26 @@ class ParameterSet(list):
     def next(self):
         return self.__next__()
 
+_parsed = {}
+
+
+def parameter_files():
+    """Paths of the parameter files read by read_parameters so far."""
+    return sorted(set(path for path, mtime in _parsed))
+
+
 def read_parameters(path):
+    """Reads a tab separated parameter file (mech_name, sec_name, value per
+    line). Every file is parsed once per modification time; the returned
+    ParameterSets share the Parameter objects."""
+    path = os.path.abspath(path)
+    key = (path, os.path.getmtime(path))
+    if key not in _parsed:
+        _parsed[key] = _parse_parameters(path)
+    return ParameterSet(_parsed[key])
+
+
+def _parse_parameters(path):
 
     reader = open(path, 'r')
 
@@ -88,5 +108,5 @@ def read_parameters(path):
     second_split = [x.split('\t') for x in first_split]
     second_split = [x for x in second_split if bool(x[0])]
 
-    parameter_list = [Parameter(x[0], x[1], x[2]) for x in second_split]
-    return ParameterSet(parameter_list)
+    reader.close()
+    return [Parameter(x[0], x[1], x[2]) for x in second_split]
@@ -0,0 +1,110 @@
+# -*- coding: utf-8 -*-
+"""
+ouropy.connectivity.ring_connectivity: compat mode against the per pair
+loop it replaces, and native mode against the same target pools.
+"""
+
+import math
+import unittest
+
+import numpy as np
+
+from ouropy import connectivity
+
+
+def pair_loop(n_pre, n_post, target_pool, divergence, n_segs):
+    """The per pair distance loop of the original tmgsynConnection."""
+    pre_rad = (np.arange(n_pre, dtype=float) / n_pre) * (2 * np.pi)
+    post_rad = (np.arange(n_post, dtype=float) / n_post) * (2 * np.pi)
+    pre_pos = list(zip(np.cos(pre_rad), np.sin(pre_rad)))
+    post_pos = list(zip(np.cos(post_rad), np.sin(post_rad)))
+    targets = []
+    for curr_cell_pos in pre_pos:
+        curr_dist = []
+        for post_cell_pos in post_pos:
+            curr_dist.append(math.sqrt((curr_cell_pos[0] - post_cell_pos[0]) ** 2 + (curr_cell_pos[1] - post_cell_pos[1]) ** 2))
+        closest_cells = np.argsort(curr_dist)[0:target_pool]
+        picked_cells = np.random.choice(closest_cells, divergence, replace=False)
+        for tar_c in picked_cells:
+            targets.append((tar_c, np.random.choice(list(range(n_segs[tar_c])))))
+    return targets
+
+
+def pool_arc(n_pre, n_post, target_pool, i):
+    """Largest arc (in units of 2*pi/(n_pre*n_post)) within the target
+    pool of presynaptic cell i."""
+    period = n_pre * n_post
+    a = (np.arange(n_post) * n_pre - i * n_post) % period
+    return np.sort(np.minimum(a, period - a))[target_pool - 1]
+
+
+def arc(n_pre, n_post, i, j):
+    period = n_pre * n_post
+    a = (j * n_pre - i * n_post) % period
+    return min(a, period - a)
+
+
+class TestRingConnectivity(unittest.TestCase):
+    sizes = [(100, 2000, 100, 20), (24, 2000, 300, 50), (2000, 24, 12, 1), (60, 60, 9, 9)]
+
+    def n_segs(self, n_post):
+        return np.random.RandomState(0).randint(1, 5, size=n_post)
+
+    def test_compat_draws(self):
+        """compat mode makes the draws of the pair loop, in its order."""
+        for n_pre, n_post, pool, div in self.sizes:
+            n_segs = self.n_segs(n_post)
+            np.random.seed(1)
+            expected = pair_loop(n_pre, n_post, pool, div, n_segs)
+            after = np.random.random()
+            np.random.seed(1)
+            indptr, post, seg = connectivity.ring_connectivity(n_pre, n_post, pool, div, n_segs)
+            self.assertEqual(list(zip(post, seg)), expected)
+            np.testing.assert_array_equal(indptr, np.arange(n_pre + 1) * div)
+            self.assertEqual(np.random.random(), after)
+
+    def check_pools(self, n_pre, n_post, pool, div, n_segs, indptr, post, seg):
+        np.testing.assert_array_equal(indptr, np.arange(n_pre + 1) * div)
+        for i in range(n_pre):
+            targets = post[indptr[i]:indptr[i + 1]]
+            self.assertEqual(len(set(targets)), div)
+            limit = pool_arc(n_pre, n_post, pool, i)
+            self.assertTrue(all(arc(n_pre, n_post, i, j) <= limit for j in targets))
+        self.assertTrue(np.all((seg >= 0) & (seg < n_segs[post])))
+
+    def test_compat_pools(self):
+        for n_pre, n_post, pool, div in self.sizes:
+            n_segs = self.n_segs(n_post)
+            np.random.seed(2)
+            self.check_pools(n_pre, n_post, pool, div, n_segs, *connectivity.ring_connectivity(n_pre, n_post, pool, div, n_segs))
+
+    @unittest.skipIf(connectivity._ringconn is None, "ouropy._ringconn is not built")
+    def test_native_pools(self):
+        """native mode picks from the pools of compat mode."""
+        for n_pre, n_post, pool, div in self.sizes:
+            n_segs = self.n_segs(n_post)
+            result = connectivity.ring_connectivity(n_pre, n_post, pool, div, n_segs, mode="native", seed=3)
+            self.check_pools(n_pre, n_post, pool, div, n_segs, *result)
+
+    @unittest.skipIf(connectivity._ringconn is None, "ouropy._ringconn is not built")
+    def test_native_threads(self):
+        """native mode gives the same result for a seed on any number of
+        threads, and another for another seed."""
+        n_segs = self.n_segs(2000)
+        one = connectivity.ring_connectivity(1000, 2000, 100, 20, n_segs, mode="native", seed=4, nthreads=1)
+        four = connectivity.ring_connectivity(1000, 2000, 100, 20, n_segs, mode="native", seed=4, nthreads=4)
+        other = connectivity.ring_connectivity(1000, 2000, 100, 20, n_segs, mode="native", seed=5, nthreads=4)
+        for a, b in zip(one, four):
+            np.testing.assert_array_equal(a, b)
+        self.assertFalse(np.array_equal(one[1], other[1]))
+
+    @unittest.skipIf(connectivity._ringconn is None, "ouropy._ringconn is not built")
+    def test_native_errors(self):
+        with self.assertRaises(ValueError):
+            connectivity.ring_connectivity(10, 10, 3, 4, np.ones(10), mode="native", seed=0)
+        with self.assertRaises(ValueError):
+            connectivity.ring_connectivity(10, 10, 3, 2, np.zeros(10), mode="native", seed=0)
+
+
+if __name__ == '__main__':
+    unittest.main()
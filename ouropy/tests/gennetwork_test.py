@@ -0,0 +1,334 @@
+# -*- coding: utf-8 -*-
+"""
+Construction of the connection classes of ouropy.gennetwork, the bins of
+ConductanceAggregate, the spike recording of Population and SpikeRecorder,
+and the delivery order of BulkSpikePlayer.
+"""
+
+import unittest
+
+import numpy as np
+
+from ouropy import connectivity
+from ouropy.tests import mechs
+
+
+def small_population(n_cells):
+    from ouropy.gennetwork import Population
+    from ouropy.genneuron import GenNeuron
+
+    class SmallNeuron(GenNeuron):
+        name = 'SmallNeuron'
+
+        def __init__(self):
+            self.mk_soma(name='soma', diam=20, L=20)
+            self.mk_dendrite(2, dend_name='dend_1', sec_names=['proxd', 'midd'],
+                             diam=[3, 2], L=[100.0, 100.0], soma_loc=1)
+            self.mk_dendrite(2, dend_name='dend_2', sec_names=['proxd', 'midd'],
+                             diam=[3, 2], L=[100.0, 100.0], soma_loc=1)
+
+    return Population(SmallNeuron, n_cells)
+
+
+@unittest.skipUnless(mechs.load('VecStim'), "needs NEURON and VecStim")
+class TestPerforantPathPoissonStimulation(unittest.TestCase):
+    def test_construction(self):
+        from ouropy.gennetwork import PerforantPathPoissonStimulation
+        pop = small_population(4)
+        conn = PerforantPathPoissonStimulation(pop, [5.0, 10.0], [0, 2], 'midd', 0.5, 6, 0, 1e-3)
+        self.assertEqual(len(conn.synapses), 4)
+        self.assertEqual([len(x) for x in conn.conductances], [2, 2])
+
+
+@unittest.skipUnless(mechs.load('VecStim', 'tmgsyn', 'GAggregate'), "needs NEURON, tmgsyn and GAggregate")
+class TestPerforantPathPoissonTmgsyn(unittest.TestCase):
+    def mk_conn(self, pop, rec_cond=False):
+        from ouropy.gennetwork import PerforantPathPoissonTmgsyn
+        return PerforantPathPoissonTmgsyn(pop, [5.0, 10.0], [0, 2, 3], 'midd', 10, 0, 1, 0, 0, 1e-3, rec_cond=rec_cond)
+
+    def test_targets(self):
+        conn = self.mk_conn(small_population(4))
+        self.assertEqual(len(conn.syn_list), 6)
+        self.assertEqual(list(conn.syn_post), [0, 0, 2, 2, 3, 3])
+        self.assertEqual(len(conn.syn_secs), 6)
+
+    def test_rec_cond(self):
+        pop = small_population(4)
+        self.assertEqual(self.mk_conn(pop).conductances, [])
+        self.assertEqual([len(x) for x in self.mk_conn(pop, True).conductances], [2, 2, 2])
+
+    def test_lumped_rec_cond(self):
+        """Patterns that share a lumped synapse share the one recording of
+        its g."""
+        from ouropy.gennetwork import PerforantPathPoissonTmgsyn
+        pop = small_population(4)
+        first = PerforantPathPoissonTmgsyn(pop, [5.0], [0, 2], 'midd', 10, 0, 1, 0, 0, 1e-3, rec_cond=True, lumped=True)
+        second = PerforantPathPoissonTmgsyn(pop, [7.0], [2, 3], 'midd', 10, 0, 1, 0, 0, 1e-3, rec_cond=True, lumped=True)
+        self.assertEqual([len(x) for x in second.conductances], [2, 2])
+        self.assertIs(first.syn_list[2], second.syn_list[0])
+        self.assertIs(first.conductances[1][0], second.conductances[0][0])
+        self.assertIsNot(first.conductances[0][0], second.conductances[0][0])
+
+    def test_aggregate_bins(self):
+        from ouropy.gennetwork import ConductanceAggregate
+        pop = small_population(4)
+        conn = self.mk_conn(pop)
+        agg = ConductanceAggregate()
+        agg.add_connection(conn, by="cell")
+        self.assertEqual(int(agg.agg.nbin), 3)
+        self.assertEqual(int(agg.agg.n), 6)
+        by_sec = ConductanceAggregate()
+        by_sec.add_connection(conn, by="section")
+        self.assertEqual(int(by_sec.agg.nbin), 6)
+
+
+@unittest.skipUnless(mechs.load('tmgsyn'), "needs NEURON and tmgsyn")
+class TestTmgsynConnection(unittest.TestCase):
+    def test_targets(self):
+        """The connection makes one synapse per target of the ring
+        connectivity, on the chosen segment, from the same draws."""
+        from ouropy.connectivity import ring_connectivity
+        from ouropy.gennetwork import tmgsynConnection
+        pre, post = small_population(6), small_population(10)
+        np.random.seed(7)
+        conn = tmgsynConnection(pre, post, 4, 'midd', 2, 6.0, 0, 0.04, 0, 0, 10, 3, 1e-3)
+        after = np.random.random()
+        np.random.seed(7)
+        indptr, post_idc, seg_idc = ring_connectivity(6, 10, 4, 2, [2] * 10)
+        self.assertEqual(np.random.random(), after)
+        np.testing.assert_array_equal(conn.pre_cell_targets, post_idc.reshape(6, 2))
+        self.assertEqual(list(conn.syn_post), list(post_idc))
+        expected = [post.cells[j].get_segs_by_name('midd')[k] for j, k in zip(post_idc, seg_idc)]
+        self.assertTrue(all(a == b for a, b in zip(conn.syn_secs, expected)))
+        self.assertEqual(len(conn.syn_list), 12)
+
+    @unittest.skipIf(connectivity._ringconn is None, "ouropy._ringconn is not built")
+    def test_native(self):
+        from ouropy.gennetwork import tmgsynConnection
+        pre, post = small_population(6), small_population(10)
+        conn = tmgsynConnection(pre, post, 4, 'midd', 2, 6.0, 0, 0.04, 0, 0, 10, 3, 1e-3, connectivity="native")
+        self.assertEqual(conn.pre_cell_targets.shape, (6, 2))
+        self.assertEqual(len(conn.syn_list), 12)
+
+
+@unittest.skipUnless(mechs.load('VecStim', 'tmgsyn', 'GAggregate'), "needs NEURON, tmgsyn and GAggregate")
+class TestConductanceAggregate(unittest.TestCase):
+    def test_cache_efficient(self):
+        """The sums follow the synapses when cache_efficient moves their
+        data after the synapses were added."""
+        import numpy as np
+        from neuron import h
+        from ouropy.gennetwork import ConductanceAggregate, PerforantPathPoissonTmgsyn
+        pop = small_population(3)
+        conn = PerforantPathPoissonTmgsyn(pop, [2.0, 6.0], [0, 1], 'midd', 10, 0, 1, 0, 0, 1e-3, rec_cond=True)
+        agg = ConductanceAggregate(every=1.0)
+        agg.add_connection(conn, by="connection")
+        h.cvode.active(0)
+        h.cvode.cache_efficient(1)
+        try:
+            h.dt = 0.025
+            h.finitialize(-65)
+            while h.t < 10 - h.dt / 2:
+                h.fadvance()
+        finally:
+            h.cvode.cache_efficient(0)
+        g = agg.get_g()[:, 0]
+        recorded = np.sum([np.array(v) for x in conn.conductances for v in x], axis=0)
+        self.assertGreater(g.max(), 0)
+        np.testing.assert_allclose(g[:10], recorded[0:400:40][:10], rtol=1e-12, atol=1e-15)
+
+
+@unittest.skipUnless(mechs.load('APCount'), "needs NEURON")
+class TestRecordAps(unittest.TestCase):
+    def run_clamped(self, pop, tstop=60):
+        from neuron import h
+        for cell in pop.cells:
+            cell.soma.insert('hh')
+            cell._current_clamp_soma(amp=1.0, dur=40, delay=10)
+        h.dt = 0.025
+        h.finitialize(-65)
+        while h.t < tstop - h.dt / 2:
+            h.fadvance()
+
+    def test_default_threshold(self):
+        """By default the recorder reads the soma detectors, which the
+        connections share, and get_spikes returns views into its buffer."""
+        pop = small_population(2)
+        recorder = pop.record_aps()
+        self.assertFalse(hasattr(pop, 'ap_counters'))
+        self.assertEqual(recorder.counted, [])
+        self.assertEqual([d.threshold for d in pop.spike_detectors], [pop.spike_threshold] * 2)
+        self.run_clamped(pop)
+        t, gid = pop.get_spikes()
+        self.assertGreater(len(t), 0)
+        self.assertTrue(np.all(np.diff(gid) >= 0))
+        self.assertTrue(np.shares_memory(t, recorder.t.as_numpy()))
+        for k, times in enumerate(pop.get_timestamps()):
+            np.testing.assert_array_equal(times, t[gid == k])
+
+    def test_apcount_threshold(self):
+        """At another threshold the spikes are counted by APCounts, which
+        leave the threshold of the spike detectors alone."""
+        from neuron import h
+        pop = small_population(2)
+        detector = h.NetCon(pop.cells[0].soma(0.5)._ref_v, None, sec=pop.cells[0].soma)
+        detector.threshold = pop.spike_threshold
+        pop.record_aps(threshold=0)
+        self.assertEqual(len(pop.ap_counters), 2)
+        self.assertEqual([ap.thresh for _, ap in pop.ap_counters], [0, 0])
+        self.assertEqual(detector.threshold, pop.spike_threshold)
+        self.run_clamped(pop)
+        stamps = pop.get_timestamps()
+        for (time_vec, ap), times in zip(pop.ap_counters, stamps):
+            np.testing.assert_array_equal(times, np.array(time_vec))
+        t, gid = pop.get_spikes()
+        self.assertEqual(len(t), sum(len(x) for x in stamps))
+        self.assertTrue(np.all(np.diff(gid) >= 0))
+
+    def test_connection_threshold(self):
+        """A connection at another threshold and the soma detectors can not
+        go together, in either order."""
+        pop = small_population(2)
+        pop.check_source_threshold(pop.spike_threshold)
+        pop.check_source_threshold(0)
+        with self.assertRaises(ValueError):
+            pop.record_aps()
+        pop.record_aps(threshold=0)
+        other = small_population(2)
+        other.record_aps()
+        other.check_source_threshold(other.spike_threshold)
+        with self.assertRaises(ValueError):
+            other.check_source_threshold(0)
+
+
+class ArrayVector(object):
+    """Stand-in for h.Vector over a numpy array."""
+    def __init__(self, values):
+        self.values = np.array(values, dtype=float)
+
+    def as_numpy(self):
+        return self.values
+
+    def __len__(self):
+        return len(self.values)
+
+    def __array__(self, dtype=None, copy=None):
+        return np.array(self.values, dtype=dtype)
+
+
+class TestSpikeRecorderArrays(unittest.TestCase):
+    def recorder(self, t, gid):
+        from ouropy.gennetwork import SpikeRecorder
+        recorder = SpikeRecorder.__new__(SpikeRecorder)
+        recorder.t, recorder.gid = ArrayVector(t), ArrayVector(gid)
+        recorder.counted = []
+        return recorder
+
+    def test_views(self):
+        """arrays() sorts the buffers in place, stable by gid, and block()
+        and times() are views into them."""
+        recorder = self.recorder([1, 2, 3, 4, 5, 6], [3, 1, 3, 0, 1, 3])
+        t, gid = recorder.arrays()
+        np.testing.assert_array_equal(gid, [0, 1, 1, 3, 3, 3])
+        np.testing.assert_array_equal(t, [4, 2, 5, 1, 3, 6])
+        self.assertTrue(np.shares_memory(t, recorder.t.values))
+        bt, bgid = recorder.block(1, 2)
+        np.testing.assert_array_equal(bt, [2, 5])
+        self.assertTrue(np.shares_memory(bt, recorder.t.values))
+        times = recorder.times([0, 2, 3])
+        self.assertEqual([list(x) for x in times], [[4], [], [1, 3, 6]])
+        self.assertTrue(all(np.shares_memory(x, recorder.t.values) for x in times if x.size))
+
+    def test_counters(self):
+        """APCount Vectors are merged with the NetCon records."""
+        recorder = self.recorder([1, 2], [5, 3])
+        recorder.add_counter(ArrayVector([0.5, 7]), 4)
+        recorder.add_counter(ArrayVector([]), 6)
+        t, gid = recorder.arrays()
+        np.testing.assert_array_equal(gid, [3, 4, 4, 5])
+        np.testing.assert_array_equal(t, [2, 0.5, 7, 1])
+        self.assertEqual([list(x) for x in recorder.times([4, 6])], [[0.5, 7], []])
+
+
+@unittest.skipUnless(mechs.load('NetStim'), "needs NEURON")
+class TestSpikeRecorder(unittest.TestCase):
+    def test_netstims(self):
+        """The spikes of NetStims recorded under gids in reverse order come
+        out by gid and by time within a gid."""
+        from neuron import h
+        from ouropy.gennetwork import SpikeRecorder
+        recorder = SpikeRecorder()
+        stims, ncs = [], []
+        for k in range(4):
+            stim = h.NetStim()
+            stim.start, stim.interval, stim.number, stim.noise = 1 + k, 3, 3, 0
+            nc = h.NetCon(stim, None)
+            recorder.add(nc, 3 - k)
+            stims.append(stim)
+            ncs.append(nc)
+        h.dt = 0.025
+        h.finitialize(-65)
+        while h.t < 20:
+            h.fadvance()
+        times = recorder.times([0, 1, 2, 3])
+        for gid, x in enumerate(times):
+            np.testing.assert_allclose(x, 4 - gid + np.arange(3) * 3.0)
+        t, gid = recorder.block(1, 2)
+        self.assertTrue(np.shares_memory(t, recorder.t.as_numpy()))
+        np.testing.assert_array_equal(gid, [1, 1, 1, 2, 2, 2])
+
+
+@unittest.skipUnless(mechs.load('SpikePlayer', 'VecStim'), "needs NEURON and SpikePlayer")
+class TestBulkSpikePlayer(unittest.TestCase):
+    def run_sources(self, patterns, player):
+        from neuron import h
+        t_all, src_all = h.Vector(), h.Vector()
+        keep = []
+        for k, pattern in enumerate(patterns):
+            if player is None:
+                source = h.VecStim()
+                vec = h.Vector(sorted(pattern))
+                source.play(vec)
+                keep.append(vec)
+            else:
+                source = player.add_source(pattern)
+            nc = h.NetCon(source, None)
+            nc.record(t_all, src_all, k)
+            keep.append((source, nc))
+        h.dt = 0.025
+        h.finitialize(-65)
+        while h.t < 30:
+            h.fadvance()
+        return np.array(t_all), np.array(src_all)
+
+    def test_order(self):
+        """Every source fires its (unsorted) train without the spikes before
+        finitialize, the events come in time order and at equal times in
+        the order the sources were added, as from one VecStim per source."""
+        from ouropy.gennetwork import BulkSpikePlayer
+        patterns = [[5.0, 1.0, 9.0], [1.0, 5.0], [], [9.0, 2.5, 1.0, 20.0], [-1.0, 5.0]]
+        t, src = self.run_sources(patterns, BulkSpikePlayer())
+        order = sorted((x, k) for k, p in enumerate(patterns) for x in p if x >= 0)
+        np.testing.assert_array_equal(t, [x for x, k in order])
+        np.testing.assert_array_equal(src, [k for x, k in order])
+        ref_t, ref_src = self.run_sources([[x for x in p if x >= 0] for p in patterns], None)
+        for k in range(len(patterns)):
+            np.testing.assert_array_equal(t[src == k], ref_t[ref_src == k])
+
+    def test_one_event_per_step(self):
+        """Spikes of many sources at distinct times take one self event per
+        time step that has spikes, and keep their own times."""
+        from ouropy.gennetwork import BulkSpikePlayer
+        rng = np.random.RandomState(0)
+        steps = [2, 3, 10, 11, 25]
+        patterns = [list(rng.choice(steps) * 0.025 * 40 + rng.uniform(0, 0.0249, size=5)) for k in range(200)]
+        player = BulkSpikePlayer()
+        t, src = self.run_sources(patterns, player)
+        order = sorted((x, k) for k, p in enumerate(patterns) for x in p)
+        np.testing.assert_array_equal(t, [x for x, k in order])
+        self.assertLessEqual(player.player.nwake, len(set(np.floor(t / 0.025 + 0.5))))
+        self.assertLess(player.player.nwake, len(t) / 10)
+
+
+if __name__ == '__main__':
+    unittest.main()
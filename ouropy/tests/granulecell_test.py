@@ -0,0 +1,89 @@
+# -*- coding: utf-8 -*-
+"""
+GranuleCell(fused=True), the channels as the single mechanism gcmem, against
+the separate channel mechanisms, and the fused cells frozen at rest
+(neuron_tools.use_quiescence) against the same cells updated every step.
+"""
+
+import unittest
+
+import numpy as np
+
+from ouropy.tests import mechs
+
+
+@unittest.skipUnless(mechs.load('APCount'), "needs NEURON")
+class TestFused(unittest.TestCase):
+    def run_cells(self):
+        from neuron import h
+        from pydentate.granulecell import GranuleCell
+        try:
+            cells = [GranuleCell(fused=False), GranuleCell(fused=True)]
+        except ValueError:
+            self.skipTest("gcmem is not compiled")
+        h.load_file("stdrun.hoc")
+        stims, recs = [], []
+        for cell in cells:
+            stim = h.IClamp(cell.soma(0.5))
+            stim.delay, stim.dur, stim.amp = 50, 100, 0.2
+            stims.append(stim)
+            recs.append([h.Vector().record(sec(0.5)._ref_v) for sec in cell.all_secs])
+        h.dt = 0.1
+        h.secondorder = 2
+        h.finitialize(-60)
+        h.continuerun(300)
+        return [np.array([np.array(v) for v in rec]) for rec in recs]
+
+    def test_same_traces(self):
+        """The fused cell gives the v of the separate mechanisms to the
+        last bit, in every section, through spikes."""
+        separate, fused = self.run_cells()
+        self.assertGreater((separate[0] > 0).sum(), 0)
+        np.testing.assert_array_equal(fused, separate)
+
+
+
+@unittest.skipUnless(mechs.load('CellQuiet', 'tmgsyn'), "needs NEURON, CellQuiet and tmgsyn")
+class TestQuiescence(unittest.TestCase):
+    def test_same_spikes(self):
+        """Cells frozen while at rest spike as often as the same cells
+        updated every step and within a step of their times, and are frozen
+        for some of the steps."""
+        from neuron import h
+        from pydentate import neuron_tools
+        from pydentate.granulecell import GranuleCell
+        try:
+            lazy = [GranuleCell(fused=True) for x in range(4)]
+            plain = [GranuleCell(fused=True) for x in range(4)]
+        except ValueError:
+            self.skipTest("gcmem is not compiled")
+        h.load_file("stdrun.hoc")
+        keep, spikes = [], []
+        for k, cell in enumerate(lazy + plain):
+            stim = h.NetStim()
+            stim.start, stim.number, stim.interval, stim.noise = 300 + 40 * (k % 4), 4, 15, 0
+            syn = h.tmgsyn(cell.soma(0.5))
+            syn.tau_1, syn.tau_facil, syn.U, syn.tau_rec, syn.e = 5.0, 0, 1.0, 0, 0
+            stim_nc = h.NetCon(stim, syn)
+            stim_nc.weight[0] = 0.05
+            times = h.Vector()
+            ap_nc = h.NetCon(cell.soma(0.5)._ref_v, None, sec=cell.soma)
+            ap_nc.threshold = 0
+            ap_nc.record(times)
+            keep.extend([stim, syn, stim_nc, ap_nc])
+            spikes.append(times)
+        quiets = neuron_tools.use_quiescence(lazy)
+        h.dt = 0.025
+        h.secondorder = 0
+        h.finitialize(-68)
+        h.continuerun(600)
+        skipped, frozen = neuron_tools.quiescence_report(quiets)
+        self.assertGreater(skipped, 0)
+        self.assertGreater(sum(v.size() for v in spikes[4:]), 0)
+        for a, b in zip(spikes[:4], spikes[4:]):
+            self.assertEqual(a.size(), b.size())
+            np.testing.assert_allclose(np.array(a), np.array(b), rtol=0, atol=h.dt)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,59 @@
+# -*- coding: utf-8 -*-
+"""
+ouropy.loadbalance: the greedy partition and the rank assignment from the
+cells described before the network is built.
+"""
+
+import unittest
+
+import numpy as np
+
+from ouropy.tests import mechs
+
+
+class Segment(list):
+    """A segment without mechanisms or point processes."""
+    def point_processes(self):
+        return []
+
+
+class CountedCell(object):
+    """Stands in for a GenNeuron type: one segment, counting how often it
+    is built."""
+    built = 0
+
+    def __init__(self):
+        CountedCell.built += 1
+        self.all_secs = [[Segment()]]
+
+
+@unittest.skipUnless(mechs.h is not None, "needs NEURON")
+class TestLoadBalancer(unittest.TestCase):
+    def test_greedy_partition(self):
+        from ouropy.loadbalance import greedy_partition
+        loads = np.zeros(2)
+        parts = greedy_partition([1, 3, 2, 2], 2, loads)
+        self.assertEqual(list(parts), [0, 0, 1, 1])
+        self.assertEqual(list(loads), [4, 4])
+
+    def test_assign_ranks_builds_no_cells(self):
+        """assign_ranks takes the cost of a type from the cell describe
+        built and builds none itself."""
+        from ouropy.loadbalance import LoadBalancer
+        lb = LoadBalancer()
+        lb.describe([CountedCell])
+        built = CountedCell.built
+        ranks = lb.assign_ranks(CountedCell, np.arange(5), 2)
+        lb.assign_ranks(CountedCell, np.arange(5, 8), 2)
+        self.assertEqual(CountedCell.built, built)
+        self.assertEqual(list(ranks), [0, 1, 0, 1, 0])
+        self.assertEqual(list(lb.predicted), [4, 4])
+
+    def test_undescribed_type(self):
+        from ouropy.loadbalance import LoadBalancer
+        with self.assertRaises(ValueError):
+            LoadBalancer().assign_ranks(CountedCell, np.arange(3), 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
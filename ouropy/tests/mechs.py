@@ -0,0 +1,33 @@
+# -*- coding: utf-8 -*-
+"""
+NEURON and the compiled mechanisms of mechs/ for the tests. The library is
+taken from the environment variable PYDENTATE_MECHS (e.g.
+x86_64/.libs/libnrnmech.so after nrnivmodl mechs), else the precompiled one
+of pydentate. Tests that need a mechanism skip when it is not there.
+"""
+
+import os
+
+try:
+    from neuron import h
+except ImportError:
+    h = None
+
+_loaded = False
+
+
+def load(*names):
+    """True if NEURON is there and has all mechanisms (point processes or
+    hoc functions) in names."""
+    global _loaded
+    if h is None:
+        return False
+    if not _loaded:
+        _loaded = True
+        path = os.environ.get("PYDENTATE_MECHS")
+        if path is None:
+            from pydentate import linux_precompiled
+            path = linux_precompiled
+        if os.path.exists(path):
+            h.nrn_load_dll(path)
+    return all(hasattr(h, name) for name in names)
@@ -0,0 +1,125 @@
+# -*- coding: utf-8 -*-
+"""
+The rest state, the warmup checkpoint key and the threaded run of
+pydentate.neuron_tools.
+"""
+
+import unittest
+
+import numpy as np
+
+from ouropy.tests import mechs
+
+
+@unittest.skipUnless(mechs.load('APCount'), "needs NEURON")
+class TestRestState(unittest.TestCase):
+    def test_other_sections(self):
+        """rest_state deletes its cell and leaves the state of the
+        sections that exist alone."""
+        from neuron import h
+        from ouropy.genneuron import GenNeuron
+        from pydentate import neuron_tools
+
+        class RestCell(GenNeuron):
+            def __init__(self):
+                self.mk_soma(name='soma', diam=20, L=20)
+                self.soma.insert('pas')
+                self.soma.e_pas = -70
+
+        other = h.Section(name='other')
+        h.finitialize(-50)
+        h.t = 3.0
+        n_secs = len(list(h.allsec()))
+        state = neuron_tools.rest_state(RestCell, v_init=-60, dt=10)
+        self.assertIsNotNone(state)
+        self.assertAlmostEqual(state[0][0][0][1], -70, places=3)
+        self.assertEqual(len(list(h.allsec())), n_secs)
+        self.assertEqual(other(0.5).v, -50)
+        self.assertEqual(h.t, 3.0)
+
+
+@unittest.skipUnless(mechs.load('APCount'), "needs NEURON")
+class TestModelDigest(unittest.TestCase):
+    def test_parameter_change(self):
+        """The checkpoint of a model with another parameter value has
+        another name."""
+        from neuron import h
+        from pydentate import neuron_tools
+        sec = h.Section(name='digest')
+        sec.insert('pas')
+        before = neuron_tools.warmup_checkpoint('.', 'key')
+        self.assertEqual(neuron_tools.warmup_checkpoint('.', 'key'), before)
+        sec.g_pas = 2 * sec.g_pas
+        self.assertNotEqual(neuron_tools.warmup_checkpoint('.', 'key'), before)
+
+
+@unittest.skipUnless(mechs.load('NetStim125', 'Gfluct2'), "needs NEURON, NetStim125 and Gfluct2")
+class TestThreads(unittest.TestCase):
+    n_cells = 8
+
+    def tearDown(self):
+        from neuron import h
+        h.ParallelContext().nthread(1)
+
+    def build(self, rng_ids=True):
+        """Cells with hh, Gfluct2 noise and a Poisson NetStim125 input each,
+        and the spike times of every cell."""
+        from neuron import h
+        cells = []
+        for k in range(self.n_cells):
+            soma = h.Section(name='threads_%d' % k)
+            soma.L = soma.diam = 20
+            soma.insert('hh')
+            noise = h.Gfluct2(soma(0.5))
+            noise.rng_id = k
+            stim = h.NetStim125()
+            stim.start, stim.interval, stim.number, stim.forcestop, stim.noise = 5, 5, 40, 1e9, 1
+            if rng_ids:
+                stim.rng_id = k
+            syn = h.ExpSyn(soma(0.5))
+            nc = h.NetCon(stim, syn)
+            nc.weight[0] = 0.02
+            times = h.Vector()
+            detector = h.NetCon(soma(0.5)._ref_v, None, sec=soma)
+            detector.threshold = 0
+            detector.record(times)
+            cells.append((soma, noise, stim, syn, nc, detector, times))
+        return cells
+
+    def run_threads(self, cells, nthread):
+        from neuron import h
+        from pydentate import neuron_tools
+        neuron_tools.use_threads(nthread)
+        h.dt = 0.025
+        h.finitialize(-65)
+        while h.t < 200:
+            h.fadvance()
+        return [np.array(c[-1]) for c in cells]
+
+    def test_same_spikes(self):
+        """With rng_id set the spikes on 1 and on 4 threads are the same."""
+        cells = self.build()
+        one = self.run_threads(cells, 1)
+        four = self.run_threads(cells, 4)
+        self.assertGreater(sum(x.size for x in one), 0)
+        for a, b in zip(one, four):
+            np.testing.assert_array_equal(a, b)
+
+    def test_exprand(self):
+        """Without rng_id NetStim125 draws from exprand as seeded by seed(),
+        on one thread only."""
+        from neuron import h
+        cells = self.build(rng_ids=False)
+        cells[0][2].seed(3)
+        first = self.run_threads(cells, 1)
+        cells[0][2].seed(3)
+        again = self.run_threads(cells, 1)
+        for a, b in zip(first, again):
+            np.testing.assert_array_equal(a, b)
+        with self.assertRaises(RuntimeError):
+            self.run_threads(cells, 2)
+        h.ParallelContext().nthread(1)
+
+
+if __name__ == '__main__':
+    unittest.main()
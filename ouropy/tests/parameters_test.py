@@ -0,0 +1,114 @@
+# -*- coding: utf-8 -*-
+"""
+Parsing of the parameter files once per modification time
+(ouropy.parameters.read_parameters) and the mechanism plans of
+GenNeuron.insert_mechs, with stand-in sections.
+"""
+
+import os
+import shutil
+import tempfile
+import unittest
+
+from ouropy import parameters
+from ouropy.genneuron import GenNeuron
+
+params_path = os.path.join(os.path.dirname(__file__), 'testneuronparams.txt')
+
+
+class FakeSection(object):
+    def __init__(self, name):
+        self._name = name
+        self.inserted = []
+
+    def name(self):
+        return self._name
+
+    def insert(self, mech):
+        self.inserted.append(mech)
+
+
+class FakeNeuron(GenNeuron):
+    def __init__(self, names):
+        self.all_secs = [FakeSection(x) for x in names]
+        self.soma = self.all_secs[0]
+
+
+def reference_insert_mechs(cell, params):
+    """insert_mechs before the plans: all mechanisms per section name, then
+    every parameter in file order."""
+    mechanisms = params.get_mechs()
+    for x in mechanisms.keys():
+        for y in cell.get_segs_by_name(x):
+            for z in mechanisms[x]:
+                y.insert(z)
+    for x in params.param_list:
+        for y in cell.get_segs_by_name(x.sec_name):
+            setattr(y, x.mech_name, x.value)
+
+
+def section_state(cell):
+    return [(sec.name(), sorted(sec.inserted),
+             dict((k, v) for k, v in vars(sec).items() if k not in ('_name', 'inserted')))
+            for sec in cell.all_secs]
+
+
+class TestReadParameters(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, 'params.txt')
+        shutil.copy(params_path, self.path)
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def test_parsed_once(self):
+        first = parameters.read_parameters(self.path)
+        second = parameters.read_parameters(self.path)
+        self.assertIsNot(first, second)
+        self.assertEqual(len(first.param_list), len(second.param_list))
+        for a, b in zip(first.param_list, second.param_list):
+            self.assertIs(a, b)
+        self.assertEqual([x.mech_name for x in first], [x.mech_name for x in second])
+        self.assertIn(os.path.abspath(self.path), parameters.parameter_files())
+
+    def test_modified_file(self):
+        first = parameters.read_parameters(self.path)
+        with open(self.path, 'a') as f:
+            f.write('gkbar_hh\tsoma\t0.04\n')
+        mtime = os.path.getmtime(self.path) + 10
+        os.utime(self.path, (mtime, mtime))
+        second = parameters.read_parameters(self.path)
+        self.assertEqual(len(second.param_list), len(first.param_list) + 1)
+        self.assertEqual(second.param_list[-1].value, 0.04)
+
+
+class TestMechPlan(unittest.TestCase):
+    names = ['soma', 'proxd', 'midd', 'proxd', 'midd']
+
+    def test_same_as_reference(self):
+        params = parameters.read_parameters(params_path)
+        cells = [FakeNeuron(self.names) for i in range(3)]
+        for cell in cells:
+            cell.insert_mechs(params)
+        expected = FakeNeuron(self.names)
+        reference_insert_mechs(expected, params)
+        for cell in cells:
+            self.assertEqual(section_state(cell), section_state(expected))
+
+    def test_plan_per_layout(self):
+        params = parameters.read_parameters(params_path)
+        n_plans = len(GenNeuron._mech_plans)
+        for i in range(3):
+            FakeNeuron(self.names + ['gcl']).insert_mechs(params)
+        self.assertEqual(len(GenNeuron._mech_plans), n_plans + 1)
+        other = FakeNeuron(['soma', 'gcl'])
+        other.insert_mechs(params)
+        self.assertEqual(len(GenNeuron._mech_plans), n_plans + 2)
+        expected = FakeNeuron(['soma', 'gcl'])
+        reference_insert_mechs(expected, params)
+        self.assertEqual(section_state(other), section_state(expected))
+
+
+if __name__ == '__main__':
+    unittest.main()
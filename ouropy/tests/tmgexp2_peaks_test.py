@@ -0,0 +1,174 @@
+# -*- coding: utf-8 -*-
+"""
+pydentate.tmgexp2_peaks: the post-processing of tmgexp2_simulator.simulate
+on the step model of tmgexp2syn, native against numpy mode, and against the
+peaks of simulate() itself: run here on a few rows when NEURON and
+tmgexp2syn are there, and on the grid of a recorded NEURON run
+(synaptic_fitting/tmgexp2_reference.py) when that file is there.
+"""
+
+import math
+import os
+import unittest
+
+import numpy as np
+
+from ouropy.tests import mechs
+from pydentate import tmgexp2_peaks as peaks_module
+from pydentate.tmgexp2_peaks import tmgexp2_peaks
+
+reference_path = os.environ.get("TMGEXP2_REFERENCE", os.path.join(
+    os.path.dirname(__file__), "..", "..", "synaptic_fitting", "tmgexp2_reference.npz"))
+
+
+def step_trace(tau_facil, tau_rec, u0, freq, U=0.04, tau_1=0.3, tau_2=0.6, dt=0.5, start=1000.0, delay=1.0, n_stim=10):
+    """g at every sample of simulate(), one step at a time as NEURON's fixed
+    step run of tmgexp2syn under the clamp."""
+    T = 1000.0 / freq
+    total = 16000.0 / freq + start
+    ev_t = [start + delay + j * T for j in range(n_stim)]
+    ev_k = [math.ceil(te / dt - 0.5 - 1e-9) for te in ev_t]
+    A = B = y = z = tsyn = 0.0
+    u = u0
+    trace = [0.0]
+    t, k, j = 0.0, 0, 0
+    while t < total:
+        t += dt
+        k += 1
+        A *= math.exp(-dt / tau_1)
+        B *= math.exp(-dt / tau_2)
+        if j < n_stim and k == ev_k[j]:
+            h = ev_t[j] - tsyn
+            z = z * math.exp(-h / tau_rec) + y * (math.exp(-h / tau_1) - math.exp(-h / tau_rec)) / (tau_1 / tau_rec - 1)
+            y = y * math.exp(-h / tau_1)
+            x = 1 - y - z
+            if tau_facil > 0:
+                u = u * math.exp(-h / tau_facil)
+                u = u + U * (1 - u)
+            else:
+                u = U
+            g_event = (B - A) + x * u
+            y = y + x * u
+            tsyn = ev_t[j]
+            A += g_event
+            B += g_event
+            j += 1
+        trace.append(B - A)
+    return np.array(trace)
+
+
+def simulate_peaks(gvec, freq, dt=0.5, stim_start=1000, number=10):
+    """The post-processing of tmgexp2_simulator.simulate, from the g trace."""
+    stim_period_ms = 1000 / freq
+    cut = 500
+    start = int(cut / dt)
+    end_cut = (len(gvec) - int(100 / dt))
+    gvec = gvec[start:end_cut]
+    stim_start = stim_start - cut
+    gvec = gvec - (np.average(gvec[0:cut]))
+    stim_start_dtp = int(stim_start / dt)
+    stim_stop_dtp = int(stim_start_dtp + stim_period_ms / dt)
+    sim_first_max = max(gvec[stim_start_dtp:stim_stop_dtp])
+    norm_sim = gvec / sim_first_max
+    period = stim_period_ms / dt
+    first_stim = stim_start / dt
+    last_stim = (stim_start + int(stim_period_ms) * (number + 1)) / dt
+    peaks_idc = np.arange(first_stim, last_stim, period, dtype=int)
+    split_sim = np.array(np.split(norm_sim, peaks_idc)[1:-1])
+    return np.amax(split_sim, axis=1)
+
+
+def neuron_peaks(tau_facil, tau_rec, u0, freq):
+    """The peaks of synaptic_fitting/tmgexp2_simulator.simulate(), whose
+    module loads a fixed mechanism library on import: the same tmgexp2syn
+    on the proximal dendrite of a MossyCell under the SEClamp, run and
+    post-processed the same way."""
+    from neuron import h
+    from pydentate.mossycell_cat import MossyCell
+    dt, stim_start, cut = 0.5, 1000, 500
+    cell = MossyCell()
+    syn = h.tmgexp2syn(cell.dendrites[0].secs[0](0.5))
+    syn.tau_1, syn.tau_2 = 0.3, 0.6
+    syn.tau_facil, syn.tau_rec, syn.u0 = tau_facil, tau_rec, u0
+    stim = h.NetStim()
+    stim.interval, stim.start, stim.number = 1000 / freq, stim_start, 10
+    nc = h.NetCon(stim, syn)
+    nc.weight[0] = 0.001
+    simdur = 16000 / freq
+    clamp = h.SEClamp(cell.soma(0.5))
+    clamp.dur1, clamp.amp1, clamp.rs = simdur + stim_start, -70.42, 0.1
+    i_vec = h.Vector().record(clamp._ref_i)
+    v_vec = h.Vector().record(cell.soma(0.5)._ref_v)
+    h.cvode.active(0)
+    h.dt = dt
+    h.finitialize(-70.42)
+    h.secondorder = 0
+    while h.t < simdur + stim_start:
+        h.fadvance()
+    ivec, vvec = np.array(i_vec), np.array(v_vec)
+    start, end_cut = int(cut / dt), len(ivec) - int(100 / dt)
+    gvec = -np.divide(ivec[start:end_cut], vvec[start:end_cut])
+    gvec = gvec - np.average(gvec[0:cut])
+    period = 1000 / freq / dt
+    first_stim = (stim_start - cut) / dt
+    norm_sim = gvec / max(gvec[int(first_stim):int(first_stim + period)])
+    last_stim = (stim_start - cut + int(1000 / freq) * 11) / dt
+    split_sim = np.array(np.split(norm_sim, np.arange(first_stim, last_stim, period, dtype=int))[1:-1])
+    return np.amax(split_sim, axis=1)
+
+
+grid = [(tau_facil, tau_rec, u0) for tau_facil in (0.0, 50.0, 500.0) for tau_rec in (10.0, 200.0, 2000.0) for u0 in (0.05, 0.3)]
+
+
+class TestTmgexp2Peaks(unittest.TestCase):
+    def test_simulate_postprocessing(self):
+        """numpy mode gives the peaks that simulate() computes from the
+        trace, including its offset (here a constant membrane term), its
+        cut and its windows."""
+        for tau_facil, tau_rec, u0 in grid:
+            for freq in (1, 10, 30, 50):
+                expected = simulate_peaks(step_trace(tau_facil, tau_rec, u0, freq) + 0.3, freq)
+                out = tmgexp2_peaks(tau_facil, tau_rec, u0, freq, mode="numpy")
+                np.testing.assert_allclose(out, expected, rtol=1e-9, atol=1e-12, err_msg=str((tau_facil, tau_rec, u0, freq)))
+
+    @unittest.skipIf(peaks_module._tmgexp2_peaks is None, "pydentate._tmgexp2_peaks is not built")
+    def test_native_numpy(self):
+        rng = np.random.RandomState(0)
+        n = 200
+        tau_facil = np.where(rng.rand(n) < 0.2, 0.0, rng.uniform(0, 10000, n))
+        tau_rec = rng.uniform(1e-3, 5000, n)
+        u0 = rng.uniform(0, 1, n)
+        freq = rng.choice([1, 10, 30, 50], n)
+        native = tmgexp2_peaks(tau_facil, tau_rec, u0, freq, mode="native", nthreads=3)
+        numpy_out = tmgexp2_peaks(tau_facil, tau_rec, u0, freq, mode="numpy")
+        np.testing.assert_allclose(native, numpy_out, rtol=1e-10, atol=1e-12)
+        one = tmgexp2_peaks(tau_facil, tau_rec, u0, freq, mode="native", nthreads=1)
+        np.testing.assert_array_equal(native, one)
+
+    @unittest.skipIf(peaks_module._tmgexp2_peaks is None, "pydentate._tmgexp2_peaks is not built")
+    def test_native_errors(self):
+        with self.assertRaises(ValueError):
+            tmgexp2_peaks(10, 10, 0.1, 10, cut=1500.0, mode="native")
+        with self.assertRaises(ValueError):
+            tmgexp2_peaks(10, 0, 0.1, 10, mode="native")
+
+    @unittest.skipUnless(mechs.load('tmgexp2syn', 'SEClamp'), "needs NEURON and tmgexp2syn")
+    def test_neuron(self):
+        """The peaks of simulate() run now, up to the error of the clamp."""
+        for tau_facil, tau_rec, u0, freq in [(0.0, 200.0, 0.05, 10), (50.0, 2000.0, 0.3, 30), (500.0, 10.0, 0.3, 50)]:
+            expected = neuron_peaks(tau_facil, tau_rec, u0, freq)
+            out = tmgexp2_peaks(tau_facil, tau_rec, u0, freq)
+            np.testing.assert_allclose(out, expected, atol=0.02, err_msg=str((tau_facil, tau_rec, u0, freq)))
+
+    @unittest.skipUnless(os.path.exists(reference_path), "no recorded NEURON reference, see synaptic_fitting/tmgexp2_reference.py")
+    def test_neuron_reference(self):
+        """The peaks of simulate() under NEURON, up to the error of the
+        clamp."""
+        ref = np.load(reference_path)
+        rows = ref["rows"]
+        out = tmgexp2_peaks(rows[:, 0], rows[:, 1], rows[:, 2], rows[:, 3])
+        np.testing.assert_allclose(out, ref["peaks"], atol=0.02)
+
+
+if __name__ == '__main__':
+    unittest.main()
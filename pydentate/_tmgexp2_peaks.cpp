@@ -0,0 +1,180 @@
+// -*- coding: utf-8 -*-
+/*
+_tmgexp2_peaks.cpp
+
+Peak sequence of the tmgexp2syn conductance (mechs/tmgexp2syn.mod) under
+the protocol of synaptic_fitting/tmgexp2_simulator.py: n_stim events at
+start + delay + j*1000/freq, the fixed step run at dt, and per stimulus
+interval the largest g, normalized by the first. Under the voltage clamp of the simulator the conductance does not
+depend on v, so the run reduces to the update NEURON makes per step:
+
+    A *= exp(-dt/tau_1), B *= exp(-dt/tau_2)    nrn_state (cnexp)
+    g = B - A                                    nrn_cur
+
+and the NET_RECEIVE block at the step that delivers an event (the first
+with t + dt/2 >= event time), which adds the g of the last nrn_cur plus the
+increment x*u of the stream to A and B. The weight and the peak
+normalization factor scale all of g and cancel.
+
+The trace is post-processed as simulate() does: it starts at sample
+cut/dt, the mean of its first cut samples is subtracted, and the windows
+are those of np.arange(..., dtype=int), whose step is the difference of the
+first two points cast to int (see pydentate/tmgexp2_peaks.py).
+
+peaks() evaluates rows of (tau_facil, tau_rec, u0, freq) on nthreads
+threads. Built by setup.py, used through pydentate.tmgexp2_peaks.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Protocol {
+    double tau_1, tau_2, U, dt, start, delay, cut;
+    long n_stim;
+    const double* rows;  // n x (tau_facil, tau_rec, u0, freq)
+    double* out;         // n x n_stim
+
+    long event_step(long j, double T) const {
+        return static_cast<long>(std::ceil((start + delay + j * T) / dt - 0.5 - 1e-9));
+    }
+
+    void row(const double* x, double* peaks) const {
+        double tau_facil = x[0], tau_rec = x[1], u = x[2], T = 1000.0 / x[3];
+        double t1 = std::min(std::max(tau_1, tau_2 * 1e-9), 0.9999 * tau_2);
+        double d1 = std::exp(-dt / t1), d2 = std::exp(-dt / tau_2);
+        double A = 0, B = 0, g = 0, y = 0, z = 0, tsyn = 0, offset = 0;
+        // windows of simulate(): w_first + j*w_step from the cut
+        long k_begin = static_cast<long>(cut / dt), n_off = static_cast<long>(cut);
+        double first = (start - cut) / dt;
+        long w_first = k_begin + static_cast<long>(first);
+        long w_step = static_cast<long>(first + T / dt) - static_cast<long>(first);
+        long w_last = w_first + n_stim * w_step;
+        long k_end = std::max(w_last, k_begin + n_off);
+        long j = 0, next = event_step(0, T);
+        std::fill(peaks, peaks + n_stim, -HUGE_VAL);
+        for (long k = k_begin; k < k_end; ++k) {
+            A *= d1;
+            B *= d2;
+            if (j < n_stim && k == next) {
+                double te = start + delay + j * T, h = te - tsyn;
+                z = z * std::exp(-h / tau_rec) + y * (std::exp(-h / t1) - std::exp(-h / tau_rec)) / (t1 / tau_rec - 1);
+                y = y * std::exp(-h / t1);
+                double xr = 1 - y - z;
+                if (tau_facil > 0) {
+                    u = u * std::exp(-h / tau_facil);
+                    u = u + U * (1 - u);
+                } else {
+                    u = U;
+                }
+                g += xr * u;
+                y += xr * u;
+                tsyn = te;
+                A += g;
+                B += g;
+                next = event_step(++j, T);
+            }
+            g = B - A;
+            if (k < k_begin + n_off) {
+                offset += g;
+            }
+            if (k >= w_first && k < w_last) {
+                long w = (k - w_first) / w_step;
+                peaks[w] = std::max(peaks[w], g);
+            }
+        }
+        if (n_off > 0) {
+            offset /= n_off;
+        }
+        for (long i = 0; i < n_stim; ++i) {
+            peaks[i] -= offset;
+        }
+        if (peaks[0] > 0) {
+            for (long i = n_stim - 1; i >= 0; --i) {
+                peaks[i] /= peaks[0];
+            }
+        }
+    }
+
+    void run(long begin, long end) const {
+        for (long i = begin; i < end; ++i) {
+            row(rows + 4 * i, out + n_stim * i);
+        }
+    }
+};
+
+PyObject* peaks(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"rows", "n_stim", "tau_1", "tau_2", "U", "dt", "start", "delay", "cut", "nthreads", nullptr};
+    Py_buffer rows_buf;
+    long n_stim;
+    int nthreads = 0;
+    Protocol p;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*lddddddd|i", const_cast<char**>(keywords), &rows_buf, &n_stim,
+                                     &p.tau_1, &p.tau_2, &p.U, &p.dt, &p.start, &p.delay, &p.cut, &nthreads)) {
+        return nullptr;
+    }
+    long n = static_cast<long>(rows_buf.len / (4 * sizeof(double)));
+    const double* rows = static_cast<const double*>(rows_buf.buf);
+    std::string error;
+    if (rows_buf.len != n * 4 * static_cast<Py_ssize_t>(sizeof(double))) {
+        error = "rows must hold four doubles (tau_facil, tau_rec, u0, freq) per row";
+    } else if (n_stim < 1 || !(p.dt > 0) || !(p.tau_2 > 0) || !(p.cut >= 0 && p.cut <= p.start) || !(p.delay >= 0)) {
+        error = "n_stim, dt and tau_2 must be positive, delay not negative and cut between 0 and start";
+    } else {
+        for (long i = 0; i < n; ++i) {
+            if (!(rows[4 * i + 1] > 0) || !(rows[4 * i + 3] > 0) || 1000.0 / rows[4 * i + 3] <= p.dt) {
+                error = "tau_rec and freq must be positive and the interval longer than dt";
+                break;
+            }
+        }
+    }
+    if (!error.empty()) {
+        PyBuffer_Release(&rows_buf);
+        PyErr_SetString(PyExc_ValueError, error.c_str());
+        return nullptr;
+    }
+
+    std::vector<double> out(n * n_stim);
+    p.n_stim = n_stim;
+    p.rows = rows;
+    p.out = out.data();
+    if (nthreads < 1) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nthreads = static_cast<int>(std::min<long>(nthreads, std::max(1L, n)));
+
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<std::thread> workers;
+    for (int k = 1; k < nthreads; ++k) {
+        workers.emplace_back(&Protocol::run, &p, n * k / nthreads, n * (k + 1) / nthreads);
+    }
+    p.run(0, n / nthreads);
+    for (auto& w : workers) {
+        w.join();
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&rows_buf);
+
+    return PyBytes_FromStringAndSize(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(double));
+}
+
+PyMethodDef methods[] = {
+    {"peaks", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(peaks)), METH_VARARGS | METH_KEYWORDS,
+     "peaks(rows, n_stim, tau_1, tau_2, U, dt, start, delay, cut, nthreads=0)\n\n"
+     "Normalized tmgexp2syn peaks of every row (tau_facil, tau_rec, u0, freq) as bytes of double."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef module = {PyModuleDef_HEAD_INIT, "_tmgexp2_peaks", "tmgexp2syn peak evaluator.", -1, methods, nullptr, nullptr, nullptr, nullptr};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__tmgexp2_peaks(void) {
+    return PyModule_Create(&module);
+}
@@ -11,10 +11,18 @@ import os
 
 class GranuleCell(GenNeuron):
     """Implements the GranuleCell class with logic inherited from
-    ouropy.GenNeuron, a generic neuron class"""
+    ouropy.GenNeuron, a generic neuron class
+
+    With fused=True the channels are inserted as the single gcmem mechanism
+    (mechs/gcmem.mod) instead of ichan2, borgka, nca, lca, cat, gskch, cagk
+    and ccanl, which gives the same results with one state and one current
+    loop per compartment. Populations create their cells without arguments,
+    so set GranuleCell.fused = True before building a network to use it
+    there."""
     name = 'GranuleCell'
+    fused = False
 
-    def __init__(self, name=None):
+    def __init__(self, name=None, fused=None):
         # Make soma
         self.mk_soma(name='soma', diam=16.8, L=16.8)
 
@@ -29,7 +37,12 @@ class GranuleCell(GenNeuron):
                          L=[50.0, 150.0, 150.0, 150.0], soma_loc=1.0)
 
         dirname = os.path.dirname(__file__)
-        filepath = os.path.join(dirname, 'granulecellparams.txt')
+        if fused is None:
+            fused = self.fused
+        if fused:
+            filepath = os.path.join(dirname, 'granulecellparams_fused.txt')
+        else:
+            filepath = os.path.join(dirname, 'granulecellparams.txt')
         parameters = params.read_parameters(filepath)
 
         self.insert_mechs(parameters)
@@ -1,9 +1,19 @@
+import gc
+import hashlib
+import os
 import platform
+import sys
+import time
+import warnings
 
 from neuron import h
 
+from ouropy.genneuron import GenNeuron
+from ouropy.parameters import parameter_files
 from pydentate import linux_precompiled, windows_precompiled
 
+MAX_THREADS = 64
+
 
 def load_compiled_mechanisms(path="precompiled"):
     """Loads precompiled mechanisms in pyDentate unless
@@ -18,26 +28,505 @@ def load_compiled_mechanisms(path="precompiled"):
             h.nrn_load_dll(linux_precompiled)
 
 
-def run_neuron_simulator(warmup=2000, dt_warmup=10, dt_sim=0.1, t_start=0, t_stop=600, v_init=-60):
+def use_batch_kernels(mode=1, mechanisms=("ichan2",)):
+    """Switches the nrn_state/nrn_cur kernels of mechanisms that provide a
+    batch_mode procedure. mode 0 restores the generated scalar kernels,
+    1 uses the SIMD batch kernels and 2 runs both every step and keeps the
+    scalar result, see batch_error_<mech>() and batch_tol_<mech>.
+    Must be called after the mechanisms are loaded."""
+    for mech in mechanisms:
+        getattr(h, "batch_mode_" + mech)(mode)
+
+
+def batch_kernel_errors(mechanisms=("ichan2",)):
+    """Largest deviation between batch and scalar kernels per mechanism
+    since the last use_batch_kernels(2)."""
+    return {mech: getattr(h, "batch_error_" + mech)() for mech in mechanisms}
+
+
+def use_parameter_columns(on=True, mechanisms=("tmgsyn", "tmgexp2syn", "borgka", "ccanl")):
+    """Sets column_layout_<mech> for the mechanisms whose kernels read their
+    parameters and derived constants from a column mirror (see
+    mechs/nrnsoa.h; the states stay in NEURON's rows) or, for borgka, hoist
+    the per-call terms. Takes effect at the next finitialize. ichan2 uses
+    the column mirror as part of its batch kernels, see use_batch_kernels."""
+    for mech in mechanisms:
+        setattr(h, "column_layout_" + mech, int(on))
+
+
+def use_shared_tables(on=True, mechanisms=("ichan2", "nca", "hyperde3", "cat", "lca")):
+    """Switches the rate TABLEs of the listed mechanisms to the voltage grids
+    shared between mechanisms with the same TABLE range (see
+    mechs/vtable.h). Each mechanism keeps the points and the clamping of its
+    own TABLE. Call after the mechanisms are loaded; the grids are filled at
+    the first step."""
+    for mech in mechanisms:
+        getattr(h, "shared_tables_" + mech)(int(on))
+
+
+def use_cvode_mechanisms(on=True):
+    """Makes the cells built from now on use the DERIVATIVE variants of the
+    channels whose fixed step update is written out by hand (ichan2cv,
+    ncacv, hyperde3cv and gskchcv in mechs/, see ouropy.genneuron.GenNeuron.
+    mech_variants), so that they can be integrated by CVode, e.g.
+    run_neuron_simulator(method="lvardt"). Not for GranuleCell(fused=True):
+    gcmem is fixed step only."""
+    variants = {"ichan2": "ichan2cv", "nca": "ncacv", "hyperde3": "hyperde3cv", "gskch": "gskchcv"}
+    GenNeuron.mech_variants = variants if on else {}
+
+
+def use_threads(nthread=1, partitions=None):
+    """Runs the simulation on nthread threads (ParallelContext.nthread).
+    partitions optionally holds one sequence of cells per thread; without it
+    NEURON deals the cells out to the threads itself. All mechanisms in
+    mechs/ are THREADSAFE and draw their random numbers per instance, so
+    the result does not depend on nthread. Call after the network is built
+    and before finitialize; returns the ParallelContext. The per thread
+    state of the mechanisms is sized for at most MAX_THREADS threads
+    (NRNSOA_MAXTHREAD in mechs/nrnsoa.h)."""
+    if nthread > MAX_THREADS:
+        raise ValueError("the mechanisms support at most %d threads" % MAX_THREADS)
+    pc = h.ParallelContext()
+    pc.nthread(nthread)
+    if partitions is not None:
+        for i, cells in enumerate(partitions):
+            roots = h.SectionList()
+            for cell in cells:
+                if cell is not None:
+                    roots.append(sec=h.SectionRef(sec=cell.soma).root)
+            pc.partition(i, roots)
+    return pc
+
+
+def use_ensemble(ensemble, nthread=1, balancer=None):
+    """Orders the cells of the trials of an ouropy.ensemble.Ensemble
+    [cell][trial] in the thread partitions, turns on CVode.cache_efficient
+    so that the node and mechanism data can follow that order, and runs
+    them on nthread threads. Call after the networks are built and
+    before run_neuron_simulator, without its nthread; returns the
+    ParallelContext."""
+    h.cvode.cache_efficient(1)
+    return use_threads(nthread, ensemble.partitions(nthread, balancer))
+
+
+def use_quiescence(cells, tol=1e-6, gtol=1e-9):
+    """Lazy update of cells with the fused granule cell membrane
+    (GranuleCell(fused=True), mechs/gcmem.mod): every cell gets a CellQuiet
+    (mechs/cellquiet.mod) and is frozen while it sits at a fixed point, to
+    tol mV and tol relative for the states, with no synaptic g above gtol.
+    It resumes in the step an event raises a g above gtol. Call after the
+    connections are made, so that their synapses are registered; returns
+    the CellQuiets, see quiescence_report."""
+    quiets = []
+    for cell in cells:
+        if cell is None:
+            continue
+        quiet = h.CellQuiet(cell.soma(0.5))
+        quiet.tol = tol
+        quiet.gtol = gtol
+        n_mem = 0
+        for sec in cell.all_secs:
+            for seg in sec:
+                if h.ismembrane("gcmem", sec=sec):
+                    h.setpointer(quiet._ref_space, "qc", seg.gcmem)
+                    n_mem += 1
+                for pp in seg.point_processes():
+                    if hasattr(pp, "_ref_g"):
+                        quiet.add(pp._ref_g)
+        if n_mem == 0:
+            raise ValueError("use_quiescence: " + str(cell) + " has no gcmem, use GranuleCell(fused=True)")
+        quiets.append(quiet)
+    return quiets
+
+
+def quiescence_report(quiets):
+    """Fraction of the cell-steps since finitialize in which the cells of
+    use_quiescence were frozen, and the number of cells frozen now."""
+    steps = sum(q.steps() for q in quiets)
+    skipped = sum(q.skipped() for q in quiets)
+    return (skipped / steps if steps else 0.0), int(sum(q.frozen() for q in quiets))
+
+
+def warmup_checkpoint(directory, key, warmup=2000, dt_warmup=10, v_init=-60):
+    """Path of the warmup checkpoint in directory for a network described by
+    key (any repr-able value that changes with the network and its
+    parameters, e.g. the seeds and parameter dicts of the run). The warmup
+    settings, celsius, the NEURON build and model_digest() are part of the
+    hash, so a changed parameter file or mechanism gives a new file."""
+    build = (h.nrnversion(), platform.machine(), sys.byteorder)
+    ident = repr((key, warmup, dt_warmup, v_init, h.celsius, build)).encode() + model_digest()
+    return os.path.join(directory, "warmup_" + hashlib.sha1(ident).hexdigest() + ".dat")
+
+
+def model_digest():
+    """sha1 digest of the model as far as it sets the state after the
+    warmup: the names of the loaded mechanism types, the content of the
+    files read by ouropy.parameters.read_parameters, and per section its
+    name, geometry and the PARAMETER values of its mechanisms and point
+    processes, and the weights, delays and thresholds of the NetCons."""
+    sha = hashlib.sha1()
+    sd = h.ref("")
+    for kind in (0, 1):
+        mt = h.MechanismType(kind)
+        for i in range(int(mt.count())):
+            mt.select(i)
+            mt.selected(sd)
+            sha.update(sd[0].encode() + b"\0")
+    for path in parameter_files():
+        with open(path, "rb") as f:
+            sha.update(f.read())
+    for sec in h.allsec():
+        values = [sec.name(), sec.nseg, sec.L, sec.Ra]
+        for seg in sec:
+            values.extend((seg.diam, seg.cm))
+            for mech in seg:
+                values.extend(getattr(seg, name) for name in _mech_param_names(mech.name()))
+            for pp in seg.point_processes():
+                mech = pp.hname().split("[")[0]
+                values.append(mech)
+                values.extend(getattr(pp, name) for name in _mech_param_names(mech))
+        sha.update(repr(values).encode())
+    sha.update(repr([(nc.weight[0], nc.delay, nc.threshold) for nc in h.List("NetCon")]).encode())
+    return sha.digest()
+
+
+def _mech_param_names(name):
+    """Names of the scalar PARAMETER range variables of a mechanism."""
+    if name not in _param_names:
+        ms = h.MechanismStandard(name, 1)
+        sd = h.ref("")
+        _param_names[name] = [sd[0] for i in range(int(ms.count())) if ms.name(sd, i) == 1]
+    return _param_names[name]
+
+
+# ASSIGNED variables that carry state from step to step, which SaveState
+# keeps only for mechanisms with a NET_RECEIVE block.
+_carried = {"Gfluct2": ("g_e1", "g_i1", "nstep")}
+
+
+def _write_carried(f):
+    for mech, names in sorted(_carried.items()):
+        if hasattr(h, mech):
+            vec = h.Vector([getattr(pp, name) for pp in h.List(mech) for name in names])
+            vec.vwrite(f)
+
+
+def _read_carried(f):
+    for mech, names in sorted(_carried.items()):
+        if hasattr(h, mech):
+            vec = h.Vector()
+            vec.vread(f)
+            pps = list(h.List(mech))
+            if len(vec) != len(pps) * len(names):
+                raise RuntimeError("warmup checkpoint: the number of " + mech + " differs")
+            for k, (pp, name) in enumerate((pp, name) for pp in pps for name in names):
+                setattr(pp, name, vec[k])
+
+
+_state_names = {}
+_param_names = {}
+_ion_names = []
+_rest_states = {}
+
+
+def _ions():
+    """Names of the ion mechanisms (na_ion, ca_ion, nca_ion, ...)."""
+    if not _ion_names:
+        mt = h.MechanismType(0)
+        sd = h.ref("")
+        for i in range(int(mt.count())):
+            mt.select(i)
+            mt.selected(sd)
+            if sd[0].endswith("_ion"):
+                _ion_names.append(sd[0])
+    return _ion_names
+
+
+def _mech_state_names(name):
+    """Names of the STATE and ASSIGNED range variables of a density
+    mechanism, all range variables of an ion."""
+    if name not in _state_names:
+        vartypes = (1, 2, 3) if name.endswith("_ion") else (2, 3)
+        names = []
+        for vartype in vartypes:
+            ms = h.MechanismStandard(name, vartype)
+            sd = h.ref("")
+            for i in range(int(ms.count())):
+                if ms.name(sd, i) == 1:
+                    names.append(sd[0])
+        _state_names[name] = names
+    return _state_names[name]
+
+
+def get_cell_state(cell):
+    """v and the mechanism states of every segment of a GenNeuron, one list
+    per section in all_secs order."""
+    state = []
+    for sec in cell.all_secs:
+        sec_state = []
+        ions = [ion for ion in _ions() if h.ismembrane(ion, sec=sec)]
+        for seg in sec:
+            names = ["v"]
+            for mech in seg:
+                names.extend(_mech_state_names(mech.name()))
+            for ion in ions:
+                names.extend(_mech_state_names(ion))
+            sec_state.append([(name, getattr(seg, name)) for name in names])
+        state.append(sec_state)
+    return state
+
+
+def set_cell_state(cell, state):
+    """Sets a state from get_cell_state of a cell of the same type."""
+    for sec, sec_state in zip(cell.all_secs, state):
+        for seg, values in zip(sec, sec_state):
+            for name, value in values:
+                setattr(seg, name, value)
+
+
+def rest_state(cell_type, v_init=-60, dt=10, t_max=10000, tol=1e-6):
+    """Resting state of a cell of cell_type without input: a cell made for
+    this purpose is relaxed from finitialize(v_init) with steps of dt
+    (secondorder 0, as in the warmup) until no value of get_cell_state
+    changes by more than tol (relative, absolute for v) in a step. Returns
+    None if that does not happen by t_max. The result is kept per cell
+    type, v_init and celsius; run_neuron_simulator(steady_state=nw) uses
+    the kept states.
+
+    The cell is deleted afterwards, and a cell_type whose cells outlive
+    their last reference raises RuntimeError. Sections that already exist
+    are simulated along, so their state (SaveState), t, dt and secondorder
+    are restored afterwards; Random streams are not part of that, so
+    finitialize before running them."""
+    key = (cell_type, v_init, h.celsius)
+    if key in _rest_states:
+        return _rest_states[key]
+    n_secs = len(list(h.allsec()))
+    saved = None
+    if n_secs:
+        saved = h.SaveState()
+        saved.save()
+    t, dt_old, secondorder = h.t, h.dt, h.secondorder
+    cell = cell_type()
+    try:
+        h.finitialize(v_init)
+        h.secondorder = 0
+        h.dt = dt
+        state = get_cell_state(cell)
+        result = None
+        while h.t < t_max:
+            h.fadvance()
+            new = get_cell_state(cell)
+            residual = 0.0
+            for sec_old, sec_new in zip(state, new):
+                for seg_old, seg_new in zip(sec_old, sec_new):
+                    for (name, x0), (_, x1) in zip(seg_old, seg_new):
+                        scale = 1.0 if name == "v" else max(abs(x0), 1e-12)
+                        residual = max(residual, abs(x1 - x0) / scale)
+            state = new
+            if residual < tol:
+                result = state
+                break
+    finally:
+        del cell
+        gc.collect()
+        h.t, h.dt, h.secondorder = t, dt_old, secondorder
+    if len(list(h.allsec())) != n_secs:
+        raise RuntimeError("rest_state: the cell of " + cell_type.__name__ + " is not deleted with its last reference")
+    if saved is not None:
+        saved.restore()
+    _rest_states[key] = result
+    return result
+
+
+def init_rest_state(network, v_init=-60, dt_check=10, tol=1e-3, pc=None):
+    """Sets every cell of network to the rest_state of its type after
+    finitialize. Then takes one step of dt_check at a negative time (no
+    events are due) and checks that no v moves by more than tol; the state
+    before the step is restored either way. Returns False, leaving the
+    cells as finitialize set them, if a state is missing or the check
+    fails (on any rank with pc)."""
+    states = [_rest_states.get((pop.cell_type, v_init, h.celsius)) for pop in network.populations]
+    if None in states:
+        warnings.warn("init_rest_state: no rest_state of " + network.populations[states.index(None)].cell_type.__name__ + ", running the warmup")
+        return False
+
+    ss = h.SaveState()
+    ss.save()
+    for pop, state in zip(network.populations, states):
+        for cell in pop.cells:
+            if cell is not None:
+                set_cell_state(cell, state)
+    segs = [seg for sec in h.allsec() for seg in sec]
+    v0 = [seg.v for seg in segs]
+    ss_rest = h.SaveState()
+    ss_rest.save()
+    h.t = -dt_check - 100
+    h.secondorder = 0
+    h.dt = dt_check
+    h.fadvance()
+    residual = max([abs(seg.v - v) for seg, v in zip(segs, v0)] + [0.0])
+    if pc is not None:
+        residual = pc.allreduce(residual, 2)
+    if residual < tol:
+        ss_rest.restore()
+        return True
+    warnings.warn("init_rest_state: v moves by %g mV in %g ms, running the warmup" % (residual, dt_check))
+    ss.restore()
+    return False
+
+
+def advance(t_stop, interval=None, callback=None, progress=False, pc=None):
+    """Advances the simulation from h.t to t_stop like
+    while h.t < t_stop: h.fadvance(), but with the loop in C
+    (advance_until of mechs/runctl.mod), or with pc.psolve for a
+    distributed network, or with CVode's solve when CVode is active. With
+    interval the run stops every interval ms to
+    call callback(h.t), e.g. to write a SaveState checkpoint, and with
+    progress to print how far it is; there are no Python calls per step."""
+    t_begin = h.t
+    start = time.perf_counter()
+    k = 1
+    while h.t < t_stop:
+        t_next = t_stop if interval is None else min(t_stop, t_begin + k * interval)
+        k += 1
+        if pc is not None:
+            pc.psolve(t_next)
+        elif h.cvode.active():
+            h.cvode.solve(t_next)
+        else:
+            h.advance_until(t_next)
+        if callback is not None:
+            callback(h.t)
+        if progress and (pc is None or pc.id() == 0):
+            done = (h.t - t_begin) / (t_stop - t_begin)
+            print("t = %.1f ms (%.0f%%), %.1f s" % (h.t, 100 * done, time.perf_counter() - start), flush=True)
+        if h.stoprun:
+            break
+
+
+def run_neuron_simulator(
+    warmup=2000,
+    dt_warmup=10,
+    dt_sim=0.1,
+    t_start=0,
+    t_stop=600,
+    v_init=-60,
+    checkpoint_dir=None,
+    checkpoint_key=None,
+    pc=None,
+    nthread=None,
+    interval=None,
+    callback=None,
+    progress=False,
+    steady_state=None,
+    method="fixed",
+    atol=None,
+):
+    """Runs the warmup from t = -warmup to -100 with dt_warmup and the
+    simulation from 0 to t_stop with dt_sim.
+
+    With checkpoint_dir and checkpoint_key the state after the warmup
+    (SaveState: voltages, all mechanism states and the event queue) is
+    written to warmup_checkpoint(checkpoint_dir, checkpoint_key, ...) and
+    later runs with the same key restore it instead of running the warmup.
+    The ARTIFICIAL_CELLs (VecStim, SpikePlayer, ...) and the event queue keep
+    what finitialize set up for this run (mechs/artstate.mod), so the inputs
+    may change between runs; restore(1) keeps the event queue of this run
+    for the same reason. This gives the same result as the warmup as long
+    as no input events arrive during it. The ASSIGNED variables that
+    SaveState leaves out but that carry state (the noise of Gfluct2 and
+    its step counter) are written after it. The file is SaveState's binary
+    format and only read back by the same NEURON build, see
+    warmup_checkpoint. It is not a snapshot that could be mapped into
+    memory: a restore reads the whole file into a SaveState and copies it
+    into the model, which is cheap next to the warmup it replaces but grows
+    with the size of the network.
+
+    With the ParallelContext pc of a distributed network (see
+    ouropy.gennetwork.GenNetwork.parallel) the simulation runs with
+    pc.psolve, exchanging spikes every minimum NetCon delay. The warmup is
+    stepped without spike exchange, dt_warmup being longer than any delay,
+    so it assumes that no cell fires during the warmup. The spike times
+    are interpolated within the step (cvode.condition_order(2)), so that
+    events due in the same step reach a synapse in time order and not in
+    the order they were queued, which differs between the ranks' own
+    spikes and those of the exchange; the spikes are then the same on any
+    number of ranks and as those of the serial network run with
+    condition_order(2).
+
+    nthread runs the simulation on that many threads, see use_threads.
+
+    Both phases are stepped in C, see advance; interval, callback and
+    progress apply to the simulation from 0 to t_stop.
+
+    With steady_state, a GenNetwork whose cell types have a rest_state, the
+    cells start from their rest state instead of the warmup (init_rest_state);
+    if that is not possible the warmup runs as usual.
+
+    method "cvode" or "lvardt" runs the simulation (not the warmup) with
+    CVode, with one global or with a local time step per cell, to an
+    absolute tolerance atol (default CVode's); dt_sim is then not used. All
+    mechanisms of the cells must have a CVode interface, see
+    use_cvode_mechanisms."""
+    if method not in ("fixed", "cvode", "lvardt"):
+        raise ValueError("method must be 'fixed', 'cvode' or 'lvardt'")
     h.load_file("stdrun.hoc")
 
     h.cvode.active(0)
     dt = 0.1
     h.steps_per_ms = 1.0 / dt
 
+    if nthread is not None:
+        use_threads(nthread)
+    if pc is not None:
+        h.cvode.condition_order(2)
+        pc.set_maxstep(10)
     h.finitialize(v_init)
 
-    h.t = -warmup
-    h.secondorder = 0
-    h.dt = dt_warmup
-    while h.t < -100:
-        h.fadvance()
+    path = None
+    if checkpoint_dir is not None and checkpoint_key is not None:
+        path = warmup_checkpoint(checkpoint_dir, checkpoint_key, warmup, dt_warmup, v_init)
+        if pc is not None:
+            path = path[:-4] + "_rank%d.dat" % int(pc.id())
+
+    ss = h.SaveState()
+    f = h.File()
+    if steady_state is not None and init_rest_state(steady_state, v_init, dt_warmup, pc=pc):
+        pass
+    elif path is not None and os.path.exists(path):
+        f.ropen(path)
+        h.art_state_save()
+        ss.fread(f)
+        ss.restore(1)
+        h.art_state_restore()
+        _read_carried(f)
+        f.close()
+    else:
+        h.t = -warmup
+        h.secondorder = 0
+        h.dt = dt_warmup
+        h.advance_until(-100)
+        if path is not None:
+            os.makedirs(checkpoint_dir, exist_ok=True)
+            ss.save()
+            tmp = path + ".%d.tmp" % os.getpid()
+            f.wopen(tmp)
+            ss.fwrite(f)
+            _write_carried(f)
+            f.close()
+            os.replace(tmp, path)
 
     h.secondorder = 2
     h.t = 0
     h.dt = dt_sim
+    if method != "fixed":
+        h.cvode.use_local_dt(int(method == "lvardt"))
+        if atol is not None:
+            h.cvode.atol(atol)
+        h.cvode.active(1)
+        h.cvode.re_init()
 
     """Setup run control for -100 to 1500"""
     h.frecord_init()  # Necessary after changing t to restart the vectors
-    while h.t < t_stop:
-        h.fadvance()
+    advance(t_stop, interval, callback, progress, pc)
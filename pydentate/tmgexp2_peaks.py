@@ -0,0 +1,111 @@
+# -*- coding: utf-8 -*-
+"""
+Normalized peak sequence of the tmgexp2syn conductance under the protocol
+of synaptic_fitting/tmgexp2_simulator.py (10 stimuli at freq from 1000 ms,
+NetCon delay 1 ms, fixed step at the sampling interval), without NEURON.
+Under the voltage clamp of the simulator g does not depend on v, and the
+fixed step run of tmgexp2syn reduces to a closed form: A and B decay by
+exp(-dt/tau) per step and an event adds the g of the last step plus x*u to
+both (see pydentate/_tmgexp2_peaks.cpp for the details). The result is the
+largest g per stimulus interval divided by the first, which is what
+simulate()[0] computes from the clamp current, with its post-processing:
+the trace starts at cut (500 ms), its offset (the mean of the first 500
+samples after the cut, zero here unless stimuli fall into them) is
+subtracted, and the intervals are the windows of simulate's
+np.arange(..., dtype=int), which drift behind the stimuli by a fraction of
+a sample per stimulus at 30 Hz. simulate() also drops the last 100 ms,
+which cuts into the last interval above 60 Hz; there simulate() fails on
+the ragged split (numpy >= 1.24), and this evaluator keeps the whole
+interval. The membrane current under the clamp
+is constant and goes with the offset; the error of the clamp itself
+(rs = 0.1 MOhm) is not modelled.
+
+mode="native" uses the C++ evaluator pydentate/_tmgexp2_peaks.cpp (built by
+setup.py) on nthreads threads, mode="numpy" the same update in numpy, one
+row at a time. The default is native when it is built.
+
+    from pydentate.tmgexp2_peaks import tmgexp2_peaks
+    peaks = tmgexp2_peaks(tau_facil, tau_rec, u0, [1, 10, 30, 50])
+"""
+
+import numpy as np
+
+try:
+    from pydentate import _tmgexp2_peaks
+except ImportError:
+    _tmgexp2_peaks = None
+
+
+def _windows(freq, n_stim, dt, start, cut):
+    """First sample of every stimulus interval and the end of the last, as
+    simulate() splits the trace: np.arange(..., dtype=int) takes its step
+    from the first two points, so the windows drift by the fraction of
+    1000/freq/dt per stimulus."""
+    first = (start - cut) / dt
+    w0 = int(first)
+    dw = int(first + 1000.0 / freq / dt) - w0
+    return int(cut / dt) + w0 + dw * np.arange(n_stim + 1)
+
+
+def _row_numpy(tau_facil, tau_rec, u, freq, n_stim, tau_1, tau_2, U, dt, start, delay, cut):
+    T = 1000.0 / freq
+    t1 = min(max(tau_1, tau_2 * 1e-9), 0.9999 * tau_2)
+    d1, d2 = np.exp(-dt / t1), np.exp(-dt / tau_2)
+    windows = _windows(freq, n_stim, dt, start, cut)
+    k_begin, n_off = int(cut / dt), int(cut)
+    k_end = max(windows[-1], k_begin + n_off)
+    events = np.ceil((start + delay + np.arange(n_stim) * T) / dt - 0.5 - 1e-9).astype(int)
+    events = np.append(np.minimum(events, k_end), k_end)
+
+    g_trace = np.zeros(k_end - k_begin)
+    A = B = g = y = z = tsyn = 0.0
+    for j in range(n_stim):
+        te = start + delay + j * T
+        h = te - tsyn
+        z = z * np.exp(-h / tau_rec) + y * (np.exp(-h / t1) - np.exp(-h / tau_rec)) / (t1 / tau_rec - 1)
+        y = y * np.exp(-h / t1)
+        x = 1 - y - z
+        if tau_facil > 0:
+            u = u * np.exp(-h / tau_facil)
+            u = u + U * (1 - u)
+        else:
+            u = U
+        g = g + x * u
+        y = y + x * u
+        tsyn = te
+        A, B = A + g, B + g
+        m = np.arange(events[j + 1] - events[j])
+        seg = B * d2**m - A * d1**m
+        g_trace[events[j] - k_begin : events[j + 1] - k_begin] = seg
+        A, B = A * d1 ** m.size, B * d2 ** m.size
+        g = seg[-1] if seg.size else g
+    offset = g_trace[:n_off].mean() if n_off else 0.0
+    peaks = np.maximum.reduceat(g_trace[windows[0] - k_begin : windows[-1] - k_begin], windows[:-1] - windows[0]) - offset
+    if peaks[0] > 0:
+        peaks = peaks / peaks[0]
+    return peaks
+
+
+def tmgexp2_peaks(tau_facil, tau_rec, u0, freq, n_stim=10, tau_1=0.3, tau_2=0.6, U=0.04, dt=0.5, start=1000.0, delay=1.0, cut=500.0, mode=None, nthreads=0):
+    """Normalized peaks of tmgexp2syn, shape broadcast(tau_facil, tau_rec,
+    u0, freq) + (n_stim,). The defaults are those of tmgexp2_simulator.
+    simulate (GC to MC rise and decay of 0.3 and 0.6 ms, U of tmgexp2syn,
+    sampling 0.5 ms, the trace cut at 500 ms)."""
+    rows = np.broadcast_arrays(*[np.asarray(a, dtype=float) for a in (tau_facil, tau_rec, u0, freq)])
+    shape = rows[0].shape
+    rows = np.ascontiguousarray(np.stack([a.ravel() for a in rows], axis=1))
+    if mode is None:
+        mode = "numpy" if _tmgexp2_peaks is None else "native"
+    if mode == "native":
+        if _tmgexp2_peaks is None:
+            raise ImportError("pydentate._tmgexp2_peaks is not built, run setup.py build_ext --inplace or use mode='numpy'")
+        out = _tmgexp2_peaks.peaks(rows, n_stim, tau_1, tau_2, U, dt, start, delay, cut, nthreads)
+        return np.frombuffer(out, dtype=float).reshape(shape + (n_stim,))
+    if mode != "numpy":
+        raise ValueError("mode must be 'native' or 'numpy'")
+    if np.any(rows[:, 1] <= 0) or np.any(rows[:, 3] <= 0) or np.any(1000.0 / rows[:, 3] <= dt):
+        raise ValueError("tau_rec and freq must be positive and the interval longer than dt")
+    if n_stim < 1 or not dt > 0 or not tau_2 > 0 or not 0 <= cut <= start or not delay >= 0:
+        raise ValueError("n_stim, dt and tau_2 must be positive, delay not negative and cut between 0 and start")
+    out = [_row_numpy(*row, n_stim, tau_1, tau_2, U, dt, start, delay, cut) for row in rows]
+    return np.array(out).reshape(shape + (n_stim,))
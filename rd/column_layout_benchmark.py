@@ -0,0 +1,57 @@
+# -*- coding: utf-8 -*-
+"""
+Times TunedNetwork with the generated mechanism kernels against the
+parameter column kernels (mechs/nrnsoa.h; the states stay in NEURON's rows)
+and the batch kernels, and checks that both give the same spikes. The
+network is built once with the synapse counts of the pattern separation
+paradigm and run once per setting. No results have been recorded yet.
+"""
+
+import argparse
+import time
+
+import numpy as np
+from neuron import h
+
+from pydentate import net_tunedrev, neuron_tools
+from pydentate.inputs import inhom_poiss
+
+pr = argparse.ArgumentParser(description="Column layout benchmark")
+pr.add_argument("-t_stop", type=float, default=600, dest="t_stop")
+pr.add_argument("-seed", type=int, default=10000, dest="seed")
+pr.add_argument("-repeats", type=int, default=1, dest="repeats")
+args = pr.parse_args()
+
+neuron_tools.load_compiled_mechanisms()
+
+np.random.seed(args.seed)
+temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+PP_to_GCs = np.array([np.random.choice(2000, 100, replace=False) for x in range(24)])
+PP_to_BCs = np.random.randint(0, 24, size=(24, 1))
+nw = net_tunedrev.TunedNetwork(args.seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+
+for mech in ["tmgsyn", "tmgexp2syn"]:
+    print("%s instances: %d" % (mech, h.List(mech).count()))
+
+timings = {}
+spikes = {}
+for layout, label in [(False, "rows"), (True, "columns")]:
+    neuron_tools.use_parameter_columns(layout)
+    neuron_tools.use_batch_kernels(int(layout))
+    timings[label] = []
+    for rep in range(args.repeats):
+        start = time.perf_counter()
+        neuron_tools.run_neuron_simulator(t_stop=args.t_stop)
+        timings[label].append(time.perf_counter() - start)
+    spikes[label] = [np.concatenate(p.get_timestamps()) for p in nw.populations]
+
+for label, times in timings.items():
+    print("%s: %.2f s (best of %d)" % (label, min(times), len(times)))
+print("speedup: %.2f" % (min(timings["rows"]) / min(timings["columns"])))
+for pop, a, b in zip(nw.populations, spikes["rows"], spikes["columns"]):
+    # tmgsyn/tmgexp2syn/borgka are bit-identical, the ichan2 batch current
+    # only agrees to rounding
+    if a.size == b.size:
+        print("%s: %d spikes, max shift %g ms" % (pop, a.size, np.abs(np.sort(a) - np.sort(b)).max() if a.size else 0))
+    else:
+        print("%s: %d vs %d spikes" % (pop, a.size, b.size))
@@ -0,0 +1,123 @@
+# -*- coding: utf-8 -*-
+"""
+Throughput of ouropy.ensemble.Ensemble: K runs of the baseline pattern
+separation network (input seeds input_seed + run, as the -runs of
+paradigm_pattern_separation_baseline.py) one after the other, each in its
+own process, against all K in one process and one run. Reports the time and
+the peak resident memory of both, including the network build, whether
+every trial of the ensemble gives the same spikes as its separate run, and
+the node indices of the somata of the K copies of the first cell of each
+population, which are consecutive if the [cell][trial] layout took effect.
+No results of this benchmark have been recorded yet.
+
+    python rd/ensemble_benchmark.py -trials 8 -nthread 1
+"""
+
+import argparse
+import os
+import resource
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+pr = argparse.ArgumentParser(description="Ensemble benchmark")
+pr.add_argument("-trials", type=int, default=8, dest="trials")
+pr.add_argument("-nthread", type=int, default=1, dest="nthread")
+pr.add_argument("-t_stop", type=float, default=600, dest="t_stop")
+pr.add_argument("-network_seed", type=int, default=10000, dest="nw_seed")
+pr.add_argument("-input_seed", type=int, default=10000, dest="input_seed")
+pr.add_argument("-scale", type=int, default=1000, dest="input_scale")
+pr.add_argument("-run", type=str, default=None, dest="run", help=argparse.SUPPRESS)
+pr.add_argument("-out", type=str, default=None, dest="out", help=argparse.SUPPRESS)
+args = pr.parse_args()
+
+
+def make_network(run):
+    import scipy.stats as stats
+
+    from pydentate import net_tunedrev
+    from pydentate.inputs import inhom_poiss
+
+    # inputs as in paradigm_pattern_separation_baseline.py
+    np.random.seed(args.input_seed + run)
+    gauss_gc = stats.norm(loc=1000, scale=args.input_scale)
+    gauss_bc = stats.norm(loc=12, scale=(args.input_scale / 2000.0) * 24)
+    pdf_gc = gauss_gc.pdf(np.arange(2000))
+    pdf_gc = pdf_gc / pdf_gc.sum()
+    pdf_bc = gauss_bc.pdf(np.arange(24))
+    pdf_bc = pdf_bc / pdf_bc.sum()
+    GC_indices = np.arange(2000)
+    start_idc = np.random.randint(0, 1999, size=400)
+    PP_to_GCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((GC_indices[x:2000], GC_indices[0:x]))
+        PP_to_GCs.append(np.random.choice(curr_idc, size=100, replace=False, p=pdf_gc))
+    PP_to_GCs = np.array(PP_to_GCs)[0:24]
+    BC_indices = np.arange(24)
+    start_idc = np.array(((start_idc / 2000.0) * 24), dtype=int)
+    PP_to_BCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((BC_indices[x:24], BC_indices[0:x]))
+        PP_to_BCs.append(np.random.choice(curr_idc, size=1, replace=False, p=pdf_bc))
+    PP_to_BCs = np.array(PP_to_BCs)[0:24]
+    temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+    return net_tunedrev.TunedNetwork(args.nw_seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+
+
+def run_trials(runs, out):
+    from ouropy.ensemble import Ensemble
+    from pydentate import neuron_tools
+
+    neuron_tools.load_compiled_mechanisms()
+    start = time.perf_counter()
+    ens = Ensemble([make_network(run) for run in runs])
+    if len(runs) > 1:
+        neuron_tools.use_ensemble(ens, args.nthread)
+    else:
+        neuron_tools.use_threads(args.nthread)
+    neuron_tools.run_neuron_simulator(t_stop=args.t_stop)
+    elapsed = time.perf_counter() - start
+    # kB on Linux
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    soma_nodes = [[nw.populations[i].cells[0].soma(0.5).node_index() for nw in ens.networks] for i in range(len(ens.networks[0].populations))]
+
+    spikes = {}
+    for run, k in zip(runs, range(len(ens))):
+        for i, ts_pop in enumerate(ens.timestamps(k)):
+            for j, ts in enumerate(ts_pop):
+                spikes["%d_%d_%d" % (run, i, j)] = np.asarray(ts)
+    np.savez(out, elapsed=elapsed, maxrss=maxrss, soma_nodes=soma_nodes, **spikes)
+
+
+if args.run is not None:
+    run_trials([int(x) for x in args.run.split(",")], args.out)
+    sys.exit(0)
+
+
+def run_process(runs, out):
+    cmd = [sys.executable, os.path.abspath(__file__), "-run", ",".join(str(x) for x in runs), "-out", out]
+    cmd += ["-nthread", str(args.nthread), "-t_stop", str(args.t_stop), "-network_seed", str(args.nw_seed)]
+    cmd += ["-input_seed", str(args.input_seed), "-scale", str(args.input_scale)]
+    subprocess.run(cmd, check=True)
+    return np.load(out)
+
+
+runs = list(range(args.trials))
+with tempfile.TemporaryDirectory() as tmp:
+    separate = [run_process([run], os.path.join(tmp, "run_%d.npz" % run)) for run in runs]
+    together = run_process(runs, os.path.join(tmp, "ensemble.npz"))
+
+    t_separate = sum(data["elapsed"] for data in separate)
+    print("%d trials, %d threads: separate %.2f s, ensemble %.2f s (%.2fx)" % (args.trials, args.nthread, t_separate, together["elapsed"], t_separate / together["elapsed"]))
+    rss_separate = max(data["maxrss"] for data in separate)
+    print("peak memory: separate %.1f MB per run, ensemble %.1f MB (%.2f MB per trial)" % (rss_separate / 1024.0, together["maxrss"] / 1024.0, together["maxrss"] / 1024.0 / args.trials))
+    for i, nodes in enumerate(together["soma_nodes"]):
+        print("    population %d, soma nodes of cell 0: %s%s" % (i, list(nodes), "" if np.all(np.diff(nodes) == 1) else " (not consecutive)"))
+    stats = ("elapsed", "maxrss", "soma_nodes")
+    for run, data in zip(runs, separate):
+        same = all(np.array_equal(data[key], together[key]) for key in data.files if key not in stats)
+        n = sum(data[key].size for key in data.files if key not in stats)
+        print("    run %d: %d spikes, %s" % (run, n, "same spikes" if same else "different spikes"))
@@ -0,0 +1,122 @@
+# -*- coding: utf-8 -*-
+"""
+Accuracy of the exp() backends of mechs/nrnexp.h. NRNEXP is fixed when the
+mechanisms are compiled, so every backend is its own compiled mechanism
+library, e.g.
+
+    nrnivmodl -incflags "-DNRNEXP=2 -fno-trapping-math" mechs
+
+in a separate directory per backend. Each library is loaded in a subprocess
+that evaluates exp_eval() on a grid and runs the baseline pattern separation
+network (run 0 of paradigm_pattern_separation_baseline.py). The first library
+is the reference; for the others the script reports the largest relative
+error of exp against the reference, the run time, and per population the
+spike counts and the largest spike time shift in cells with the same number
+of spikes.
+
+    python rd/exp_backend_accuracy.py -mechs x86_64_hoc/.libs/libnrnmech.so x86_64_poly/.libs/libnrnmech.so
+
+No results of this script have been recorded yet; until they are, the
+network level accuracy of backends 1-3 is unknown.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+pr = argparse.ArgumentParser(description="exp backend accuracy")
+pr.add_argument("-mechs", nargs="+", type=str, help="compiled mechanism libraries, the first is the reference", dest="mechs")
+pr.add_argument("-t_stop", type=float, default=600, dest="t_stop")
+pr.add_argument("-seed", type=int, default=10000, dest="seed")
+pr.add_argument("-scale", type=int, default=1000, dest="input_scale")
+pr.add_argument("-run", type=str, default=None, dest="run", help=argparse.SUPPRESS)
+pr.add_argument("-out", type=str, default=None, dest="out", help=argparse.SUPPRESS)
+args = pr.parse_args()
+
+exp_grid = np.concatenate((np.linspace(-700, 700, 200001), np.linspace(-2, 2, 20001)))
+
+
+def run_backend(mech_path, out):
+    import scipy.stats as stats
+    from neuron import h
+
+    from pydentate import net_tunedrev, neuron_tools
+    from pydentate.inputs import inhom_poiss
+
+    neuron_tools.load_compiled_mechanisms(path=mech_path)
+    exp_values = np.array([h.exp_eval(x) for x in exp_grid])
+
+    # inputs as in run 0 of paradigm_pattern_separation_baseline.py
+    np.random.seed(args.seed)
+    gauss_gc = stats.norm(loc=1000, scale=args.input_scale)
+    gauss_bc = stats.norm(loc=12, scale=(args.input_scale / 2000.0) * 24)
+    pdf_gc = gauss_gc.pdf(np.arange(2000))
+    pdf_gc = pdf_gc / pdf_gc.sum()
+    pdf_bc = gauss_bc.pdf(np.arange(24))
+    pdf_bc = pdf_bc / pdf_bc.sum()
+    GC_indices = np.arange(2000)
+    start_idc = np.random.randint(0, 1999, size=400)
+    PP_to_GCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((GC_indices[x:2000], GC_indices[0:x]))
+        PP_to_GCs.append(np.random.choice(curr_idc, size=100, replace=False, p=pdf_gc))
+    PP_to_GCs = np.array(PP_to_GCs)[0:24]
+    BC_indices = np.arange(24)
+    start_idc = np.array(((start_idc / 2000.0) * 24), dtype=int)
+    PP_to_BCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((BC_indices[x:24], BC_indices[0:x]))
+        PP_to_BCs.append(np.random.choice(curr_idc, size=1, replace=False, p=pdf_bc))
+    PP_to_BCs = np.array(PP_to_BCs)[0:24]
+    temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+
+    nw = net_tunedrev.TunedNetwork(args.seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+    start = time.perf_counter()
+    neuron_tools.run_neuron_simulator(t_stop=args.t_stop)
+    elapsed = time.perf_counter() - start
+
+    spikes = {}
+    for i, pop in enumerate(nw.populations):
+        for j, ts in enumerate(pop.get_timestamps()):
+            spikes["%d_%d" % (i, j)] = np.asarray(ts)
+    np.savez(out, backend=h.exp_backend(), exp_values=exp_values, elapsed=elapsed, populations=[str(p) for p in nw.populations], **spikes)
+
+
+def load(out):
+    data = np.load(out)
+    cells = {}
+    for key in data.files:
+        if key[0].isdigit():
+            i, j = map(int, key.split("_"))
+            cells.setdefault(i, {})[j] = data[key]
+    return data, cells
+
+
+if args.run is not None:
+    run_backend(args.run, args.out)
+    sys.exit(0)
+
+results = []
+with tempfile.TemporaryDirectory() as tmp:
+    for k, mech_path in enumerate(args.mechs):
+        out = os.path.join(tmp, "backend_%d.npz" % k)
+        cmd = [sys.executable, os.path.abspath(__file__), "-run", mech_path, "-out", out, "-t_stop", str(args.t_stop), "-seed", str(args.seed), "-scale", str(args.input_scale)]
+        subprocess.run(cmd, check=True)
+        results.append(load(out))
+
+ref, ref_cells = results[0]
+print("reference: %s, backend %d, %.2f s" % (args.mechs[0], ref["backend"], ref["elapsed"]))
+for mech_path, (data, cells) in zip(args.mechs[1:], results[1:]):
+    rel_err = np.abs(data["exp_values"] - ref["exp_values"]) / np.where(ref["exp_values"] > 0, ref["exp_values"], 1)
+    print("%s: backend %d, %.2f s (%.2fx), max rel exp error %g" % (mech_path, data["backend"], data["elapsed"], ref["elapsed"] / data["elapsed"], rel_err.max()))
+    for i, pop in enumerate(data["populations"]):
+        n_ref = sum(ts.size for ts in ref_cells[i].values())
+        n = sum(ts.size for ts in cells[i].values())
+        changed = [j for j in cells[i] if cells[i][j].size != ref_cells[i][j].size]
+        shifts = [np.abs(cells[i][j] - ref_cells[i][j]).max() for j in cells[i] if cells[i][j].size == ref_cells[i][j].size and cells[i][j].size]
+        print("    %s: %d vs %d spikes, %d cells with a different count, max shift %g ms" % (pop, n, n_ref, len(changed), max(shifts) if shifts else 0))
@@ -0,0 +1,117 @@
+# -*- coding: utf-8 -*-
+"""
+Spike time accuracy and run time of the local variable time step against the
+fixed step. Every run is a subprocess that builds the baseline pattern
+separation network (run 0 of paradigm_pattern_separation_baseline.py) with
+the CVode variants of the channels (neuron_tools.use_cvode_mechanisms) and
+runs it with run_neuron_simulator(method=...). The first run is the
+reference, by default the fixed step at dt = 0.1 ms; for the others the
+script reports the run time and per population the spike counts and the
+largest spike time shift in cells with the same number of spikes.
+
+    python rd/lvardt_accuracy.py -runs fixed:0.1 fixed:0.025 lvardt:1e-2 lvardt:1e-3 lvardt:1e-4
+
+A run is fixed:<dt>, cvode:<atol> or lvardt:<atol>.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+pr = argparse.ArgumentParser(description="lvardt accuracy")
+pr.add_argument("-runs", nargs="+", type=str, default=["fixed:0.1", "fixed:0.025", "lvardt:1e-2", "lvardt:1e-3", "lvardt:1e-4"], help="the first is the reference", dest="runs")
+pr.add_argument("-t_stop", type=float, default=600, dest="t_stop")
+pr.add_argument("-seed", type=int, default=10000, dest="seed")
+pr.add_argument("-scale", type=int, default=1000, dest="input_scale")
+pr.add_argument("-run", type=str, default=None, dest="run", help=argparse.SUPPRESS)
+pr.add_argument("-out", type=str, default=None, dest="out", help=argparse.SUPPRESS)
+args = pr.parse_args()
+
+
+def run_method(run, out):
+    import scipy.stats as stats
+    from neuron import h
+
+    from pydentate import net_tunedrev, neuron_tools
+    from pydentate.inputs import inhom_poiss
+
+    method, value = run.split(":")
+    neuron_tools.load_compiled_mechanisms()
+    neuron_tools.use_cvode_mechanisms()
+
+    # inputs as in run 0 of paradigm_pattern_separation_baseline.py
+    np.random.seed(args.seed)
+    gauss_gc = stats.norm(loc=1000, scale=args.input_scale)
+    gauss_bc = stats.norm(loc=12, scale=(args.input_scale / 2000.0) * 24)
+    pdf_gc = gauss_gc.pdf(np.arange(2000))
+    pdf_gc = pdf_gc / pdf_gc.sum()
+    pdf_bc = gauss_bc.pdf(np.arange(24))
+    pdf_bc = pdf_bc / pdf_bc.sum()
+    GC_indices = np.arange(2000)
+    start_idc = np.random.randint(0, 1999, size=400)
+    PP_to_GCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((GC_indices[x:2000], GC_indices[0:x]))
+        PP_to_GCs.append(np.random.choice(curr_idc, size=100, replace=False, p=pdf_gc))
+    PP_to_GCs = np.array(PP_to_GCs)[0:24]
+    BC_indices = np.arange(24)
+    start_idc = np.array(((start_idc / 2000.0) * 24), dtype=int)
+    PP_to_BCs = []
+    for x in start_idc:
+        curr_idc = np.concatenate((BC_indices[x:24], BC_indices[0:x]))
+        PP_to_BCs.append(np.random.choice(curr_idc, size=1, replace=False, p=pdf_bc))
+    PP_to_BCs = np.array(PP_to_BCs)[0:24]
+    temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+
+    nw = net_tunedrev.TunedNetwork(args.seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+    start = time.perf_counter()
+    if method == "fixed":
+        neuron_tools.run_neuron_simulator(t_stop=args.t_stop, dt_sim=float(value))
+    else:
+        neuron_tools.run_neuron_simulator(t_stop=args.t_stop, method=method, atol=float(value))
+    elapsed = time.perf_counter() - start
+
+    spikes = {}
+    for i, pop in enumerate(nw.populations):
+        for j, ts in enumerate(pop.get_timestamps()):
+            spikes["%d_%d" % (i, j)] = np.asarray(ts)
+    np.savez(out, elapsed=elapsed, populations=[str(p) for p in nw.populations], **spikes)
+
+
+def load(out):
+    data = np.load(out)
+    cells = {}
+    for key in data.files:
+        if key[0].isdigit():
+            i, j = map(int, key.split("_"))
+            cells.setdefault(i, {})[j] = data[key]
+    return data, cells
+
+
+if args.run is not None:
+    run_method(args.run, args.out)
+    sys.exit(0)
+
+results = []
+with tempfile.TemporaryDirectory() as tmp:
+    for k, run in enumerate(args.runs):
+        out = os.path.join(tmp, "run_%d.npz" % k)
+        cmd = [sys.executable, os.path.abspath(__file__), "-run", run, "-out", out, "-t_stop", str(args.t_stop), "-seed", str(args.seed), "-scale", str(args.input_scale)]
+        subprocess.run(cmd, check=True)
+        results.append(load(out))
+
+ref, ref_cells = results[0]
+print("reference: %s, %.2f s" % (args.runs[0], ref["elapsed"]))
+for run, (data, cells) in zip(args.runs[1:], results[1:]):
+    print("%s: %.2f s (%.2fx)" % (run, data["elapsed"], ref["elapsed"] / data["elapsed"]))
+    for i, pop in enumerate(data["populations"]):
+        n_ref = sum(ts.size for ts in ref_cells[i].values())
+        n = sum(ts.size for ts in cells[i].values())
+        changed = [j for j in cells[i] if cells[i][j].size != ref_cells[i][j].size]
+        shifts = [np.abs(cells[i][j] - ref_cells[i][j]).max() for j in cells[i] if cells[i][j].size == ref_cells[i][j].size and cells[i][j].size]
+        print("    %s: %d vs %d spikes, %d cells with a different count, max shift %g ms" % (pop, n, n_ref, len(changed), max(shifts) if shifts else 0))
@@ -0,0 +1,145 @@
+# -*- coding: utf-8 -*-
+"""
+Runs TunedNetwork with the opt-in modes of the mechanisms in mechs/ and
+compares each with the default. Every run is a subprocess that builds the
+network with the inputs of rd/column_layout_benchmark.py, runs it with
+run_neuron_simulator and samples the somatic v of the first cells of every
+population every -sample ms. The first run is the reference; for the others
+the script reports the run time and per population the spike counts, the
+number of cells with a different count, the largest spike time shift in the
+others and the largest difference of the sampled v.
+
+    python rd/mechs_equivalence.py -runs default fused
+
+A run is one of
+    default     the generated mechanisms as they are
+    fused       GranuleCell.fused = True, the granule cell channels as the
+                single mechanism gcmem (mechs/gcmem.mod)
+    shared_tables
+                use_shared_tables(), the rate tables of ichan2, nca,
+                hyperde3, cat and lca on the shared voltage grids
+    ccanl_columns
+                use_parameter_columns(mechanisms=("ccanl",)), the
+                parameter column update of the ccanl calcium pools
+    threads:<n> run_neuron_simulator(nthread=n)
+    quiescent   fused, with the granule cells frozen while they are at rest
+                (use_quiescence); compare with fused. The run prints the
+                fraction of the cell-steps that were skipped
+    cvode_mechs use_cvode_mechanisms(), the DERIVATIVE variants of the
+                hand-integrated channels, at the fixed step
+    cvode:<atol>, lvardt:<atol>
+                cvode_mechs, run with run_neuron_simulator(method=...,
+                atol=atol); rd/lvardt_accuracy.py compares these on the
+                pattern separation network
+
+A run may end in @<library> to load the mechanisms from that library
+instead of the precompiled ones, e.g. to compare the cnexp pools of ccanl
+with the derivimplicit ones of a build of an older mechs/:
+
+    python rd/mechs_equivalence.py -runs default@/path/to/old/libnrnmech.so default
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+MODES = ["default", "fused", "shared_tables", "ccanl_columns", "threads", "quiescent", "cvode_mechs", "cvode", "lvardt"]
+
+pr = argparse.ArgumentParser(description="Equivalence of the mechanism modes")
+pr.add_argument("-runs", nargs="+", type=str, default=["default", "fused", "shared_tables", "ccanl_columns", "threads:4", "cvode_mechs", "lvardt:1e-3"], help="the first is the reference", dest="runs")
+pr.add_argument("-t_stop", type=float, default=300, dest="t_stop")
+pr.add_argument("-seed", type=int, default=10000, dest="seed")
+pr.add_argument("-n_v", type=int, default=10, help="cells per population whose v is sampled", dest="n_v")
+pr.add_argument("-sample", type=float, default=1.0, help="sampling interval of v (ms)", dest="sample")
+pr.add_argument("-run", type=str, default=None, dest="run", help=argparse.SUPPRESS)
+pr.add_argument("-out", type=str, default=None, dest="out", help=argparse.SUPPRESS)
+args = pr.parse_args()
+
+
+def run_mode(run, out):
+    from pydentate import net_tunedrev, neuron_tools
+    from pydentate.granulecell import GranuleCell
+    from pydentate.inputs import inhom_poiss
+
+    mode, _, library = run.partition("@")
+    mode, _, value = mode.partition(":")
+    if mode not in MODES:
+        raise ValueError("unknown run " + run)
+    neuron_tools.load_compiled_mechanisms(library or "precompiled")
+    GranuleCell.fused = mode in ("fused", "quiescent")
+    if mode == "shared_tables":
+        neuron_tools.use_shared_tables()
+    neuron_tools.use_cvode_mechanisms(mode in ("cvode_mechs", "cvode", "lvardt"))
+
+    np.random.seed(args.seed)
+    temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+    PP_to_GCs = np.array([np.random.choice(2000, 100, replace=False) for x in range(24)])
+    PP_to_BCs = np.random.randint(0, 24, size=(24, 1))
+    nw = net_tunedrev.TunedNetwork(args.seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+    run_kwargs = {}
+    if mode == "ccanl_columns":
+        neuron_tools.use_parameter_columns(mechanisms=("ccanl",))
+    if mode == "threads":
+        run_kwargs["nthread"] = int(value)
+    if mode in ("cvode", "lvardt"):
+        run_kwargs.update(method=mode, atol=float(value))
+    quiets = neuron_tools.use_quiescence(nw.populations[0].cells) if mode == "quiescent" else []
+
+    probes = [cell.soma(0.5) for pop in nw.populations for cell in pop.cells[: args.n_v]]
+    samples = []
+    start = time.perf_counter()
+    neuron_tools.run_neuron_simulator(t_stop=args.t_stop, interval=args.sample, callback=lambda t: samples.append([seg.v for seg in probes]), **run_kwargs)
+    elapsed = time.perf_counter() - start
+    if quiets:
+        skipped, frozen = neuron_tools.quiescence_report(quiets)
+        print("%s: %.1f%% of the granule cell steps skipped, %d cells frozen at the end" % (run, 100 * skipped, frozen))
+
+    spikes = {}
+    for i, pop in enumerate(nw.populations):
+        for j, ts in enumerate(pop.get_timestamps()):
+            spikes["%d_%d" % (i, j)] = np.asarray(ts)
+    n_probes = [min(args.n_v, len(pop.cells)) for pop in nw.populations]
+    np.savez(out, elapsed=elapsed, populations=[str(p) for p in nw.populations], n_probes=n_probes, v=np.array(samples), **spikes)
+
+
+def load(out):
+    data = np.load(out)
+    cells = {}
+    for key in data.files:
+        if key[0].isdigit():
+            i, j = map(int, key.split("_"))
+            cells.setdefault(i, {})[j] = data[key]
+    return data, cells
+
+
+if args.run is not None:
+    run_mode(args.run, args.out)
+    sys.exit(0)
+
+results = []
+with tempfile.TemporaryDirectory() as tmp:
+    for k, run in enumerate(args.runs):
+        out = os.path.join(tmp, "run_%d.npz" % k)
+        cmd = [sys.executable, os.path.abspath(__file__), "-run", run, "-out", out, "-t_stop", str(args.t_stop), "-seed", str(args.seed), "-n_v", str(args.n_v), "-sample", str(args.sample)]
+        subprocess.run(cmd, check=True)
+        results.append(load(out))
+
+ref, ref_cells = results[0]
+ref_bounds = np.cumsum(np.append(0, ref["n_probes"]))
+print("reference: %s, %.2f s" % (args.runs[0], ref["elapsed"]))
+for run, (data, cells) in zip(args.runs[1:], results[1:]):
+    print("%s: %.2f s (%.2fx)" % (run, data["elapsed"], ref["elapsed"] / data["elapsed"]))
+    n = min(len(data["v"]), len(ref["v"]))
+    for i, pop in enumerate(data["populations"]):
+        n_ref = sum(ts.size for ts in ref_cells[i].values())
+        n_run = sum(ts.size for ts in cells[i].values())
+        changed = [j for j in cells[i] if cells[i][j].size != ref_cells[i][j].size]
+        shifts = [np.abs(cells[i][j] - ref_cells[i][j]).max() for j in cells[i] if cells[i][j].size == ref_cells[i][j].size and cells[i][j].size]
+        a, b = ref_bounds[i], ref_bounds[i + 1]
+        dv = np.abs(data["v"][:n, a:b] - ref["v"][:n, a:b]).max() if n and b > a else 0
+        print("    %s: %d vs %d spikes, %d cells with a different count, max shift %g ms, max dv %g mV" % (pop, n_run, n_ref, len(changed), max(shifts) if shifts else 0, dv))
@@ -0,0 +1,130 @@
+# -*- coding: utf-8 -*-
+"""
+Spikes of the distributed TunedNetwork (ouropy.gennetwork.GenNetwork.parallel)
+against the serial build. Runs the baseline pattern separation network (run 0
+of paradigm_pattern_separation_baseline.py) and writes the spike times of all
+cells to -out:
+
+    python rd/parallel_equivalence.py -serial -out serial.npz
+    mpirun -n 8 python rd/parallel_equivalence.py -out parallel.npz
+    python rd/parallel_equivalence.py -compare serial.npz parallel.npz
+
+-balance assigns the ranks with ouropy.loadbalance (calibrated per cell
+type) instead of round robin and prints the predicted and achieved load of
+every rank. -compare reports per population the spike counts, the cells with a
+different number of spikes and the largest spike time difference.
+
+Events due at the same time are delivered in the order they were queued.
+The serial run queues them as the detectors fire, the distributed run
+queues the spikes of other ranks at the exchange, so with spike times on
+the step grid the order differs at a synapse that gets several spikes in
+one step; tmgsyn depends on that order. Both runs therefore interpolate
+the spike times within the step (cvode.condition_order(2), which
+run_neuron_simulator sets for a distributed run), which makes the events
+of different cells distinct in time and the delivery order the time order
+on any number of ranks. -step_times keeps the spike times of the serial
+run on the grid, as the serial simulations of the paradigms do; the
+comparison then only holds up to the order of coinciding events.
+"""
+
+import argparse
+import time
+
+import numpy as np
+
+pr = argparse.ArgumentParser(description="distributed vs serial network")
+pr.add_argument("-serial", action="store_true", dest="serial")
+pr.add_argument("-out", type=str, default="spikes.npz", dest="out")
+pr.add_argument("-balance", action="store_true", dest="balance")
+pr.add_argument("-compare", nargs=2, type=str, default=None, dest="compare")
+pr.add_argument("-t_stop", type=float, default=600, dest="t_stop")
+pr.add_argument("-seed", type=int, default=10000, dest="seed")
+pr.add_argument("-scale", type=int, default=1000, dest="input_scale")
+pr.add_argument("-step_times", action="store_true", help="spike times on the step grid (serial run)", dest="step_times")
+args = pr.parse_args()
+
+
+def load(path):
+    data = np.load(path)
+    cells = {}
+    for key in data.files:
+        if key[0].isdigit():
+            i, j = map(int, key.split("_"))
+            cells.setdefault(i, {})[j] = data[key]
+    return data, cells
+
+
+if args.compare is not None:
+    (ref, ref_cells), (data, cells) = load(args.compare[0]), load(args.compare[1])
+    print("%s: %.2f s on %d ranks, %s: %.2f s on %d ranks" % (args.compare[0], ref["elapsed"], ref["nhost"], args.compare[1], data["elapsed"], data["nhost"]))
+    orders = [int(d["condition_order"]) if "condition_order" in d.files else 1 for d in (ref, data)]
+    if orders[0] != orders[1]:
+        print("    the runs differ in condition_order (%d vs %d)" % tuple(orders))
+    for i, pop in enumerate(ref["populations"]):
+        n_ref = sum(ts.size for ts in ref_cells[i].values())
+        n = sum(ts.size for ts in cells[i].values())
+        changed = [j for j in cells[i] if cells[i][j].size != ref_cells[i][j].size]
+        shifts = [np.abs(cells[i][j] - ref_cells[i][j]).max() for j in cells[i] if cells[i][j].size == ref_cells[i][j].size and cells[i][j].size]
+        print("    %s: %d vs %d spikes, %d cells with a different count, max shift %g ms" % (pop, n, n_ref, len(changed), max(shifts) if shifts else 0))
+    raise SystemExit(0)
+
+import scipy.stats as stats
+from neuron import h
+
+from ouropy import gennetwork, loadbalance
+from pydentate import net_tunedrev, neuron_tools
+from pydentate.inputs import inhom_poiss
+
+gennetwork.GenNetwork.parallel = not args.serial
+pc = gennetwork.parallel_context()
+neuron_tools.load_compiled_mechanisms()
+if args.balance and pc is not None:
+    lb = loadbalance.LoadBalancer()
+    lb.calibrate([net_tunedrev.GranuleCell, net_tunedrev.MossyCell, net_tunedrev.BasketCell, net_tunedrev.HippCell], pc=pc)
+    gennetwork.GenNetwork.assign_ranks = lb.assign_ranks
+
+# inputs as in run 0 of paradigm_pattern_separation_baseline.py
+np.random.seed(args.seed)
+gauss_gc = stats.norm(loc=1000, scale=args.input_scale)
+gauss_bc = stats.norm(loc=12, scale=(args.input_scale / 2000.0) * 24)
+pdf_gc = gauss_gc.pdf(np.arange(2000))
+pdf_gc = pdf_gc / pdf_gc.sum()
+pdf_bc = gauss_bc.pdf(np.arange(24))
+pdf_bc = pdf_bc / pdf_bc.sum()
+GC_indices = np.arange(2000)
+start_idc = np.random.randint(0, 1999, size=400)
+PP_to_GCs = []
+for x in start_idc:
+    curr_idc = np.concatenate((GC_indices[x:2000], GC_indices[0:x]))
+    PP_to_GCs.append(np.random.choice(curr_idc, size=100, replace=False, p=pdf_gc))
+PP_to_GCs = np.array(PP_to_GCs)[0:24]
+BC_indices = np.arange(24)
+start_idc = np.array(((start_idc / 2000.0) * 24), dtype=int)
+PP_to_BCs = []
+for x in start_idc:
+    curr_idc = np.concatenate((BC_indices[x:24], BC_indices[0:x]))
+    PP_to_BCs.append(np.random.choice(curr_idc, size=1, replace=False, p=pdf_bc))
+PP_to_BCs = np.array(PP_to_BCs)[0:24]
+temporal_patterns = inhom_poiss(modulation_rate=10, n_cells=24)
+
+nw = net_tunedrev.TunedNetwork(args.seed, temporal_patterns, PP_to_GCs, PP_to_BCs)
+h.cvode.condition_order(1 if args.step_times else 2)
+start = time.perf_counter()
+neuron_tools.run_neuron_simulator(t_stop=args.t_stop, pc=pc)
+elapsed = time.perf_counter() - start
+condition_order = int(h.cvode.condition_order())
+if args.balance and pc is not None:
+    achieved = lb.achieved_ranks(pc)
+    if pc.id() == 0:
+        print(lb.report(lb.predicted, achieved))
+
+spikes = {}
+for i, pop in enumerate(nw.populations):
+    for j, ts in enumerate(pop.get_timestamps()):
+        spikes["%d_%d" % (i, j)] = np.asarray(ts)
+if pc is None or pc.id() == 0:
+    nhost = 1 if pc is None else int(pc.nhost())
+    np.savez(args.out, elapsed=elapsed, nhost=nhost, condition_order=condition_order, populations=[str(p) for p in nw.populations], **spikes)
+if pc is not None:
+    pc.barrier()
+    pc.done()
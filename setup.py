@@ -1,4 +1,4 @@
-from setuptools import setup
+from setuptools import Extension, setup
 
 
 with open('README.md') as f:
@@ -17,6 +17,15 @@ setup(
     url='https://github.com/danielmk/pydentate',
     license=license,
     packages=['ouropy', 'pydentate'],
+    # C++ ring connectivity builder (ouropy.connectivity, mode="native")
+    # and tmgexp2syn peak evaluator (pydentate.tmgexp2_peaks); the package
+    # works without them
+    ext_modules=[Extension('ouropy._ringconn', ['ouropy/_ringconn.cpp'],
+                           extra_compile_args=['-std=c++11'],
+                           optional=True),
+                 Extension('pydentate._tmgexp2_peaks', ['pydentate/_tmgexp2_peaks.cpp'],
+                           extra_compile_args=['-std=c++11'],
+                           optional=True)],
     install_requires=[
           'elephant',
           'numpy',
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# PEP8
+"""
+tmgexp2_optimizer.py without NEURON: the same loss (mean over 1, 10, 30 and
+50 Hz of the mean square error of the normalized peaks), with the peaks
+from the closed form evaluator pydentate.tmgexp2_peaks instead of
+tmgexp2_simulator.simulate. Differential evolution evaluates its whole
+population in one call of the evaluator, which runs on all cores when
+pydentate._tmgexp2_peaks is built (pip install -e .), and Nelder-Mead from
+the best member polishes the result as in tmgexp2_optimizer.py.
+
+    python tmgexp2_fast_optimizer.py -data /path/to/gc_to_mc/ -out gc_to_mc_opt
+
+-check runs simulate() (NEURON, MossyCell) at the result and prints both
+peak sequences.
+"""
+
+import argparse
+import time
+
+import numpy as np
+from scipy.optimize import differential_evolution, minimize
+
+from peak_finder_tmgexp2 import peakfinder
+from pydentate.tmgexp2_peaks import tmgexp2_peaks
+
+pr = argparse.ArgumentParser(description="tmgexp2syn fit with the peak evaluator")
+pr.add_argument("-data", type=str, required=True, help="directory of the 1, 10, 30 and 50 Hz data", dest="data")
+pr.add_argument("-out", type=str, default="gc_to_mc_opt", help="npz file of the result", dest="out")
+pr.add_argument("-popsize", type=int, default=30, help="population per parameter", dest="popsize")
+pr.add_argument("-maxiter", type=int, default=1000, dest="maxiter")
+pr.add_argument("-seed", type=int, default=None, dest="seed")
+pr.add_argument("-nthreads", type=int, default=0, help="evaluator threads, 0 for all cores", dest="nthreads")
+pr.add_argument("-check", action="store_true", help="compare with tmgexp2_simulator at the result", dest="check")
+args = pr.parse_args()
+
+freqs = np.array([1, 10, 30, 50])
+# order [tau_facil, tau_rec, u0]
+bounds = [(0, 10000), (1e-3, 5000), (0, 1)]
+begin = time.time()
+peaks = peakfinder(args.data)[0]
+n_stim = len(peaks[0])
+
+
+def loss(x):
+    """Loss of the members x (3,) or (3, S) of the population."""
+    x = np.asarray(x, dtype=float)
+    tau_facil, tau_rec, u0 = (a[..., np.newaxis] for a in x)
+    out = tmgexp2_peaks(tau_facil, tau_rec, u0, freqs, n_stim=n_stim, nthreads=args.nthreads)
+    mse = [np.square(out[..., i, :] - peaks[i]).mean(axis=-1) for i in range(freqs.size)]
+    mse = np.mean(mse, axis=0)
+    return mse if x.ndim > 1 else float(mse[0])
+
+
+res_de = differential_evolution(loss, bounds, popsize=args.popsize, maxiter=args.maxiter, seed=args.seed, polish=False, vectorized=True, updating="deferred")
+res = minimize(loss, res_de.x, method="Nelder-Mead", bounds=bounds)
+np.savez(args.out, loss=res, de=res_de)
+print(res)
+print("%d evaluations, %.1f s" % (res_de.nfev + res.nfev, time.time() - begin))
+
+if args.check:
+    from tmgexp2_simulator import simulate
+
+    for freq in freqs:
+        print("%d Hz" % freq)
+        print("    evaluator", np.round(tmgexp2_peaks(res.x[0], res.x[1], res.x[2], freq, n_stim=n_stim), 4))
+        print("    simulate ", np.round(simulate(res.x[0], res.x[1], freq, res.x[2])[0], 4))
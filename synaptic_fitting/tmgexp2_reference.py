@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+# PEP8
+"""
+Records the peaks of tmgexp2_simulator.simulate (NEURON, MossyCell) on a
+grid of (tau_facil, tau_rec, u0, freq) as the reference of the closed form
+evaluator pydentate.tmgexp2_peaks:
+
+    python tmgexp2_reference.py -out tmgexp2_reference.npz
+
+ouropy/tests/tmgexp2_peaks_test.py compares the evaluator with the file
+given by the environment variable TMGEXP2_REFERENCE (default
+synaptic_fitting/tmgexp2_reference.npz) when it exists. The first row also
+keeps the whole normalized trace of simulate() for plotting.
+"""
+
+import argparse
+import itertools
+
+import numpy as np
+
+from tmgexp2_simulator import simulate
+
+pr = argparse.ArgumentParser(description="tmgexp2syn reference peaks from NEURON")
+pr.add_argument("-out", type=str, default="tmgexp2_reference.npz", dest="out")
+args = pr.parse_args()
+
+tau_facils = [0.0, 50.0, 500.0]
+tau_recs = [10.0, 200.0, 2000.0]
+u0s = [0.05, 0.3]
+freqs = [1, 10, 30, 50]
+
+rows = []
+peaks = []
+trace = None
+for tau_facil, tau_rec, u0, freq in itertools.product(tau_facils, tau_recs, u0s, freqs):
+    peaks_sim, norm_sim = simulate(tau_facil, tau_rec, freq, u0)
+    rows.append((tau_facil, tau_rec, u0, freq))
+    peaks.append(peaks_sim)
+    if trace is None:
+        trace = norm_sim
+    print(rows[-1], np.round(peaks_sim, 4))
+np.savez(args.out, rows=np.array(rows), peaks=np.array(peaks), trace=trace)